@@ -0,0 +1,932 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cairo/cairo.h"
+
+#include "vibrant/vibrant.hpp"
+#include "vibrant/cairo/render.hpp"
+#include "vibrant/cairo/vector_export.hpp"
+#include "vibrant/cairo/frame_sequence.hpp"
+#include "vibrant/cairo/damage.hpp"
+#include "vibrant/cairo/xlib_presenter.hpp"
+
+using namespace entityx;
+using namespace vibrant;
+using namespace std;
+
+// Headless frame-time benchmark
+// -----------------------------
+//
+// Drives the same systems as the demos into a cairo image surface for a fixed number of frames
+// with a scripted frame delta, and reports latency percentiles per system and per frame.
+//
+// --pipelined  renders on a FramePipeline thread; "frame" is then the simulation thread's time
+// --export     writes a multi-page PDF, or an SVG per frame for a printf pattern ending in .svg
+// --sequence   encodes frames on worker threads: PNGs for a pattern ending in .png, raw RGBA else
+// --governor   adapts quality to --dt as the frame budget
+// --present    redraws and presents only the damage to an X window (xvfb-run will do)
+// --record-threads N  records frames of many thousand entities on N threads
+//
+// Usage: vibrant-benchmark [--scene NAME|all] [--frames N] [--dt MS] [--size WxH] [--png FILE]
+//                          [--pipelined] [--export FILE] [--sequence FILE] [--governor]
+//                          [--present] [--record-threads N]
+
+struct Timings
+{
+  void add(const string& name, double ms)
+  {
+    auto found = samples.find(name);
+    if (found == samples.end())
+    {
+      order.push_back(name);
+      found = samples.emplace(name, vector<double>()).first;
+    }
+    found->second.push_back(ms);
+  }
+
+  vector<string> order;
+  map<string, vector<double>> samples;
+};
+
+typedef chrono::steady_clock Clock;
+
+double elapsed_ms(Clock::time_point start)
+{
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+class Scene : public EntityX
+{
+ public:
+  Scene() : render_system(std::make_shared<CairoRenderSystem>()) {}
+  virtual ~Scene() {}
+
+  // Runs every system but rendering
+  virtual void simulate(TimeDelta dt) = 0;
+
+  // True once nothing is animating
+  bool idle()
+  {
+    return !systems.system<EasingSystem<Body>>()->active() &&
+           !systems.system<EasingSystem<Renderable>>()->active();
+  }
+
+  // Anything scene specific worth reporting after the timings
+  virtual void summary() {}
+
+  void render(TimeDelta dt, cairo_t* context)
+  {
+    render_system->setContext(context);
+    timed<CairoRenderSystem>("CairoRenderSystem", dt);
+    countVisibility();
+  }
+
+  // Accumulates the render system's visibility stats for the frame just drawn
+  void countVisibility()
+  {
+    const RenderStats& stats = render_system->frameStats();
+    visibility.drawn += stats.drawn;
+    visibility.pixels += stats.pixels;
+    visibility.transparent += stats.transparent;
+    visibility.empty += stats.empty;
+    visibility.subpixel += stats.subpixel;
+    ++rendered_frames;
+  }
+
+  std::shared_ptr<CairoRenderSystem> render_system;
+  Timings timings;
+  RenderStats visibility;
+  size_t rendered_frames = 0;
+
+ protected:
+  template <typename S>
+  void timed(const char* name, TimeDelta dt)
+  {
+    auto start = Clock::now();
+    systems.update<S>(dt);
+    timings.add(name, elapsed_ms(start));
+  }
+};
+
+// The basic demo's spinning rectangles, with the entity count scaled and optionally a palette of
+// gradient fills. Alpha isn't scaled down with the count, which would hide every fill.
+class BasicScene : public Scene
+{
+ public:
+  BasicScene(int entity_count, bool gradients = false, double alpha = 0.015)
+  {
+    systems.add<EasingSystem<Body>>();
+    systems.add<EasingSystem<Renderable>>();
+    systems.add(render_system);
+    systems.configure();
+
+    for (int i = 0; i < entity_count; ++i)
+    {
+      entityx::Entity entity = entities.create();
+
+      entity.assign<Body>(Vector2d(sin(i / (double)entity_count * M_TAU) * 270 + 632,
+                                   cos(i / (double)entity_count * M_TAU) * 270 + 340),
+                          Vector2d(100, 100), rand() % 360 / 360.0 * M_TAU);
+      Fill fill = {Hsv(i / (double)entity_count, 1, 1, alpha)};
+      if (gradients)
+      {
+        double hue = i % 12 / 12.0;
+        GradientType type = i % 2 ? GradientType::Radial : GradientType::Linear;
+        fill.gradient = Gradient(type, {0.5, 0.5}, {1, 1}, {{0, Hsv(hue, 1, 1, alpha)},
+                                                            {1, Hsv(hue + 0.1, 1, 0.5, alpha)}});
+      }
+      entity.assign<Renderable>(vibrant::Rectangle({0, Hsv(0, 0, 0, 0)}, fill), i);
+
+      move_to(entity, {632, 340}, 10000, Ease::OutElastic, 5000);
+      rotate_to(entity, 10 * M_TAU + M_TAU / 8, 15000, Ease::OutSine);
+    }
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    timed<EasingSystem<Body>>("EasingSystem<Body>", dt);
+    timed<EasingSystem<Renderable>>("EasingSystem<Renderable>", dt);
+  }
+};
+
+// Scenes placed by a LayoutSystem
+class ConstrainedScene : public Scene
+{
+ public:
+  ConstrainedScene() : layout_system(std::make_shared<LayoutSystem>())
+  {
+    systems.add<EasingSystem<Body>>();
+    systems.add<EasingSystem<Renderable>>();
+    systems.add(render_system);
+    systems.add(layout_system);
+    systems.configure();
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    timed<EasingSystem<Body>>("EasingSystem<Body>", dt);
+    timed<EasingSystem<Renderable>>("EasingSystem<Renderable>", dt);
+    timed<LayoutSystem>("LayoutSystem", dt);
+  }
+
+  // A rectangle sized and placed by the solver
+  Layout::Handle box(const vibrant::Rectangle& rectangle, int z)
+  {
+    entityx::Entity entity = entities.create();
+    entity.assign<Body>(Vector2d(0, 0), Vector2d(0, 0));
+    entity.assign<Renderable>(rectangle, z);
+    entity.assign<Layout>(0, 0, 0, 0);
+    return entity.component<Layout>();
+  }
+
+  std::shared_ptr<LayoutSystem> layout_system;
+};
+
+// The layout demo's centred button
+class LayoutScene : public ConstrainedScene
+{
+ public:
+  LayoutScene(Vector2u size)
+  {
+    Layout::Handle button1 = box(
+        vibrant::Rectangle({0, Rgb(0, 0, 0)}, {Rgb(33 / 255.0, 150 / 255.0, 243 / 255.0)}), 1);
+    layout_system->addConstraints(
+        {button1->width >= 100, button1->height >= 25,
+         button1->x == layout_system->left_limit + layout_system->right_limit / 2.0,
+         button1->y == layout_system->top_limit + layout_system->bottom_limit / 2.0});
+    layout_system->setSize(size);
+  }
+};
+
+// A grid of boxes stretched over a window dragged to a new size several times a frame, or with
+// snap, snapped between maximised, docked and split sizes
+class ResizeScene : public ConstrainedScene
+{
+ public:
+  ResizeScene(Vector2u size, int columns, int rows, bool snap = false) : size(size), snap(snap)
+  {
+    rhea::variable& right = layout_system->right_limit;
+    rhea::variable& bottom = layout_system->bottom_limit;
+    for (int i = 0; i < columns * rows; ++i)
+    {
+      Layout::Handle layout =
+          box(vibrant::Rectangle({1, Rgb(0, 0, 0)}, {Hsv(i / (double)(columns * rows), 1, 1)}), i);
+      double column = i % columns, row = i / columns;
+      layout_system->addConstraints(
+          {layout->x == right * ((column + 0.5) / columns),
+           layout->y == bottom * ((row + 0.5) / rows),
+           layout->width == right * (1.0 / columns) - 2,
+           layout->height == bottom * (1.0 / rows) - 2});
+    }
+    layout_system->setSize(size);
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    const int events_per_frame = 4;
+    if (snap)
+    {
+      const Vector2u sizes[] = {size, Vector2u(size.x / 2, size.y), Vector2u(size.x, size.y / 2)};
+      layout_system->setSize(sizes[frame % 3]);
+    }
+    else
+    {
+      for (int i = 0; i < events_per_frame; ++i)
+      {
+        double t = (frame * events_per_frame + i) * 0.01;
+        layout_system->setSize(Vector2u((unsigned int)(size.x * (0.75 + 0.25 * sin(t))),
+                                        (unsigned int)(size.y * (0.75 + 0.25 * cos(t)))));
+      }
+    }
+    ++frame;
+
+    ConstrainedScene::simulate(dt);
+  }
+
+  void summary() override
+  {
+    const LayoutCacheStats& stats = layout_system->cacheStats();
+    printf("  layout cache: %zu hits, %zu misses, %zu evictions, %zu sizes in %zu KB\n",
+           stats.hits, stats.misses, stats.evictions, layout_system->cacheSize(),
+           layout_system->cacheMemoryUsage() / 1024);
+  }
+
+  Vector2u size;
+  bool snap;
+  int frame = 0;
+};
+
+// A list stretched over a resizing window, its rows stacked by a Container or with solver by
+// constraints
+class ListScene : public ConstrainedScene
+{
+ public:
+  ListScene(Vector2u size, int row_count, bool solver) : size(size)
+  {
+    rhea::variable& right = layout_system->right_limit;
+    rhea::variable& bottom = layout_system->bottom_limit;
+    entityx::Entity list = entities.create();
+    list.assign<Body>(Vector2d(0, 0), Vector2d(0, 0));
+    list.assign<Layout>(0, 0, 0, 0);
+    Layout::Handle list_layout = list.component<Layout>();
+    layout_system->addConstraints({list_layout->x == right / 2.0, list_layout->y == bottom / 2.0,
+                                   list_layout->width == right, list_layout->height == bottom});
+    if (!solver) list.assign<Container>(Arrangement::Stack, Axis::Vertical, 1, 4);
+
+    const double row_height = 20;
+    Layout::Handle previous;
+    for (int i = 0; i < row_count; ++i)
+    {
+      vibrant::Rectangle rectangle({0, Rgb(0, 0, 0)}, {Hsv(i / (double)row_count, 0.5, 1)});
+      if (!solver)
+      {
+        entityx::Entity row = entities.create();
+        row.assign<Body>(Vector2d(0, 0), Vector2d(0, 0));
+        row.assign<Renderable>(rectangle, i);
+        row.assign<Sizing>(Vector2d(0, row_height));
+        list.component<Container>()->add(row);
+        continue;
+      }
+
+      Layout::Handle layout = box(rectangle, i);
+      rhea::linear_expression top = previous ? previous->y + previous->height / 2.0 + 1
+                                             : list_layout->y - list_layout->height / 2.0 + 4;
+      layout_system->addConstraints({layout->x == list_layout->x,
+                                     layout->width == list_layout->width - 8,
+                                     layout->height == row_height,
+                                     layout->y - layout->height / 2.0 == top});
+      previous = layout;
+    }
+    layout_system->setSize(size);
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    double t = frame++ * 0.04;
+    layout_system->setSize(Vector2u((unsigned int)(size.x * (0.75 + 0.25 * sin(t))),
+                                    (unsigned int)(size.y * (0.75 + 0.25 * cos(t)))));
+
+    ConstrainedScene::simulate(dt);
+  }
+
+  void summary() override
+  {
+    const ContainerStats& stats = layout_system->containerStats();
+    printf("  containers: %zu direct, %zu constrained, %zu placed last frame\n", stats.direct,
+           stats.constrained, stats.placed);
+  }
+
+  Vector2u size;
+  int frame = 0;
+};
+
+// Rows of chained boxes, some animating their width through LayoutSystem::animate
+class AnimationScene : public ConstrainedScene
+{
+ public:
+  AnimationScene(Vector2u size, int animation_count) : animation_count(animation_count)
+  {
+    const int columns = 50, rows = 20;
+    Layout::Handle previous;
+    for (int i = 0; i < columns * rows; ++i)
+    {
+      Layout::Handle layout =
+          box(vibrant::Rectangle({1, Rgb(0, 0, 0)}, {Hsv(i / (double)(columns * rows), 1, 1)}), i);
+      double row = i / columns;
+      rhea::linear_expression left(layout_system->left_limit);
+      if (i % columns) left = previous->x + previous->width / 2.0 + 2;
+      layout_system->addConstraints(
+          {layout->x - layout->width / 2.0 == left, layout->width >= 4,
+           rhea::constraint(layout->width == 20, rhea::strength::medium()),
+           layout->y == layout_system->bottom_limit * ((row + 0.5) / rows),
+           layout->height == layout_system->bottom_limit * (1.0 / rows) - 2});
+      if (i % columns == columns - 1)
+        layout_system->addConstraint(layout->x + layout->width / 2.0 <= layout_system->right_limit);
+
+      if (i % (columns * rows / animation_count) == 0) widths.push_back(layout->width);
+      previous = layout;
+    }
+    layout_system->setSize(size);
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    // A second there and a second back, staggered
+    if (frame % 60 == 0)
+    {
+      for (size_t i = 0; i < widths.size(); ++i)
+      {
+        double width = frame % 120 ? 20 : 20 + 10 * (i % 3 + 1);
+        layout_system->animate(widths[i], width, 1000, Ease::InOutSine, i * 5 % 200);
+      }
+    }
+    ++frame;
+
+    ConstrainedScene::simulate(dt);
+  }
+
+  void summary() override
+  {
+    printf("  layout animations: %d, %zu resolves over %d frames\n", animation_count,
+           layout_system->resolves(), frame);
+  }
+
+  std::vector<rhea::variable> widths;
+  int animation_count;
+  int frame = 0;
+};
+
+// A panel of boxes opened and closed every half second over a still background, optionally
+// solved on the solver thread
+class PanelScene : public ConstrainedScene
+{
+ public:
+  PanelScene(Vector2u size, int panel_boxes, bool asynchronous) : panel_boxes(panel_boxes)
+  {
+    layout_system->setSize(size);
+    layout_system->setAsynchronous(asynchronous);
+
+    // A background of a thousand boxes chained into rows
+    const int columns = 50, rows = 20;
+    Layout::Handle previous;
+    for (int i = 0; i < columns * rows; ++i)
+    {
+      Layout::Handle layout = tile(i / (double)(columns * rows), 0);
+      double row = i / columns;
+      rhea::linear_expression left(layout_system->left_limit);
+      if (i % columns) left = previous->x + previous->width / 2.0;
+      layout_system->addConstraints(
+          {layout->x - layout->width / 2.0 == left,
+           layout->width == layout_system->right_limit * (1.0 / columns),
+           layout->y == layout_system->bottom_limit * ((row + 0.5) / rows),
+           layout->height == layout_system->bottom_limit * (1.0 / rows)});
+      previous = layout;
+    }
+  }
+
+  Layout::Handle tile(double hue, int layer)
+  {
+    return box(vibrant::Rectangle({1, Rgb(0, 0, 0)}, {Hsv(hue, 0.5, 1)}), layer);
+  }
+
+  void open()
+  {
+    // The middle half of the viewport, boxes stacked top to bottom
+    rhea::linear_expression top = layout_system->bottom_limit * 0.25;
+    for (int i = 0; i < panel_boxes; ++i)
+    {
+      Layout::Handle layout = tile(i / (double)panel_boxes, 1);
+      rhea::constraint_list constraints = {
+          layout->x == layout_system->right_limit * 0.5,
+          layout->width == layout_system->right_limit * 0.5,
+          layout->y - layout->height / 2.0 == top,
+          layout->height == layout_system->bottom_limit * (0.5 / panel_boxes)};
+      layout_system->addConstraints(constraints);
+      panel_constraints.insert(panel_constraints.end(), constraints.begin(), constraints.end());
+      panel.push_back(layout.entity());
+      top = layout->y + layout->height / 2.0;
+    }
+  }
+
+  void close()
+  {
+    layout_system->removeConstraints(panel_constraints);
+    panel_constraints.clear();
+    for (entityx::Entity entity : panel) entity.destroy();
+    panel.clear();
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    if (frame % 30 == 0)
+    {
+      auto start = Clock::now();
+      if (panel.empty())
+        open();
+      else
+        close();
+      timings.add("panel open/close", elapsed_ms(start));
+    }
+    ++frame;
+
+    ConstrainedScene::simulate(dt);
+  }
+
+  void summary() override
+  {
+    printf("  panel: %d boxes, %zu resolves over %d frames%s\n", panel_boxes,
+           layout_system->resolves(), frame,
+           layout_system->asynchronous() ? " on the solver thread" : "");
+  }
+
+  std::vector<entityx::Entity> panel;
+  rhea::constraint_list panel_constraints;
+  int panel_boxes;
+  int frame = 0;
+};
+
+// A million row list scrolling a screen and a half per second, every tenth row measured taller
+// than estimated; only rows in view are entities
+class VirtualListScene : public Scene
+{
+ public:
+  VirtualListScene(Vector2u size, size_t row_count)
+  {
+    systems.add<EasingSystem<Body>>();
+    systems.add<EasingSystem<Renderable>>();
+    systems.add(render_system);
+    list_system = std::make_shared<VirtualListSystem>();
+    systems.add(list_system);
+    systems.configure();
+
+    list = entities.create();
+    list.assign<Body>(Vector2d(size.x / 2.0, size.y / 2.0), Vector2d(size.x, size.y));
+    list.assign<VirtualList>(row_count, 20,
+                             [this](entityx::Entity row, size_t index) { bind(row, index); });
+  }
+
+  void bind(entityx::Entity row, size_t index)
+  {
+    VirtualList::Handle virtual_list = list.component<VirtualList>();
+    double hue = index / (double)virtual_list->extents.size();
+    row.assign<Renderable>(vibrant::Rectangle({1, Rgb(0, 0, 0)}, {Hsv(hue, 0.5, 1)}),
+                           (int)(index % 1000));
+    if (index % 10 == 0) virtual_list->extents.set(index, 40);
+  }
+
+  void simulate(TimeDelta dt) override
+  {
+    VirtualList::Handle virtual_list = list.component<VirtualList>();
+    virtual_list->scroll += list.component<Body>()->size.y * 1.5 * dt / 1000;
+
+    timed<EasingSystem<Body>>("EasingSystem<Body>", dt);
+    timed<EasingSystem<Renderable>>("EasingSystem<Renderable>", dt);
+    timed<VirtualListSystem>("VirtualListSystem", dt);
+  }
+
+  void summary() override
+  {
+    VirtualList::Handle virtual_list = list.component<VirtualList>();
+    printf("  virtual list: %zu rows, %zu live, %zu entities created, %zu rows bound\n",
+           virtual_list->extents.size(), virtual_list->live.size(), list_system->created(),
+           list_system->bound());
+  }
+
+  std::shared_ptr<VirtualListSystem> list_system;
+  entityx::Entity list;
+};
+
+struct Options
+{
+  string scene = "all";
+  int frames = 300;
+  double dt = 1000 / 60.0;
+  Vector2u size = Vector2u(1280, 720);
+  string png;
+  bool pipelined = false;
+  string vector;
+  string sequence;
+  bool governor = false;
+  bool present = false;
+  unsigned int record_threads = 1;
+};
+
+typedef std::function<std::unique_ptr<Scene>(const Options&)> SceneFactory;
+
+const vector<pair<string, SceneFactory>>& scenes()
+{
+  static const vector<pair<string, SceneFactory>> registry = {
+      {"basic-1k", [](const Options&) { return std::unique_ptr<Scene>(new BasicScene(1000)); }},
+      {"basic-10k", [](const Options&) { return std::unique_ptr<Scene>(new BasicScene(10000)); }},
+      {"basic-100k",
+       [](const Options&) { return std::unique_ptr<Scene>(new BasicScene(100000)); }},
+      {"gradient-10k",
+       [](const Options&) { return std::unique_ptr<Scene>(new BasicScene(10000, true)); }},
+      {"translucent-10k",
+       [](const Options&)
+       {
+         // Below half an 8-bit step, so every fill is culled as transparent
+         return std::unique_ptr<Scene>(new BasicScene(10000, false, 0.001));
+       }},
+      {"layout",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new LayoutScene(options.size));
+       }},
+      {"layout-resize-5k",
+       [](const Options& options)
+       {
+         // 1250 boxes of 4 constraints each
+         return std::unique_ptr<Scene>(new ResizeScene(options.size, 50, 25));
+       }},
+      {"layout-snap-5k",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new ResizeScene(options.size, 50, 25, true));
+       }},
+      {"layout-list-2k",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new ListScene(options.size, 2000, false));
+       }},
+      {"layout-list-2k-solver",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new ListScene(options.size, 2000, true));
+       }},
+      {"layout-animate-1",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new AnimationScene(options.size, 1));
+       }},
+      {"layout-animate-10",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new AnimationScene(options.size, 10));
+       }},
+      {"layout-animate-100",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new AnimationScene(options.size, 100));
+       }},
+      {"layout-panel",
+       [](const Options& options)
+       {
+         // 200 boxes of 4 constraints each
+         return std::unique_ptr<Scene>(new PanelScene(options.size, 200, false));
+       }},
+      {"layout-panel-async",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new PanelScene(options.size, 200, true));
+       }},
+      {"virtual-list-1m",
+       [](const Options& options)
+       {
+         return std::unique_ptr<Scene>(new VirtualListScene(options.size, 1000000));
+       }},
+  };
+  return registry;
+}
+
+double percentile(const vector<double>& sorted, double p)
+{
+  if (sorted.empty()) return 0;
+  size_t index = (size_t)ceil(p / 100.0 * sorted.size());
+  return sorted[std::min(sorted.size() - 1, index == 0 ? 0 : index - 1)];
+}
+
+void report(const string& scene, Timings& timings, const RenderStats& visibility,
+            size_t frames)
+{
+  printf("\n%s\n", scene.c_str());
+  printf("  %-28s %9s %9s %9s %9s %9s\n", "ms", "mean", "p50", "p90", "p99", "max");
+  for (auto& name : timings.order)
+  {
+    auto sorted = timings.samples[name];
+    sort(sorted.begin(), sorted.end());
+    double mean = 0;
+    for (double sample : sorted) mean += sample;
+    mean /= std::max<size_t>(1, sorted.size());
+    printf("  %-28s %9.3f %9.3f %9.3f %9.3f %9.3f\n", name.c_str(), mean, percentile(sorted, 50),
+           percentile(sorted, 90), percentile(sorted, 99), sorted.empty() ? 0 : sorted.back());
+  }
+
+  if (!frames) return;
+  printf("  primitives per frame: %zu drawn, %zu as pixels, skipped %zu transparent, %zu empty, "
+         "%zu subpixel\n",
+         visibility.drawn / frames, visibility.pixels / frames, visibility.transparent / frames,
+         visibility.empty / frames, visibility.subpixel / frames);
+}
+
+// Draws and presents every frame to an X window, leaving the last one in backbuffer
+void present(Scene& scene, cairo_surface_t* backbuffer, const Options& options)
+{
+#if defined(CAIRO_HAS_XLIB_SURFACE)
+  Display* display = XOpenDisplay(nullptr);
+  if (!display)
+  {
+    fprintf(stderr, "--present: can't open display %s\n", XDisplayName(nullptr));
+    return;
+  }
+
+  Window window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, options.size.x,
+                                      options.size.y, 0, 0, 0);
+  XSelectInput(display, window, StructureNotifyMask);
+  XMapWindow(display, window);
+  for (XEvent event; XNextEvent(display, &event), event.type != MapNotify;)
+    continue;
+
+  {
+    CairoXlibPresenter presenter(display, window);
+    CairoDamageTracker damage;
+    RenderCommandBuffer frame;
+    CairoQualityGovernor& governor = scene.render_system->qualityGovernor();
+    for (int i = 0; i < options.frames; ++i)
+    {
+      auto frame_start = Clock::now();
+      scene.simulate(options.dt);
+      governor.setIdle(scene.idle());
+
+      // Recorded up front, as the damage decides what to redraw
+      frame.record(scene.entities, options.record_threads);
+      damage.frame(frame, options.size);
+
+      auto render_start = Clock::now();
+      cairo_t* context = cairo_create(presenter.backbuffer(options.size));
+      clip_to_region(context, damage.region());
+      cairo_set_source_rgb(context, 0.0, 0.0, 0.0);
+      cairo_paint(context);
+      scene.render_system->setContext(context);
+      scene.render_system->execute(frame);
+      scene.countVisibility();
+      cairo_destroy(context);
+      scene.timings.add("CairoRenderSystem::execute", elapsed_ms(render_start));
+
+      presenter.present(damage.region());
+      scene.timings.add("CairoXlibPresenter::present", presenter.stats().last_ms);
+      scene.timings.add("frame", elapsed_ms(frame_start));
+    }
+
+    const PresentStats& stats = presenter.stats();
+    printf("\npresent: %s, %.1f rectangles and %.0f%% of the frame copied per frame\n",
+           presenter.sharedMemory() ? "MIT-SHM" : "cairo-xlib",
+           stats.rectangles / (double)std::max<size_t>(1, stats.presents),
+           100.0 * stats.pixels / std::max<size_t>(1, stats.presents) /
+               ((double)options.size.x * options.size.y));
+
+    cairo_t* context = cairo_create(backbuffer);
+    cairo_set_source_surface(context, presenter.backbuffer(options.size), 0, 0);
+    cairo_paint(context);
+    cairo_destroy(context);
+  }
+
+  XDestroyWindow(display, window);
+  XCloseDisplay(display);
+#else
+  fprintf(stderr, "--present: cairo was built without xlib support\n");
+#endif
+}
+
+void run(const string& name, const SceneFactory& factory, const Options& options)
+{
+  // Reproducible scenes; the basic scene uses rand() for initial rotations
+  srand(0);
+  std::unique_ptr<Scene> scene = factory(options);
+  CairoQualityGovernor& governor = scene->render_system->qualityGovernor();
+  governor.setEnabled(options.governor);
+  QualityGovernorSettings governor_settings;
+  governor_settings.budget_ms = options.dt;
+  governor.setSettings(governor_settings);
+  scene->render_system->setRecordThreads(options.record_threads);
+
+  cairo_surface_t* backbuffer =
+      cairo_image_surface_create(CAIRO_FORMAT_RGB24, options.size.x, options.size.y);
+
+  auto clear = [](cairo_t* context)
+  {
+    cairo_set_source_rgb(context, 0.0, 0.0, 0.0);
+    cairo_paint(context);
+  };
+
+  if (options.pipelined)
+  {
+    // Only the render thread touches these until sync()
+    Timings render_timings;
+    // Whether the frame in flight was simulated idle; only set while nothing is in flight
+    bool frame_idle = false;
+    FramePipeline pipeline([&](const RenderCommandBuffer& frame)
+                           {
+                             governor.setIdle(frame_idle);
+                             auto start = Clock::now();
+                             cairo_t* context = cairo_create(backbuffer);
+                             clear(context);
+                             scene->render_system->setContext(context);
+                             scene->render_system->execute(frame);
+                             scene->countVisibility();
+                             cairo_destroy(context);
+                             cairo_surface_flush(backbuffer);
+                             render_timings.add("CairoRenderSystem::execute", elapsed_ms(start));
+                           });
+
+    RenderCommandBuffer frame;
+    for (int i = 0; i < options.frames; ++i)
+    {
+      auto frame_start = Clock::now();
+      scene->simulate(options.dt);
+      bool idle = scene->idle();
+
+      auto record_start = Clock::now();
+      frame.record(scene->entities, options.record_threads);
+      scene->timings.add("RenderCommandBuffer::record", elapsed_ms(record_start));
+
+      // submit() waits for the frame in flight anyway; waiting first hands the idle flag over
+      // with this frame instead of changing it under the one rendering
+      pipeline.sync();
+      frame_idle = idle;
+      pipeline.submit(frame);
+      scene->timings.add("frame", elapsed_ms(frame_start));
+    }
+    pipeline.sync();
+
+    for (auto& name : render_timings.order)
+      for (double sample : render_timings.samples[name]) scene->timings.add(name, sample);
+  }
+  else if (!options.vector.empty())
+  {
+    string file = options.scene == "all" ? name + "-" + options.vector : options.vector;
+    bool svg = file.size() >= 4 && file.compare(file.size() - 4, 4, ".svg") == 0;
+    CairoVectorExport exporter(svg ? VectorFormat::Svg : VectorFormat::Pdf, file,
+                               Vector2d(options.size.x, options.size.y));
+
+    RenderCommandBuffer frame;
+    for (int i = 0; i < options.frames; ++i)
+    {
+      auto frame_start = Clock::now();
+      scene->simulate(options.dt);
+      governor.setIdle(scene->idle());
+      frame.record(scene->entities, options.record_threads);
+
+      auto export_start = Clock::now();
+      exporter.frame(frame);
+      scene->timings.add("CairoVectorExport::frame", elapsed_ms(export_start));
+      scene->timings.add("frame", elapsed_ms(frame_start));
+    }
+
+    exporter.finish();
+    if (exporter.status() != CAIRO_STATUS_SUCCESS)
+      fprintf(stderr, "%s: %s\n", file.c_str(), cairo_status_to_string(exporter.status()));
+  }
+  else if (!options.sequence.empty())
+  {
+    string file = options.scene == "all" ? name + "-" + options.sequence : options.sequence;
+    bool png = file.size() >= 4 && file.compare(file.size() - 4, 4, ".png") == 0;
+    CairoFrameSequence sequence(png ? FrameFormat::Png : FrameFormat::Rgba, file, options.size);
+
+    for (int i = 0; i < options.frames; ++i)
+    {
+      auto frame_start = Clock::now();
+      scene->simulate(options.dt);
+      governor.setIdle(scene->idle());
+
+      cairo_t* context = sequence.beginFrame();
+      clear(context);
+      scene->render(options.dt, context);
+      sequence.endFrame();
+      scene->timings.add("frame", elapsed_ms(frame_start));
+    }
+
+    auto finish_start = Clock::now();
+    sequence.finish();
+    FrameSequenceStats stats = sequence.stats();
+    printf("\n%s: %zu frames, %zu encoder stalls (%.3f ms), %.3f ms draining encoders\n",
+           file.c_str(), stats.frames, stats.stalls, stats.stall_ms, elapsed_ms(finish_start));
+    if (sequence.status() != CAIRO_STATUS_SUCCESS)
+      fprintf(stderr, "%s: %s\n", file.c_str(), cairo_status_to_string(sequence.status()));
+  }
+  else if (options.present)
+  {
+    present(*scene, backbuffer, options);
+  }
+  else
+  {
+    for (int i = 0; i < options.frames; ++i)
+    {
+      auto frame_start = Clock::now();
+
+      cairo_t* context = cairo_create(backbuffer);
+      clear(context);
+
+      scene->simulate(options.dt);
+      governor.setIdle(scene->idle());
+      scene->render(options.dt, context);
+
+      cairo_destroy(context);
+      cairo_surface_flush(backbuffer);
+      scene->timings.add("frame", elapsed_ms(frame_start));
+    }
+  }
+
+  if (!options.png.empty())
+  {
+    string file = options.scene == "all" ? name + "-" + options.png : options.png;
+    cairo_surface_write_to_png(backbuffer, file.c_str());
+  }
+  cairo_surface_destroy(backbuffer);
+
+  report(name, scene->timings, scene->visibility, scene->rendered_frames);
+  scene->summary();
+  if (options.governor)
+  {
+    QualityMetrics metrics = governor.metrics();
+    printf("  quality frames: %zu best, %zu reduced, %zu minimal; %zu degrades, %zu restores, "
+           "%zu idle restores\n",
+           metrics.frames[0], metrics.frames[1], metrics.frames[2], metrics.degrades,
+           metrics.restores, metrics.idle_restores);
+  }
+}
+
+int usage(const char* program)
+{
+  fprintf(stderr,
+          "usage: %s [--scene NAME|all] [--frames N] [--dt MS] [--size WxH] [--png FILE] "
+          "[--pipelined] [--export FILE] [--sequence FILE] [--governor] [--present] "
+          "[--record-threads N]\n",
+          program);
+  fprintf(stderr, "scenes:");
+  for (auto& scene : scenes()) fprintf(stderr, " %s", scene.first.c_str());
+  fprintf(stderr, "\n");
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--scene") && has_value)
+      options.scene = argv[++i];
+    else if (!strcmp(argv[i], "--frames") && has_value)
+      options.frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--dt") && has_value)
+      options.dt = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--size") && has_value &&
+             sscanf(argv[++i], "%ux%u", &options.size.x, &options.size.y) == 2)
+      continue;
+    else if (!strcmp(argv[i], "--png") && has_value)
+      options.png = argv[++i];
+    else if (!strcmp(argv[i], "--pipelined"))
+      options.pipelined = true;
+    else if (!strcmp(argv[i], "--export") && has_value)
+      options.vector = argv[++i];
+    else if (!strcmp(argv[i], "--sequence") && has_value)
+      options.sequence = argv[++i];
+    else if (!strcmp(argv[i], "--governor"))
+      options.governor = true;
+    else if (!strcmp(argv[i], "--present"))
+      options.present = true;
+    else if (!strcmp(argv[i], "--record-threads") && has_value)
+      options.record_threads = std::max(1, atoi(argv[++i]));
+    else
+      return usage(argv[0]);
+  }
+
+  bool found = false;
+  for (auto& scene : scenes())
+  {
+    if (options.scene != "all" && options.scene != scene.first) continue;
+
+    run(scene.first, scene.second, options);
+    found = true;
+  }
+
+  return found ? 0 : usage(argv[0]);
+}
@@ -1,4 +1,5 @@
 #include <wx/wx.h>
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include "wx/dcbuffer.h"
@@ -15,6 +16,12 @@
 
 #include "vibrant/vibrant.hpp"
 #include "vibrant/cairo/render.hpp"
+#include "vibrant/cairo/damage.hpp"
+#if defined(__WXGTK__) && defined(CAIRO_HAS_XLIB_SURFACE)
+#define PRESENT_XLIB
+#include <gdk/gdkx.h>
+#include "vibrant/cairo/xlib_presenter.hpp"
+#endif
 
 using namespace entityx;
 using namespace vibrant;
@@ -110,21 +117,51 @@ class BasicEntities : public EntityX
     }
   }
 
-  void update(TimeDelta dt, cairo_t* context)
+  // Runs on the UI thread, so mouse input is always applied between two simulated frames
+  void simulate(TimeDelta dt, RenderCommandBuffer& frame)
   {
-    // systems.update<FastEasingSystem<double, Vector2d, Body>>(dt);
-    // systems.update<FastEasingSystem<double, Radians, Body>>(dt);
-    systems.update<EasingSystem<Body>>(dt);
-    systems.update<EasingSystem<Renderable>>(dt);
-    systems.update<HoverColor>(dt);
+    for (unsigned int steps = timestep.advance(dt); steps; --steps)
+    {
+      store_previous_bodies(entities);
+      stepping = easing() || step_requested;
+      step_requested = false;
+
+      // systems.update<FastEasingSystem<double, Vector2d, Body>>(timestep.stepMs());
+      // systems.update<FastEasingSystem<double, Radians, Body>>(timestep.stepMs());
+      systems.update<EasingSystem<Body>>(timestep.stepMs());
+      systems.update<EasingSystem<Renderable>>(timestep.stepMs());
+      systems.update<HoverColor>(timestep.stepMs());
+    }
+
+    frame.record(entities, 1, timestep.alpha());
+  }
 
+  // Runs on the FramePipeline's render thread
+  void render(const RenderCommandBuffer& frame, cairo_t* context)
+  {
     render_system->setContext(context);
-    systems.update<CairoRenderSystem>(dt);
+    render_system->execute(frame);
   }
 
   void updateMouse(MouseUpdate mouse) { mouse_system->update(entities, events, mouse); }
 
+  // Whether another frame would change anything
+  bool animating() { return easing() || stepping || step_requested; }
+  // Input is only applied by a step, which a frame between two steps wouldn't run
+  void requestStep() { step_requested = true; }
+
  private:
+  bool easing()
+  {
+    return systems.system<EasingSystem<Body>>()->active() ||
+           systems.system<EasingSystem<Renderable>>()->active();
+  }
+
+  // Easing advances at a fixed rate; frames in between interpolate
+  FixedTimestep timestep{60};
+  // The last step may have moved bodies, so the next one is needed to stop interpolating
+  bool stepping = false;
+  bool step_requested = false;
   std::shared_ptr<CairoRenderSystem> render_system;
   std::shared_ptr<MouseSystem> mouse_system;
 };
@@ -145,18 +182,32 @@ class SimpleVibrantFrame : public wxFrame
   SimpleVibrantFrame(const wxString& title, const wxPoint& pos, const wxSize& size);
 
   void onPaint(wxPaintEvent& event);
-  void onRefreshTimer(wxTimerEvent& event) { Refresh(); }
+  // Only wakes the event loop so the next idle event can draw a paced frame
+  void onRefreshTimer(wxTimerEvent& event) {}
   void onIdle(wxIdleEvent& event);
   void onMouse(wxMouseEvent& event);
   void draw(wxDC& dc);
+  // Copies the damaged part of the backbuffer to the window, or all of it for nullptr
+  void present(wxDC& dc, const cairo_region_t* region);
 
  private:
   BasicEntities basic_entities;
   cairo_surface_t* backbuffer = nullptr;
   Vector2u backbuffer_size;
+#if defined(PRESENT_XLIB)
+  // Owns the backbuffer, which is shared with the X server through MIT-SHM where possible
+  std::unique_ptr<CairoXlibPresenter> presenter;
+#endif
+  // What the frame in flight changed; only that is redrawn and presented
+  CairoDamageTracker damage;
+  Vector2u frame_size;
+  int presents = 0;
+  double present_ms = 0;
+  // Renders frame N into the backbuffer while the UI thread simulates frame N+1
+  RenderCommandBuffer frame;
+  std::unique_ptr<FramePipeline> pipeline;
+  FrameScheduler scheduler;
   wxTimer refresh_timer;
-  bool first_frame = true;
-  std::chrono::steady_clock::time_point last_frame_end;
 
   wxDECLARE_EVENT_TABLE();
 };
@@ -164,7 +215,7 @@ class SimpleVibrantFrame : public wxFrame
 // clang-format off
 wxBEGIN_EVENT_TABLE(SimpleVibrantFrame, wxFrame)
   EVT_PAINT(SimpleVibrantFrame::onPaint)
-  // EVT_TIMER(-1, SimpleVibrantFrame::onRefreshTimer)
+  EVT_TIMER(-1, SimpleVibrantFrame::onRefreshTimer)
   EVT_IDLE(SimpleVibrantFrame::onIdle)
   EVT_MOUSE_EVENTS(SimpleVibrantFrame::onMouse)
 wxEND_EVENT_TABLE()
@@ -186,8 +237,23 @@ SimpleVibrantFrame::SimpleVibrantFrame(const wxString& title, const wxPoint& pos
                                        const wxSize& size)
     : wxFrame(NULL, wxID_ANY, title, pos, size), refresh_timer(this)
 {
-  // refresh_timer.Start(15);
   SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+  scheduler.addActivity([this] { return basic_entities.animating(); });
+
+  pipeline.reset(new FramePipeline([this](const RenderCommandBuffer& frame)
+                                   {
+                                     damage.frame(frame, frame_size);
+
+                                     cairo_t* context = cairo_create(backbuffer);
+                                     clip_to_region(context, damage.region());
+                                     cairo_set_source_rgb(context, 0.0, 0.0, 0.0);
+                                     cairo_paint(context);
+
+                                     basic_entities.render(frame, context);
+
+                                     cairo_destroy(context);
+                                   }));
 }
 
 void SimpleVibrantFrame::onPaint(wxPaintEvent& event)
@@ -195,43 +261,71 @@ void SimpleVibrantFrame::onPaint(wxPaintEvent& event)
   wxPaintDC dc(this);  // mark as painted
   dc.DestroyClippingRegion();
 
-  draw(dc);
+  // Exposed or resized; show what's there and have a fresh frame drawn
+  pipeline->sync();
+  if (backbuffer) present(dc, nullptr);
+  scheduler.invalidate();
 }
 
 void SimpleVibrantFrame::draw(wxDC& dc)
 {
-  auto current_time = std::chrono::steady_clock::now();
-  if (first_frame)
-  {
-    last_frame_end = current_time;
-    first_frame = false;
-  }
+  double delta_ms = scheduler.beginFrame();
 
-  auto delta_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(current_time - last_frame_end).count();
-  // if (delta_ms < 16.67)
-  if (delta_ms < 5.0) return;
-  last_frame_end = std::chrono::steady_clock::now();
+  // Update systems and snapshot the frame while the previous one may still be rendering
+  basic_entities.simulate(delta_ms, frame);
 
-  // Create or recreate the back buffer
+  // The backbuffer belongs to the render thread until the frame in flight is done
+  pipeline->sync();
+
+  // Create or recreate the back buffer. It only ever grows, so shrinking the window keeps it.
   wxSize client_size = GetClientSize();
-  if (backbuffer == nullptr || backbuffer_size.x < (unsigned int)client_size.GetWidth() ||
-      backbuffer_size.y < (unsigned int)client_size.GetHeight())
+  Vector2u size(client_size.GetWidth(), client_size.GetHeight());
+  cairo_surface_t* previous_backbuffer = backbuffer;
+#if defined(PRESENT_XLIB)
+  if (!presenter)
+  {
+    GdkWindow* window = GTKGetDrawingWindow();
+    gdk_window_ensure_native(window);
+    presenter.reset(new CairoXlibPresenter(GDK_WINDOW_XDISPLAY(window), GDK_WINDOW_XID(window)));
+  }
+  backbuffer = presenter->backbuffer(size);
+  backbuffer_size = presenter->backbufferSize();
+#else
+  if (backbuffer == nullptr || backbuffer_size.x < size.x || backbuffer_size.y < size.y)
   {
     if (backbuffer) cairo_surface_destroy(backbuffer);
 
-    backbuffer = cairo_image_surface_create(CAIRO_FORMAT_RGB24, client_size.GetWidth(),
-                                            client_size.GetHeight());
-    backbuffer_size = Vector2u(client_size.GetWidth(), client_size.GetHeight());
+    backbuffer_size = Vector2u(std::max(backbuffer_size.x, size.x),
+                               std::max(backbuffer_size.y, size.y));
+    backbuffer =
+        cairo_image_surface_create(CAIRO_FORMAT_RGB24, backbuffer_size.x, backbuffer_size.y);
   }
+#endif
+  bool recreated = backbuffer != previous_backbuffer;
+  if (recreated) damage.invalidate();
 
-  cairo_t* context = cairo_create(backbuffer);
-  cairo_set_source_rgb(context, 0.0, 0.0, 0.0);
-  cairo_paint(context);
+  // Present the previous frame; a fresh backbuffer has nothing worth presenting yet
+  if (!recreated) present(dc, damage.region());
 
-  // Update systems to render
-  basic_entities.update(delta_ms, context);
+  frame_size = size;
+  pipeline->submit(frame);
+  scheduler.endFrame();
 
+  // Nothing will come after this frame to present it, so wait for it
+  if (scheduler.idle() || recreated)
+  {
+    pipeline->sync();
+    present(dc, damage.region());
+  }
+}
+
+void SimpleVibrantFrame::present(wxDC& dc, const cairo_region_t* region)
+{
+  auto start = std::chrono::steady_clock::now();
+
+#if defined(PRESENT_XLIB)
+  presenter->present(region);
+#else
 #if defined(CAIRO_HAS_WIN32_SURFACE)
   cairo_surface_t* surface = cairo_win32_surface_create((HDC)dc.GetHDC());
 #elif defined(CAIRO_HAS_QUARTZ_SURFACE)
@@ -243,21 +337,42 @@ void SimpleVibrantFrame::draw(wxDC& dc)
       cg_context, dc_size.GetWidth(), dc_size.GetHeight());
 #endif
   cairo_t* dc_context = cairo_create(surface);
+  clip_to_region(dc_context, region);
   cairo_set_source_surface(dc_context, backbuffer, 0, 0);
   cairo_set_operator(dc_context, CAIRO_OPERATOR_SOURCE);
   cairo_paint(dc_context);
 
   cairo_destroy(dc_context);
   cairo_surface_destroy(surface);
+#endif
 
-  cairo_destroy(context);
+  // Average present cost over the last second or so
+  present_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                    .count();
+  if (++presents == 60)
+  {
+    SetTitle(wxString::Format("Simple Vibrant Demo - present %.3f ms", present_ms / presents));
+    presents = 0;
+    present_ms = 0;
+  }
 }
 
 void SimpleVibrantFrame::onIdle(wxIdleEvent& event)
 {
-  wxClientDC dc(this);
-  draw(dc);
-  event.RequestMore();  // render continuously, not only once on idle
+  if (scheduler.frameDue())
+  {
+    wxClientDC dc(this);
+    draw(dc);
+  }
+
+  // While idle, wait for input rather than spinning. Otherwise wake in time for the next frame.
+  if (scheduler.idle()) return;
+
+  double wait_ms = scheduler.msUntilNextFrame();
+  if (wait_ms < 1)
+    event.RequestMore();
+  else
+    refresh_timer.StartOnce((int)wait_ms);
 }
 
 void SimpleVibrantFrame::onMouse(wxMouseEvent& event)
@@ -276,4 +391,6 @@ void SimpleVibrantFrame::onMouse(wxMouseEvent& event)
     mouse.left = ButtonState::DoubleClicked;
 
   basic_entities.updateMouse(mouse);
+  basic_entities.requestStep();
+  scheduler.invalidate();
 }
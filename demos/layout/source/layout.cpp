@@ -1,4 +1,5 @@
 #include <wx/wx.h>
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include "wx/dcbuffer.h"
@@ -15,6 +16,12 @@
 
 #include "vibrant/vibrant.hpp"
 #include "vibrant/cairo/render.hpp"
+#include "vibrant/cairo/damage.hpp"
+#if defined(__WXGTK__) && defined(CAIRO_HAS_XLIB_SURFACE)
+#define PRESENT_XLIB
+#include <gdk/gdkx.h>
+#include "vibrant/cairo/xlib_presenter.hpp"
+#endif
 
 using namespace entityx;
 using namespace vibrant;
@@ -27,6 +34,29 @@ class SimpleVibrantApp : public wxApp
   bool OnInit() override;
 };
 
+// Clicking the button eases its minimum width out or back in through the layout solver
+struct ButtonWidth : public System<ButtonWidth>, public Receiver<ButtonWidth>
+{
+  ButtonWidth(std::shared_ptr<LayoutSystem> layout_system) : layout_system(layout_system)
+  {
+    layout_system->animate(width, 100, 0, Ease::InOutSine);
+  }
+
+  void configure(EventManager& events) override { events.subscribe<LeftClick>(*this); }
+
+  void receive(const LeftClick& event)
+  {
+    wide = !wide;
+    layout_system->animate(width, wide ? 220 : 100, 400, Ease::OutBack);
+  }
+
+  void update(EntityManager& es, EventManager& events, TimeDelta dt) override {}
+
+  std::shared_ptr<LayoutSystem> layout_system;
+  rhea::variable width;
+  bool wide = false;
+};
+
 class LayoutEntities : public EntityX
 {
  public:
@@ -40,7 +70,8 @@ class LayoutEntities : public EntityX
     systems.add(mouse_system);
     layout_system = std::make_shared<LayoutSystem>();
     systems.add(layout_system);
-
+    button_width = std::make_shared<ButtonWidth>(layout_system);
+    systems.add(button_width);
 
     systems.configure();
 
@@ -51,8 +82,8 @@ class LayoutEntities : public EntityX
     button1.assign<Mouseable>();
     button1.assign<Layout>(0, 0, 0, 0);
 
-    layout_system->solver.add_constraints(
-        {button1.component<Layout>()->width >= 100,
+    layout_system->addConstraints(
+        {button1.component<Layout>()->width >= button_width->width,
          // button1.component<Layout>()->width == 100 | rhea::strength::strong(),
 
          button1.component<Layout>()->height >= 25,
@@ -61,23 +92,67 @@ class LayoutEntities : public EntityX
              layout_system->left_limit + layout_system->right_limit / 2.0,
          button1.component<Layout>()->y ==
              layout_system->top_limit + layout_system->bottom_limit / 2.0});
+
+    // Labels get an IntrinsicSize from the render system's glyph cache
+    layout_system->setTextMeasure([this](const vibrant::Text& text)
+                                  {
+                                    return render_system->textCache().measure(text);
+                                  });
+
+    entityx::Entity label1 = entities.create();
+    label1.assign<Body>(Vector2d(0, 0), Vector2d(0, 0));
+    label1.assign<Renderable>(
+        vibrant::Text("Button", vibrant::Font("Sans", 14), {Rgb(1, 1, 1)}), 2);
+    label1.assign<Layout>(0, 0, 0, 0);
+
+    layout_system->addConstraints(
+        {label1.component<Layout>()->x == button1.component<Layout>()->x,
+         label1.component<Layout>()->y == button1.component<Layout>()->y,
+         button1.component<Layout>()->width >= label1.component<Layout>()->width + 24,
+         button1.component<Layout>()->height >= label1.component<Layout>()->height + 8});
   }
 
   void update(TimeDelta dt, cairo_t* context)
   {
-    systems.update<EasingSystem<Body>>(dt);
-    systems.update<EasingSystem<Renderable>>(dt);
-    systems.update<LayoutSystem>(dt);
+    for (unsigned int steps = timestep.advance(dt); steps; --steps)
+    {
+      store_previous_bodies(entities);
+      stepping = easing() || step_requested;
+      step_requested = false;
+
+      systems.update<EasingSystem<Body>>(timestep.stepMs());
+      systems.update<EasingSystem<Renderable>>(timestep.stepMs());
+      systems.update<LayoutSystem>(timestep.stepMs());
+    }
 
     render_system->setContext(context);
+    render_system->setInterpolation(timestep.alpha());
     systems.update<CairoRenderSystem>(dt);
   }
 
   void updateMouse(MouseUpdate mouse) { mouse_system->update(entities, events, mouse); }
 
+  // Whether another frame would change anything
+  bool animating() { return easing() || stepping || step_requested; }
+  // Input is only applied by a step, which a frame between two steps wouldn't run
+  void requestStep() { step_requested = true; }
+
+  bool easing()
+  {
+    return systems.system<EasingSystem<Body>>()->active() ||
+           systems.system<EasingSystem<Renderable>>()->active() || layout_system->animating();
+  }
+
+  // Easing and layout advance at a fixed rate; frames in between interpolate
+  FixedTimestep timestep{60};
+  // The last step may have moved bodies, so the next one is needed to stop interpolating
+  bool stepping = false;
+  bool step_requested = false;
+
   std::shared_ptr<CairoRenderSystem> render_system;
   std::shared_ptr<MouseSystem> mouse_system;
   std::shared_ptr<LayoutSystem> layout_system;
+  std::shared_ptr<ButtonWidth> button_width;
 };
 
 class RefreshTimer : public wxTimer
@@ -96,19 +171,29 @@ class SimpleVibrantFrame : public wxFrame
   SimpleVibrantFrame(const wxString& title, const wxPoint& pos, const wxSize& size);
 
   void onPaint(wxPaintEvent& event);
-  void onRefreshTimer(wxTimerEvent& event) { Refresh(); }
+  // Only wakes the event loop so the next idle event can draw a paced frame
+  void onRefreshTimer(wxTimerEvent& event) {}
   void onIdle(wxIdleEvent& event);
   void onMouse(wxMouseEvent& event);
   void onSize(wxSizeEvent& event);
-  void draw(wxDC& dc);
+  // Presents only what changed unless the window was exposed
+  void draw(wxDC& dc, bool exposed);
+  // Copies the damaged part of the backbuffer to the window, or all of it for nullptr
+  void present(wxDC& dc, const cairo_region_t* region);
 
  private:
   LayoutEntities layout_entities;
   cairo_surface_t* backbuffer = nullptr;
   Vector2u backbuffer_size;
+#if defined(PRESENT_XLIB)
+  // Owns the backbuffer, which is shared with the X server through MIT-SHM where possible
+  std::unique_ptr<CairoXlibPresenter> presenter;
+#endif
+  CairoDamageTracker damage;
+  int presents = 0;
+  double present_ms = 0;
+  FrameScheduler scheduler;
   wxTimer refresh_timer;
-  bool first_frame = true;
-  std::chrono::steady_clock::time_point last_frame_end;
 
   wxDECLARE_EVENT_TABLE();
 };
@@ -116,7 +201,7 @@ class SimpleVibrantFrame : public wxFrame
 // clang-format off
 wxBEGIN_EVENT_TABLE(SimpleVibrantFrame, wxFrame)
   EVT_PAINT(SimpleVibrantFrame::onPaint)
-  // EVT_TIMER(-1, SimpleVibrantFrame::onRefreshTimer)
+  EVT_TIMER(-1, SimpleVibrantFrame::onRefreshTimer)
   EVT_IDLE(SimpleVibrantFrame::onIdle)
   EVT_MOUSE_EVENTS(SimpleVibrantFrame::onMouse)
   EVT_SIZE(SimpleVibrantFrame::onSize)
@@ -139,8 +224,9 @@ SimpleVibrantFrame::SimpleVibrantFrame(const wxString& title, const wxPoint& pos
                                        const wxSize& size)
     : wxFrame(NULL, wxID_ANY, title, pos, size), refresh_timer(this)
 {
-  // refresh_timer.Start(15);
   SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+  scheduler.addActivity([this] { return layout_entities.animating(); });
 }
 
 void SimpleVibrantFrame::onPaint(wxPaintEvent& event)
@@ -148,35 +234,38 @@ void SimpleVibrantFrame::onPaint(wxPaintEvent& event)
   wxPaintDC dc(this);  // mark as painted
   dc.DestroyClippingRegion();
 
-  draw(dc);
+  draw(dc, true);
 }
 
-void SimpleVibrantFrame::draw(wxDC& dc)
+void SimpleVibrantFrame::draw(wxDC& dc, bool exposed)
 {
-  auto current_time = std::chrono::steady_clock::now();
-  if (first_frame)
-  {
-    last_frame_end = current_time;
-    first_frame = false;
-  }
+  double delta_ms = scheduler.beginFrame();
 
-  auto delta_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(current_time - last_frame_end).count();
-  // if (delta_ms < 16.67)
-  if (delta_ms < 5.0) return;
-  last_frame_end = std::chrono::steady_clock::now();
-
-  // Create or recreate the back buffer
+  // Create or recreate the back buffer. It only ever grows, so shrinking the window keeps it.
   wxSize client_size = GetClientSize();
-  if (backbuffer == nullptr || backbuffer_size.x < (unsigned int)client_size.GetWidth() ||
-      backbuffer_size.y < (unsigned int)client_size.GetHeight())
+  Vector2u size(client_size.GetWidth(), client_size.GetHeight());
+  cairo_surface_t* previous_backbuffer = backbuffer;
+#if defined(PRESENT_XLIB)
+  if (!presenter)
+  {
+    GdkWindow* window = GTKGetDrawingWindow();
+    gdk_window_ensure_native(window);
+    presenter.reset(new CairoXlibPresenter(GDK_WINDOW_XDISPLAY(window), GDK_WINDOW_XID(window)));
+  }
+  backbuffer = presenter->backbuffer(size);
+  backbuffer_size = presenter->backbufferSize();
+#else
+  if (backbuffer == nullptr || backbuffer_size.x < size.x || backbuffer_size.y < size.y)
   {
     if (backbuffer) cairo_surface_destroy(backbuffer);
 
-    backbuffer = cairo_image_surface_create(CAIRO_FORMAT_RGB24, client_size.GetWidth(),
-                                            client_size.GetHeight());
-    backbuffer_size = Vector2u(client_size.GetWidth(), client_size.GetHeight());
+    backbuffer_size = Vector2u(std::max(backbuffer_size.x, size.x),
+                               std::max(backbuffer_size.y, size.y));
+    backbuffer =
+        cairo_image_surface_create(CAIRO_FORMAT_RGB24, backbuffer_size.x, backbuffer_size.y);
   }
+#endif
+  if (backbuffer != previous_backbuffer) damage.invalidate();
 
   cairo_t* context = cairo_create(backbuffer);
   cairo_set_source_rgb(context, 0.0, 0.0, 0.0);
@@ -185,6 +274,21 @@ void SimpleVibrantFrame::draw(wxDC& dc)
   // Update systems to render
   layout_entities.update(delta_ms, context);
 
+  cairo_destroy(context);
+
+  damage.frame(layout_entities.render_system->commands(), size);
+  present(dc, exposed ? nullptr : damage.region());
+
+  scheduler.endFrame();
+}
+
+void SimpleVibrantFrame::present(wxDC& dc, const cairo_region_t* region)
+{
+  auto start = std::chrono::steady_clock::now();
+
+#if defined(PRESENT_XLIB)
+  presenter->present(region);
+#else
 #if defined(CAIRO_HAS_WIN32_SURFACE)
   cairo_surface_t* surface = cairo_win32_surface_create((HDC)dc.GetHDC());
 #elif defined(CAIRO_HAS_QUARTZ_SURFACE)
@@ -196,21 +300,42 @@ void SimpleVibrantFrame::draw(wxDC& dc)
       cg_context, dc_size.GetWidth(), dc_size.GetHeight());
 #endif
   cairo_t* dc_context = cairo_create(surface);
+  clip_to_region(dc_context, region);
   cairo_set_source_surface(dc_context, backbuffer, 0, 0);
   cairo_set_operator(dc_context, CAIRO_OPERATOR_SOURCE);
   cairo_paint(dc_context);
 
   cairo_destroy(dc_context);
   cairo_surface_destroy(surface);
+#endif
 
-  cairo_destroy(context);
+  // Average present cost over the last second or so
+  present_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                    .count();
+  if (++presents == 60)
+  {
+    SetTitle(wxString::Format("Simple Vibrant Demo - present %.3f ms", present_ms / presents));
+    presents = 0;
+    present_ms = 0;
+  }
 }
 
 void SimpleVibrantFrame::onIdle(wxIdleEvent& event)
 {
-  wxClientDC dc(this);
-  draw(dc);
-  event.RequestMore();  // render continuously, not only once on idle
+  if (scheduler.frameDue())
+  {
+    wxClientDC dc(this);
+    draw(dc, false);
+  }
+
+  // While idle, wait for input rather than spinning. Otherwise wake in time for the next frame.
+  if (scheduler.idle()) return;
+
+  double wait_ms = scheduler.msUntilNextFrame();
+  if (wait_ms < 1)
+    event.RequestMore();
+  else
+    refresh_timer.StartOnce((int)wait_ms);
 }
 
 void SimpleVibrantFrame::onMouse(wxMouseEvent& event)
@@ -229,10 +354,14 @@ void SimpleVibrantFrame::onMouse(wxMouseEvent& event)
     mouse.left = ButtonState::DoubleClicked;
 
   layout_entities.updateMouse(mouse);
+  layout_entities.requestStep();
+  scheduler.invalidate();
 }
 
 void SimpleVibrantFrame::onSize(wxSizeEvent& event)
 {
   layout_entities.layout_system->setSize(Vector2u(GetClientSize().x, GetClientSize().y));
+  layout_entities.requestStep();
+  scheduler.invalidate();
   event.Skip();
 }
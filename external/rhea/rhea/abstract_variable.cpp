@@ -5,9 +5,120 @@
 //---------------------------------------------------------------------------
 #include "abstract_variable.hpp"
 
+#include <mutex>
+#include <new>
+
 namespace rhea
 {
 
-size_t abstract_variable::count_ = 0;
+abstract_variable::id_counter abstract_variable::count_{0};
+
+namespace
+{
+
+// Variables are small and made and dropped by the thousand while
+// constraints come and go, so they are carved out of slabs by size
+// class, in steps of 16 bytes.  Bigger ones use the global heap.
+const size_t granularity = 16;
+const size_t size_classes = 8;
+const size_t slab_blocks = 256;
+
+struct free_block
+{
+    free_block* next;
+};
+
+struct block_pool
+{
+    free_block* free[size_classes];
+};
+
+#ifdef RHEA_SINGLE_THREADED
+block_pool pool;
+
+free_block* take_shared(size_t)
+{
+    return nullptr;
+}
+#else
+// What threads left on their lists when they exited, for others to reuse
+std::mutex shared_mutex;
+block_pool shared_pool;
+
+free_block* take_shared(size_t size_class)
+{
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    free_block* head = shared_pool.free[size_class];
+    shared_pool.free[size_class] = nullptr;
+    return head;
+}
+
+// A block freed on another thread than the one that allocated it simply
+// joins the freeing thread's list, so the pools need no locking.  Only
+// the hand-over to the shared pool when a thread exits does.
+struct thread_pool : block_pool
+{
+    ~thread_pool()
+    {
+        std::lock_guard<std::mutex> lock(shared_mutex);
+        for (size_t i = 0; i < size_classes; ++i) {
+            if (free[i] == nullptr)
+                continue;
+
+            free_block* last = free[i];
+            while (last->next != nullptr)
+                last = last->next;
+
+            last->next = shared_pool.free[i];
+            shared_pool.free[i] = free[i];
+            free[i] = nullptr;
+        }
+    }
+};
+
+thread_local thread_pool pool;
+#endif
+
+} // anonymous namespace
+
+void* abstract_variable::operator new(std::size_t size)
+{
+    size_t size_class = (size - 1) / granularity;
+    if (size_class >= size_classes)
+        return ::operator new(size);
+
+    free_block*& head = pool.free[size_class];
+    if (head == nullptr)
+        head = take_shared(size_class);
+
+    if (head == nullptr) {
+        size_t block_size = (size_class + 1) * granularity;
+        char* slab = static_cast<char*>(
+            ::operator new(block_size * slab_blocks));
+
+        for (size_t i = 0; i < slab_blocks; ++i) {
+            auto block = reinterpret_cast<free_block*>(slab + i * block_size);
+            block->next = head;
+            head = block;
+        }
+    }
+
+    free_block* block = head;
+    head = block->next;
+    return block;
+}
+
+void abstract_variable::operator delete(void* p, std::size_t size)
+{
+    size_t size_class = (size - 1) / granularity;
+    if (size_class >= size_classes) {
+        ::operator delete(p);
+        return;
+    }
+
+    auto block = static_cast<free_block*>(p);
+    block->next = pool.free[size_class];
+    pool.free[size_class] = block;
+}
 
 } // namespace rhea
@@ -6,26 +6,44 @@
 //---------------------------------------------------------------------------
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <string>
 #include "errors.hpp"
 
 namespace rhea
 {
 
-/** Base class for variables. */
+/** Base class for variables.
+ * Variables are reference counted by the \a variable handles that point
+ * to them, and allocated from pools of fixed-size blocks.  The counts are
+ * atomic unless rhea is built with RHEA_SINGLE_THREADED, in which case
+ * handles to the same variable must not be used from several threads. */
 class abstract_variable
 {
 public:
     abstract_variable()
         : id_{++count_}
+        , refs_{0}
     {
     }
 
+    abstract_variable(const abstract_variable&) = delete;
+    abstract_variable& operator=(const abstract_variable&) = delete;
+
     virtual ~abstract_variable() {}
 
     size_t id() const { return id_; }
 
+    /** Allocate from the pool for blocks of this size.
+     *  Blocks are reused by the thread that frees them, or by any thread
+     *  once that one has exited.  The memory is never given back to the
+     *  system. */
+    static void* operator new(std::size_t size);
+
+    static void operator delete(void* p, std::size_t size);
+
     /** Return true if this is a floating point variable.
      * \sa float_variable */
     virtual bool is_float() const { return false; }
@@ -73,12 +91,38 @@ public:
     /** Get the value as a string. */
     virtual std::string to_string() const { return "abstract"; }
 
+private:
+    friend class variable;
+
+#ifdef RHEA_SINGLE_THREADED
+    typedef size_t id_counter;
+    typedef unsigned ref_counter;
+
+    void retain() const { ++refs_; }
+
+    /** \return True if this was the last reference */
+    bool release() const { return --refs_ == 0; }
+#else
+    typedef std::atomic<size_t> id_counter;
+    typedef std::atomic<unsigned> ref_counter;
+
+    void retain() const { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    bool release() const
+    {
+        return refs_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+#endif
+
 private:
     // Not happy with this, but it appears the algorithm needs this to run
     // with the autosolver turned off.  (Expression terms need a stable
     // iteration order, see also Github issue #16.)
-    static size_t count_;
+    // Atomic unless single threaded, so variables can be made on one
+    // thread while a solver on another makes its own.
+    static id_counter count_;
     size_t id_;
+    mutable ref_counter refs_;
 };
 
 } // namespace rhea
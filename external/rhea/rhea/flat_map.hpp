@@ -56,12 +56,15 @@ public:
 };
 }
 
+/** A map kept as a sorted sequence.
+ * \tparam S  The sequence that holds the elements, std::vector by default
+ */
 template <class K, class V, class C = std::less<K>,
-          class A = std::allocator<std::pair<K, V>>>
-class flat_map : private std::vector<std::pair<K, V>, A>,
-                 private detail::flat_map_compare<V, C>
+          class A = std::allocator<std::pair<K, V>>,
+          class S = std::vector<std::pair<K, V>, A>>
+class flat_map : private S, private detail::flat_map_compare<V, C>
 {
-    typedef std::vector<std::pair<K, V>, A> base_type;
+    typedef S base_type;
     typedef detail::flat_map_compare<V, C> compare_type;
 
 public:
@@ -82,7 +85,7 @@ public:
     typedef typename base_type::reverse_iterator reverse_iterator;
     typedef typename base_type::const_reverse_iterator const_reverse_iterator;
 
-    typedef flat_map<K, V, C, A> self;
+    typedef flat_map<K, V, C, A, S> self;
 
     class value_compare
         : public std::binary_function<value_type, value_type, bool>,
@@ -292,9 +295,9 @@ public:
         return std::equal_range(begin(), end(), k, me);
     }
 
-    template <class K1, class V1, class C1, class A1>
-    friend bool operator==(const flat_map<K1, V1, C1, A1>& lhs,
-                           const flat_map<K1, V1, C1, A1>& rhs);
+    template <class K1, class V1, class C1, class A1, class S1>
+    friend bool operator==(const flat_map<K1, V1, C1, A1, S1>& lhs,
+                           const flat_map<K1, V1, C1, A1, S1>& rhs);
 
     bool operator<(const flat_map& rhs) const
     {
@@ -303,61 +306,61 @@ public:
         return me < yo;
     }
 
-    template <class K1, class V1, class C1, class A1>
-    friend bool operator!=(const flat_map<K1, V1, C1, A1>& lhs,
-                           const flat_map<K1, V1, C1, A1>& rhs);
+    template <class K1, class V1, class C1, class A1, class S1>
+    friend bool operator!=(const flat_map<K1, V1, C1, A1, S1>& lhs,
+                           const flat_map<K1, V1, C1, A1, S1>& rhs);
 
-    template <class K1, class V1, class C1, class A1>
-    friend bool operator>(const flat_map<K1, V1, C1, A1>& lhs,
-                          const flat_map<K1, V1, C1, A1>& rhs);
+    template <class K1, class V1, class C1, class A1, class S1>
+    friend bool operator>(const flat_map<K1, V1, C1, A1, S1>& lhs,
+                          const flat_map<K1, V1, C1, A1, S1>& rhs);
 
-    template <class K1, class V1, class C1, class A1>
-    friend bool operator>=(const flat_map<K1, V1, C1, A1>& lhs,
-                           const flat_map<K1, V1, C1, A1>& rhs);
+    template <class K1, class V1, class C1, class A1, class S1>
+    friend bool operator>=(const flat_map<K1, V1, C1, A1, S1>& lhs,
+                           const flat_map<K1, V1, C1, A1, S1>& rhs);
 
-    template <class K1, class V1, class C1, class A1>
-    friend bool operator<=(const flat_map<K1, V1, C1, A1>& lhs,
-                           const flat_map<K1, V1, C1, A1>& rhs);
+    template <class K1, class V1, class C1, class A1, class S1>
+    friend bool operator<=(const flat_map<K1, V1, C1, A1, S1>& lhs,
+                           const flat_map<K1, V1, C1, A1, S1>& rhs);
 };
 
-template <class K, class V, class C, class A>
-inline bool operator==(const flat_map<K, V, C, A>& lhs,
-                       const flat_map<K, V, C, A>& rhs)
+template <class K, class V, class C, class A, class S>
+inline bool operator==(const flat_map<K, V, C, A, S>& lhs,
+                       const flat_map<K, V, C, A, S>& rhs)
 {
-    const std::vector<std::pair<K, V>, A>& me(lhs);
+    const S& me(lhs);
     return me == rhs;
 }
 
-template <class K, class V, class C, class A>
-inline bool operator!=(const flat_map<K, V, C, A>& lhs,
-                       const flat_map<K, V, C, A>& rhs)
+template <class K, class V, class C, class A, class S>
+inline bool operator!=(const flat_map<K, V, C, A, S>& lhs,
+                       const flat_map<K, V, C, A, S>& rhs)
 {
     return !(lhs == rhs);
 }
 
-template <class K, class V, class C, class A>
-inline bool operator>(const flat_map<K, V, C, A>& lhs,
-                      const flat_map<K, V, C, A>& rhs)
+template <class K, class V, class C, class A, class S>
+inline bool operator>(const flat_map<K, V, C, A, S>& lhs,
+                      const flat_map<K, V, C, A, S>& rhs)
 {
     return rhs < lhs;
 }
 
-template <class K, class V, class C, class A>
-inline bool operator>=(const flat_map<K, V, C, A>& lhs,
-                       const flat_map<K, V, C, A>& rhs)
+template <class K, class V, class C, class A, class S>
+inline bool operator>=(const flat_map<K, V, C, A, S>& lhs,
+                       const flat_map<K, V, C, A, S>& rhs)
 {
     return !(lhs < rhs);
 }
 
-template <class K, class V, class C, class A>
-inline bool operator<=(const flat_map<K, V, C, A>& lhs,
-                       const flat_map<K, V, C, A>& rhs)
+template <class K, class V, class C, class A, class S>
+inline bool operator<=(const flat_map<K, V, C, A, S>& lhs,
+                       const flat_map<K, V, C, A, S>& rhs)
 {
     return !(rhs < lhs);
 }
 
-template <class K, class V, class C, class A>
-void swap(flat_map<K, V, C, A>& lhs, flat_map<K, V, C, A>& rhs)
+template <class K, class V, class C, class A, class S>
+void swap(flat_map<K, V, C, A, S>& lhs, flat_map<K, V, C, A, S>& rhs)
 {
     lhs.swap(rhs);
 }
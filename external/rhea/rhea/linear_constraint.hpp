@@ -17,11 +17,11 @@ namespace rhea
 class linear_constraint : public abstract_constraint
 {
 public:
-    linear_constraint(const linear_expression& expr = linear_expression(),
+    linear_constraint(linear_expression expr = linear_expression(),
                       const strength& s = strength::required(),
                       double weight = 1.0)
         : abstract_constraint{s, weight}
-        , expr_{expr}
+        , expr_{std::move(expr)}
     {
     }
 
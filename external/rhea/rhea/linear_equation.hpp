@@ -77,13 +77,15 @@ public:
 
 inline linear_equation operator==(linear_expression lhs, const variable& rhs)
 {
-    return lhs -= rhs;
+    lhs -= rhs;
+    return lhs;
 }
 
 inline linear_equation operator==(linear_expression lhs,
                                   const linear_expression& rhs)
 {
-    return lhs -= rhs;
+    lhs -= rhs;
+    return lhs;
 }
 
 inline linear_equation operator==(const variable& lhs,
@@ -94,7 +96,7 @@ inline linear_equation operator==(const variable& lhs,
 
 inline linear_equation operator==(const variable& lhs, const variable& rhs)
 {
-    return linear_expression{lhs} -= rhs;
+    return lhs - rhs;
 }
 
 inline linear_equation operator==(const variable& lhs, double rhs)
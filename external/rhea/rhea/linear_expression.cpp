@@ -9,7 +9,6 @@
 #include <cmath>
 
 #include "approx.hpp"
-#include "tableau.hpp"
 
 namespace rhea
 {
@@ -105,35 +104,6 @@ linear_expression& linear_expression::operator-=(const term& x)
     return *this;
 }
 
-linear_expression& linear_expression::add(const linear_expression& x,
-                                          const variable& subject,
-                                          tableau& solver)
-{
-    constant_ += x.constant_;
-    for (const auto& p : x.terms_)
-        add(p.first, p.second, subject, solver);
-
-    return *this;
-}
-
-linear_expression& linear_expression::add(const variable& v, double c,
-                                          const variable& subject,
-                                          tableau& solver)
-{
-    auto i = terms_.find(v);
-    if (i == terms_.end()) {
-        if (!near_zero(c)) {
-            terms_[v] = c;
-            solver.note_added_variable(v, subject);
-        }
-    } else if (near_zero(i->second += c)) {
-        terms_.erase(i);
-        solver.note_removed_variable(v, subject);
-    }
-
-    return *this;
-}
-
 variable linear_expression::find_pivotable_variable() const
 {
     assert(!is_constant());
@@ -175,37 +145,4 @@ void linear_expression::change_subject(const variable& old_subj,
     terms_[old_subj] = tmp;
 }
 
-void linear_expression::substitute_out(const variable& var,
-                                       const linear_expression& expr,
-                                       const variable& subj, tableau& solver)
-{
-    auto it = terms_.find(var);
-    if (it == terms_.end()) {
-        throw std::runtime_error(
-            "substitute variable is not part of the expression");
-    }
-    double multiplier = it->second;
-    terms_.erase(it);
-
-    if (near_zero(multiplier))
-        return;
-
-    increment_constant(multiplier * expr.constant());
-    for (auto& p : expr.terms()) {
-        const variable& v = p.first;
-        double mc = multiplier * p.second;
-
-        auto oc = terms_.find(v);
-        if (oc != terms_.end()) {
-            if (near_zero(oc->second += mc)) {
-                solver.note_removed_variable(oc->first, subj);
-                terms_.erase(oc);
-            }
-        } else {
-            terms_[v] = mc;
-            solver.note_added_variable(v, subj);
-        }
-    }
-}
-
 } // namespace rhea
@@ -7,14 +7,13 @@
 #pragma once
 
 #include "flat_map.hpp"
+#include "small_vector.hpp"
 #include "approx.hpp"
 #include "variable.hpp"
 
 namespace rhea
 {
 
-class tableau;
-
 /** Linear expression.
  * Expressions have the form \f$av_0 + bv_1 + \ldots + c\f$, where \f$v_n\f$
  * is a variable, \f$a, b, \ldots{}\f$ are non-zero coefficients, and
@@ -36,10 +35,13 @@ public:
     // It would be nice to use an unordered_map here, but it appears
     // the algorithm is sensitive to the order in which the terms are
     // iterated. (Github issue #16.)
-    typedef flat_map<variable, double> terms_map;
+    // Most expressions have only a few terms, which are kept inline.
+    typedef std::pair<variable, double> value_type;
+    typedef flat_map<variable, double, std::less<variable>,
+                     std::allocator<value_type>,
+                     small_vector<value_type, 4>> terms_map;
 
-    typedef terms_map::value_type value_type;
-    typedef terms_map::value_type term;
+    typedef value_type term;
 
 public:
     linear_expression(double num = 0);
@@ -85,25 +87,6 @@ public:
         return *this;
     }
 
-    /** Add \a expr to this expression.
-     * Notifies the solver if a variable is added or deleted from this
-     * expression. */
-    linear_expression& add(const linear_expression& expr,
-                           const variable& subject, tableau& solver);
-
-    /** Add a term \f$c\cdot{}v\f$ to this expression.
-     *  If the expression already contains a term involving v, it adds c
-     *  to the existing coefficient. If the new coefficient is approximately
-     *  zero, v is removed from the expression. The solver is notified if
-     *  v is added or removed.
-     * \param v     The variable to be added
-     * \param c     The coefficient
-     * \param subj  The subject to report back to the solver
-     * \param solver The solver that will be informed of any added or
-     *               removed variables */
-    linear_expression& add(const variable& v, double c,
-                           const variable& subject, tableau& solver);
-
     /** Erase a variable from the expression. */
     void erase(const variable& v) { terms_.erase(v); }
 
@@ -114,18 +97,6 @@ public:
      *         was found. */
     variable find_pivotable_variable() const;
 
-    /** Replace \a var with a symbolic expression that is equal to it.
-     * If a variable has been added to this expression that wasn't there
-     * before, or if a variable has been dropped from this expression
-     * because it now has a coefficient of 0, inform the solver.
-     * \param v     The variable to be replaced
-     * \param expr  The expression to replace it with
-     * \param subj  The subject to report back to the solver
-     * \param solver The solver that will be informed of any added or
-     *               removed variables */
-    void substitute_out(const variable& v, const linear_expression& expr,
-                        const variable& subj, tableau& solver);
-
     /** This linear expression currently represents the equation
      ** oldSubject=self, destructively modify it so that it represents
      ** the equation NewSubject=self.
@@ -194,41 +165,64 @@ private:
 
 inline linear_expression operator*(linear_expression e, double x)
 {
-    return e *= x;
+    e *= x;
+    return e;
 }
 
 inline linear_expression operator*(double x, linear_expression e)
 {
-    return e *= x;
+    e *= x;
+    return e;
 }
 
 inline linear_expression operator/(linear_expression e, double x)
 {
-    return e /= x;
+    e /= x;
+    return e;
 }
 
 inline linear_expression operator*(linear_expression e,
                                    const linear_expression& x)
 {
-    return e *= x;
+    e *= x;
+    return e;
 }
 
 inline linear_expression operator/(linear_expression e,
                                    const linear_expression& x)
 {
-    return e /= x;
+    e /= x;
+    return e;
 }
 
 inline linear_expression operator+(linear_expression e,
                                    const linear_expression& x)
 {
-    return e += x;
+    e += x;
+    return e;
 }
 
 inline linear_expression operator-(linear_expression e,
                                    const linear_expression& x)
 {
-    return e -= x;
+    e -= x;
+    return e;
+}
+
+/** Reuse the right-hand side's terms when it is a temporary. */
+inline linear_expression operator+(const linear_expression& x,
+                                   linear_expression&& e)
+{
+    e += x;
+    return std::move(e);
+}
+
+inline linear_expression operator-(const linear_expression& x,
+                                   linear_expression&& e)
+{
+    e *= -1;
+    e += x;
+    return std::move(e);
 }
 
 //--------------------------------------------------------------------------
@@ -290,12 +284,16 @@ inline linear_expression operator-(int x, const variable& v)
 
 inline linear_expression operator+(const variable& v, const variable& w)
 {
-    return linear_expression(v) += w;
+    linear_expression e{v};
+    e += w;
+    return e;
 }
 
 inline linear_expression operator-(const variable& v, const variable& w)
 {
-    return linear_expression(v) -= w;
+    linear_expression e{v};
+    e -= w;
+    return e;
 }
 
 } // namespace rhea
@@ -17,21 +17,17 @@ namespace rhea
 
 simplex_solver::simplex_solver()
     : solver()
-    , objective_(std::make_shared<objective_variable>())
     , auto_reset_stay_constants_(true)
     , needs_solving_(false)
     , explain_failure_(false)
 {
-    rows_[objective_]; // Create an empty row for the objective
+    // Create an empty row for the objective
+    objective_ = intern(variable::make<objective_variable>());
+    row empty;
+    add_row(objective_, empty);
     cedcns_.push(0);
 }
 
-template <typename container, typename func>
-void remove_from_container_if(container& c, func pred)
-{
-    c.erase(std::remove_if(c.begin(), c.end(), pred));
-}
-
 simplex_solver::expression_result
 simplex_solver::make_expression(const constraint& c)
 {
@@ -39,15 +35,18 @@ simplex_solver::make_expression(const constraint& c)
 
     auto& expr = result.expr;
     auto cexpr = c.expression();
-    expr.set_constant(cexpr.constant());
+    expr.constant = cexpr.constant();
 
     for (const auto& term : cexpr.terms()) {
-        if (is_basic_var(term.first))
-            expr += row_expression(term.first) * term.second;
+        index v = intern(term.first);
+        if (is_basic(v))
+            add_to(expr, row_of(v), term.second);
         else
-            expr += term;
+            add_to(expr, v, term.second);
     }
 
+    index objective_slot = vars_[objective_].row;
+
     if (c.is_inequality()) {
         // cn is an inequality, so add a slack variable.  The original
         // constraint is expr>=0, so that the resulting equality is
@@ -57,19 +56,18 @@ simplex_solver::make_expression(const constraint& c)
         //    expr - slackVar + errorVar = 0.
         // Since both of these variables are newly created we can just add
         // them to the expression (they can't be basic).
-        variable slack{std::make_shared<slack_variable>()};
-        expr.set(slack, -1);
+        variable slack{variable::make<slack_variable>()};
+        add_to(expr, intern(slack), -1);
         marker_vars_[c] = slack;
         constraints_marked_[slack] = c;
 
         if (!c.is_required()) {
-            variable eminus{std::make_shared<slack_variable>()};
-            expr.set(eminus, 1);
-            linear_expression& row = row_expression(objective_);
+            variable eminus{variable::make<slack_variable>()};
+            index em = intern(eminus);
+            add_to(expr, em, 1);
             double sw{c.adjusted_symbolic_weight()};
-            row += linear_expression::term(eminus, sw);
+            add_to(rows_[objective_slot], em, sw, objective_slot);
             error_vars_[c].insert(eminus);
-            note_added_variable(eminus, objective_);
         }
     } else {
         // c is an equality
@@ -77,18 +75,21 @@ simplex_solver::make_expression(const constraint& c)
             // Add a dummy variable to the Expression to serve as a marker
             // for this constraint.  The dummy variable is never allowed to
             // enter the basis when pivoting.
-            variable dum{std::make_shared<dummy_variable>()};
+            variable dum{variable::make<dummy_variable>()};
 
             if (c.is_stay_constraint()) {
-                stay_plus_error_vars_.push_back(dum);
-                stay_minus_error_vars_.push_back(dum);
+                index d = intern(dum);
+                stay_plus_error_vars_.push_back(d);
+                stay_minus_error_vars_.push_back(d);
+                pin(d);
+                pin(d);
             } else if (c.is_edit_constraint()) {
-                result.previous_constant = c.expression().constant();
+                result.previous_constant = cexpr.constant();
                 result.plus = dum;
                 result.minus = dum;
             }
 
-            expr.set(dum, 1);
+            add_to(expr, intern(dum), 1);
             marker_vars_[c] = dum;
             constraints_marked_[dum] = c;
         } else {
@@ -96,41 +97,41 @@ simplex_solver::make_expression(const constraint& c)
             // error variable, making the resulting constraint
             //       expr = eplus - eminus,
             // in other words:  expr-eplus+eminus=0
-            variable eplus{std::make_shared<slack_variable>()};
-            variable eminus{std::make_shared<slack_variable>()};
+            variable eplus{variable::make<slack_variable>()};
+            variable eminus{variable::make<slack_variable>()};
+            index ep = intern(eplus), em = intern(eminus);
 
-            expr.set(eplus, -1);
-            expr.set(eminus, 1);
+            add_to(expr, ep, -1);
+            add_to(expr, em, 1);
 
             marker_vars_[c] = eplus;
             constraints_marked_[eplus] = c;
 
-            auto& rowexp = row_expression(objective_);
             double coeff = c.adjusted_symbolic_weight();
 
-            rowexp.set(eplus, coeff);
-            note_added_variable(eplus, objective_);
+            add_to(rows_[objective_slot], ep, coeff, objective_slot);
             error_vars_[c].insert(eplus);
 
-            rowexp.set(eminus, coeff);
-            note_added_variable(eminus, objective_);
+            add_to(rows_[objective_slot], em, coeff, objective_slot);
             error_vars_[c].insert(eminus);
 
             if (c.is_stay_constraint()) {
-                stay_plus_error_vars_.emplace_back(std::move(eplus));
-                stay_minus_error_vars_.emplace_back(std::move(eminus));
+                stay_plus_error_vars_.push_back(ep);
+                stay_minus_error_vars_.push_back(em);
+                pin(ep);
+                pin(em);
             } else if (c.is_edit_constraint()) {
                 result.plus = std::move(eplus);
                 result.minus = std::move(eminus);
-                result.previous_constant = c.expression().constant();
+                result.previous_constant = cexpr.constant();
             }
         }
     }
 
     // the Constant in the Expression should be non-negative.
     // If necessary normalize the Expression by multiplying by -1
-    if (expr.constant() < 0)
-        expr *= -1;
+    if (expr.constant < 0)
+        negate(expr);
 
     return result;
 }
@@ -162,6 +163,7 @@ solver& simplex_solver::add_constraint_(const constraint& c)
         }
     }
 
+    collect_unused();
     needs_solving_ = true;
 
     if (c.is_edit_constraint()) {
@@ -181,17 +183,17 @@ solver& simplex_solver::remove_constraint_(const constraint& c)
     needs_solving_ = true;
     reset_stay_constants();
 
-    auto& rowexpr = row_expression(objective_);
+    index objective_slot = vars_[objective_].row;
     auto i = error_vars_.find(c);
     if (i != error_vars_.end()) {
         for (const variable& var : i->second) {
-            if (is_basic_var(var)) {
-                const linear_expression& expr = row_expression(var);
-                rowexpr.add(expr * -c.adjusted_symbolic_weight(), objective_,
-                            *this);
+            index v = intern(var);
+            if (is_basic(v)) {
+                add_to(rows_[objective_slot], row_of(v),
+                       -c.adjusted_symbolic_weight(), objective_slot);
             } else {
-                rowexpr.add(var, -c.adjusted_symbolic_weight(), objective_,
-                            *this);
+                add_to(rows_[objective_slot], v,
+                       -c.adjusted_symbolic_weight(), objective_slot);
             }
         }
     }
@@ -200,29 +202,29 @@ solver& simplex_solver::remove_constraint_(const constraint& c)
     if (im == marker_vars_.end())
         throw constraint_not_found();
 
-    variable marker{im->second};
+    index marker = intern(im->second);
+    constraints_marked_.erase(im->second);
     marker_vars_.erase(im);
-    constraints_marked_.erase(marker);
 
-    if (!is_basic_var(marker)) {
+    if (!is_basic(marker)) {
         // Try to make this marker variable basic.
-        auto& col = columns_[marker];
+        const auto& col = vars_[marker].column;
         bool exit_var_set = false;
         double min_ratio = 0.0;
-        variable exit_var{variable::nil_var()};
+        index exit_var = nil;
 
-        for (auto& v : col) {
-            if (v.is_restricted()) {
-                auto& expr = row_expression(v);
-                double coeff = expr.coefficient(marker);
+        for (index slot : col) {
+            const row& expr = rows_[slot];
+            if (vars_[expr.basic].restricted) {
+                double coeff = coefficient(expr, marker);
 
                 if (coeff >= 0.0)
                     continue; // Only consider negative coefficients
 
-                double r = -expr.constant() / coeff;
+                double r = -expr.constant / coeff;
                 if (!exit_var_set || r < min_ratio) {
                     min_ratio = r;
-                    exit_var = v;
+                    exit_var = expr.basic;
                     exit_var_set = true;
                 }
             }
@@ -237,15 +239,15 @@ solver& simplex_solver::remove_constraint_(const constraint& c)
         // the marker variable.  In effect we are removing the
         // non-negativity restriction on the marker variable.)
         if (!exit_var_set) {
-            for (auto& v : col) {
-                if (v.is_restricted()) {
-                    auto& expr = row_expression(v);
-                    double coeff = expr.coefficient(marker);
-                    double r = expr.constant() / coeff;
+            for (index slot : col) {
+                const row& expr = rows_[slot];
+                if (vars_[expr.basic].restricted) {
+                    double coeff = coefficient(expr, marker);
+                    double r = expr.constant / coeff;
 
                     if (!exit_var_set || r < min_ratio) {
                         min_ratio = r;
-                        exit_var = v;
+                        exit_var = expr.basic;
                         exit_var_set = true;
                     }
                 }
@@ -260,9 +262,9 @@ solver& simplex_solver::remove_constraint_(const constraint& c)
             if (col.empty()) {
                 remove_column(marker);
             } else {
-                for (auto& v : col) {
-                    if (!v.is(objective_)) {
-                        exit_var = v;
+                for (index slot : col) {
+                    if (rows_[slot].basic != objective_) {
+                        exit_var = rows_[slot].basic;
                         exit_var_set = true;
                         break;
                     }
@@ -274,30 +276,60 @@ solver& simplex_solver::remove_constraint_(const constraint& c)
             pivot(marker, exit_var);
     }
 
-    if (is_basic_var(marker))
+    if (is_basic(marker))
         remove_row(marker);
 
     // Delete any error variables.  If cn is an inequality, it also
     // contains a slack variable; but we use that as the marker variable
     // and so it has been deleted when we removed its row.
     if (i != error_vars_.end()) {
-        for (const auto& v : i->second) {
-            if (!v.is(marker))
+        for (const auto& var : i->second) {
+            index v = find(var);
+            if (v != nil && v != marker)
                 remove_column(v);
         }
     }
 
+    // A variable that is left in no row but the objective is free to take
+    // any value, so its coefficient there can only be rounding error that
+    // survived the subtractions above.  Left alone, it would keep the
+    // variable in the tableau for good.
+    auto cexpr = c.expression();
+    for (auto& term : cexpr.terms()) {
+        index v = find(term.first);
+        if (v == nil || vars_[v].restricted || is_basic(v))
+            continue;
+
+        const auto& col = vars_[v].column;
+        if (col.size() == 1 && col[0] == objective_slot) {
+            add_to(rows_[objective_slot], v,
+                   -coefficient(rows_[objective_slot], v), objective_slot);
+        }
+    }
+
     if (c.is_stay_constraint()) {
         if (i != error_vars_.end()) {
-            auto pred = [&](variable x) { return i->second.count(x) > 0; };
-            remove_from_container_if(stay_plus_error_vars_, pred);
-            remove_from_container_if(stay_minus_error_vars_, pred);
+            auto pred = [&](index x) {
+                if (i->second.count(vars_[x].var) == 0)
+                    return false;
+
+                unpin(x);
+                return true;
+            };
+            auto& plus = stay_plus_error_vars_;
+            auto& minus = stay_minus_error_vars_;
+            plus.erase(std::remove_if(plus.begin(), plus.end(), pred),
+                       plus.end());
+            minus.erase(std::remove_if(minus.begin(), minus.end(), pred),
+                        minus.end());
         }
     } else if (c.is_edit_constraint()) {
         auto ei = std::find(edit_info_list_.begin(), edit_info_list_.end(),
                             c);
         assert(ei != edit_info_list_.end());
-        remove_column(ei->minus);
+        index minus = find(ei->minus);
+        if (minus != nil)
+            remove_column(minus);
         // ei->plus is a marker and will be removed later
         edit_info_list_.erase(ei);
     }
@@ -305,6 +337,8 @@ solver& simplex_solver::remove_constraint_(const constraint& c)
     if (i != error_vars_.end())
         error_vars_.erase(i);
 
+    collect_unused();
+
     if (auto_solve_)
         solve_();
 
@@ -315,7 +349,7 @@ void simplex_solver::resolve()
 {
     dual_optimize();
     set_external_variables();
-    infeasible_rows_.clear();
+    clear_infeasible();
     if (auto_reset_stay_constants_)
         reset_stay_constants();
 }
@@ -395,19 +429,19 @@ void simplex_solver::solve_()
 }
 
 std::pair<bool, constraint_list>
-simplex_solver::add_with_artificial_variable(linear_expression& expr)
+simplex_solver::add_with_artificial_variable(row& expr)
 {
     // The artificial objective is av, which we know is equal to expr
     // (which contains only parametric variables).
-    variable av{std::make_shared<slack_variable>()};
-    variable az{std::make_shared<objective_variable>()};
-    linear_expression row{expr};
+    index av = intern(variable::make<slack_variable>());
+    index az = intern(variable::make<objective_variable>());
+    row az_row(expr);
 
     // Objective is treated as a row in the tableau,
     // so do the substitution for its value (we are minimizing
     // the artificial variable).
     // This row will be removed from the tableau after optimizing.
-    add_row(az, row);
+    add_row(az, az_row);
 
     // Add the normal row to the tableau -- when artifical
     // variable is minimized to 0 (if possible)
@@ -423,11 +457,11 @@ simplex_solver::add_with_artificial_variable(linear_expression& expr)
 
     // Careful, we want to get the Expression that is in
     // the tableau, not the one we initialized it with!
-    auto& tableau_row = row_expression(az);
+    const row& tableau_row = row_of(az);
 
     // Check that we were able to make the objective value 0
     // If not, the original constraint was not satisfiable
-    if (!near_zero(tableau_row.constant())) {
+    if (!near_zero(tableau_row.constant)) {
         constraint_list result;
         if (explain_failure_)
             result = build_explanation(az, tableau_row);
@@ -435,30 +469,33 @@ simplex_solver::add_with_artificial_variable(linear_expression& expr)
         return std::make_pair(false, result);
     }
 
-    if (is_basic_var(av)) {
-        const auto& e = row_expression(av);
+    if (is_basic(av)) {
+        const row& e = row_of(av);
 
         // Find another variable in this row and Pivot, so that av becomes
         // parametric
         // If there isn't another variable in the row then
         // the tableau contains the equation av = 0  -- just delete av's row
-        if (e.is_constant()) {
-            assert(near_zero(e.constant()));
+        if (e.terms.empty()) {
+            assert(near_zero(e.constant));
             remove_row(av);
+            remove_row(az);
             return {true, constraint_list()};
         }
-        variable entry(e.find_pivotable_variable());
-        if (entry.is_nil()) {
+        auto entry = std::find_if(
+            e.terms.begin(), e.terms.end(),
+            [&](const term& t) { return vars_[t.var].pivotable; });
+        if (entry == e.terms.end()) {
             constraint_list result;
             if (explain_failure_)
                 result = build_explanation(av, e);
 
             return {false, result};
         }
-        pivot(entry, av);
+        pivot(entry->var, av);
     }
 
-    assert(is_parametric_var(av));
+    assert(!is_basic(av));
     remove_column(av);
     remove_row(az);
 
@@ -474,14 +511,14 @@ simplex_solver& simplex_solver::remove_edit_vars_to(size_t n)
     return *this;
 }
 
-bool simplex_solver::try_adding_directly(linear_expression& expr)
+bool simplex_solver::try_adding_directly(row& expr)
 {
-    variable subj{choose_subject(expr)};
-    if (subj.is_nil())
+    index subj = choose_subject(expr);
+    if (subj == nil)
         return false;
 
-    expr.new_subject(subj);
-    if (columns_has_key(subj))
+    new_subject(expr, subj);
+    if (!vars_[subj].column.empty())
         substitute_out(subj, expr);
 
     add_row(subj, expr);
@@ -499,14 +536,14 @@ simplex_solver& simplex_solver::remove_edit_var(const variable& v)
     return *this;
 }
 
-variable simplex_solver::choose_subject(linear_expression& expr)
+tableau::index simplex_solver::choose_subject(row& expr)
 {
-    variable subj{variable::nil_var()};
+    index subj = nil;
     bool found_unrestricted = false, found_new_restricted = false;
 
-    for (auto& term : expr.terms()) {
-        const variable& v = term.first;
-        double c = term.second;
+    for (auto& term : expr.terms) {
+        const var_info& v = vars_[term.var];
+        double c = term.coeff;
 
         if (found_unrestricted) {
             // We have already found an unrestricted variable.  The only
@@ -514,10 +551,10 @@ variable simplex_solver::choose_subject(linear_expression& expr)
             // 'subject' is if v is unrestricted and new to the solver and
             // 'subject' isn't new.  If this is the case just pick v
             // immediately and return.
-            if (!v.is_restricted() && !columns_has_key(v))
-                return v;
+            if (!v.restricted && v.column.empty())
+                return term.var;
         } else {
-            if (v.is_restricted()) {
+            if (v.restricted) {
                 // v is restricted.  If we have already found a suitable
                 // restricted variable just stick with that.  Otherwise, if v
                 // is new to the solver and has a negative coefficient pick
@@ -526,38 +563,34 @@ variable simplex_solver::choose_subject(linear_expression& expr)
                 // new to the solver, since error variables are added to the
                 // objective function when we make the Expression.  We also
                 // never pick a dummy variable here.
-                if (!found_new_restricted && !v.is_dummy() && c < 0.0) {
-                    auto i(columns_.find(v));
-                    if (i == columns_.end()
-                        || (columns_.size() == 1
-                            && columns_has_key(objective_))) {
-                        subj = v;
-                        found_new_restricted = true;
-                    }
+                if (!found_new_restricted && !v.dummy && c < 0.0
+                    && v.column.empty()) {
+                    subj = term.var;
+                    found_new_restricted = true;
                 }
             } else {
                 // v is unrestricted.
                 // If v is also new to the solver just pick it now.
-                subj = v;
+                subj = term.var;
                 found_unrestricted = true;
             }
         }
     }
 
-    if (!subj.is_nil())
+    if (subj != nil)
         return subj;
 
     // Make one last check -- if all of the variables in expr are dummy
     // variables, then we can pick a dummy variable as the subject.
     double coeff = 0.0;
-    for (auto& term : expr.terms()) {
-        const variable& v = term.first;
-        if (!v.is_dummy())
-            return variable::nil_var(); // Nope, no luck.
-
-        if (!columns_has_key(v)) {
-            subj = v;
-            coeff = term.second;
+    for (auto& term : expr.terms) {
+        const var_info& v = vars_[term.var];
+        if (!v.dummy)
+            return nil; // Nope, no luck.
+
+        if (v.column.empty()) {
+            subj = term.var;
+            coeff = term.coeff;
         }
     }
 
@@ -565,33 +598,31 @@ variable simplex_solver::choose_subject(linear_expression& expr)
     // be dummy variables.  If the constant is nonzero we are trying to
     // add an unsatisfiable required constraint.  (Remember that dummy
     // variables must take on a value of 0.)
-    if (!near_zero(expr.constant()))
+    if (!near_zero(expr.constant))
         throw required_failure();
 
     // Otherwise, if the constant is zero, multiply by -1 if necessary to
     // make the coefficient for the subject negative.
     if (coeff > 0)
-        expr *= -1;
+        negate(expr);
 
     return subj;
 }
 
-void simplex_solver::optimize(const variable& v)
+void simplex_solver::optimize(index z)
 {
-    std::less<variable> ord;
-    auto& row = row_expression(v);
-
-    variable entry(variable::nil_var()), exit(variable::nil_var());
-
     while (true) {
+        index entry = nil, exit = nil;
+        double entry_coeff = 0.0;
+
         // Find the most negative coefficient in the objective function
         // (ignoring the non-pivotable dummy variables).  If all
         // coefficients are positive we're done.
         bool found_negative = false;
-        for (auto& p : row.terms()) {
-            const auto& var = p.first;
-            if (var.is_pivotable() && p.second < 0.0) {
-                entry = var;
+        for (auto& p : row_of(z).terms) {
+            if (vars_[p.var].pivotable && p.coeff < 0.0) {
+                entry = p.var;
+                entry_coeff = p.coeff;
                 found_negative = true;
                 break;
             }
@@ -607,28 +638,34 @@ void simplex_solver::optimize(const variable& v)
         // (i.e. restricted, non-dummy variables).
         double min_ratio{std::numeric_limits<double>::max()};
         double r = 0.0;
-        for (const variable& var : columns_[entry]) {
-            if (var.is_pivotable()) {
-                const auto& expr = row_expression(var);
-                double coeff = expr.coefficient(entry);
+        for (index slot : vars_[entry].column) {
+            const row& expr = rows_[slot];
+            if (vars_[expr.basic].pivotable) {
+                double coeff = coefficient(expr, entry);
 
                 if (coeff >= 0) // Only consider negative coefficients
                     continue;
 
-                r = -expr.constant() / coeff;
-                if (r < min_ratio || (approx(r, min_ratio) && ord(var, exit))) {
+                r = -expr.constant / coeff;
+                if (r < min_ratio
+                    || (approx(r, min_ratio) && exit != nil
+                        && vars_[expr.basic].key < vars_[exit].key)) {
                     min_ratio = r;
-                    exit = var;
+                    exit = expr.basic;
                 }
             }
         }
 
-        // If minRatio is still nil at this point, it means that the
-        // objective function is unbounded, i.e. it can become
-        // arbitrarily negative.  This should never happen in this
-        // application.
-        if (min_ratio == std::numeric_limits<double>::max())
-            throw internal_error("objective function is unbounded");
+        // If minRatio is still nil at this point, the objective function
+        // would be unbounded, i.e. it could become arbitrarily negative.
+        // Both objectives are positively weighted sums of restricted
+        // variables, so that can't really happen: the coefficient is what
+        // rounding error left of a cancellation between large weights.
+        // Drop it and carry on.
+        if (min_ratio == std::numeric_limits<double>::max()) {
+            add_to(row_of(z), entry, -entry_coeff, vars_[z].row);
+            continue;
+        }
 
         pivot(entry, exit);
     }
@@ -638,19 +675,24 @@ void simplex_solver::delta_edit_constant(double delta, const variable& plus,
                                          const variable& minus)
 {
     // Check if the variables are basic
-    if (is_basic_var(plus)) {
-        auto& expr = row_expression(plus);
-        expr.increment_constant(delta);
-        if (expr.constant() < 0)
-            infeasible_rows_.insert(plus);
+    index p = find(plus);
+    if (p != nil && is_basic(p)) {
+        auto& expr = row_of(p);
+        expr.constant += delta;
+        if (expr.constant < 0)
+            mark_infeasible(p);
 
         return;
     }
-    if (is_basic_var(minus)) {
-        auto& expr = row_expression(minus);
-        expr.increment_constant(-delta);
-        if (expr.constant() < 0)
-            infeasible_rows_.insert(minus);
+    index m = find(minus);
+    if (m == nil)
+        return;
+
+    if (is_basic(m)) {
+        auto& expr = row_of(m);
+        expr.constant -= delta;
+        if (expr.constant < 0)
+            mark_infeasible(m);
 
         return;
     }
@@ -661,43 +703,41 @@ void simplex_solver::delta_edit_constant(double delta, const variable& plus,
     // (it doesn't matter whether we look for that one or for
     // plusErrorVar).  Fix the constants in these expressions.
 
-    for (auto& v : columns_[minus]) {
-        auto& expr(row_expression(v));
-        expr.increment_constant(expr.coefficient(minus) * delta);
+    for (index slot : vars_[m].column) {
+        auto& expr = rows_[slot];
+        expr.constant += coefficient(expr, m) * delta;
 
-        if (v.is_restricted() && expr.constant() < 0)
-            infeasible_rows_.insert(v);
+        if (vars_[expr.basic].restricted && expr.constant < 0)
+            mark_infeasible(expr.basic);
     }
 }
 
 void simplex_solver::dual_optimize()
 {
-    auto& row = row_expression(objective_);
     while (!infeasible_rows_.empty()) {
-        auto ii = infeasible_rows_.begin();
-        variable exit_var{*ii};
-        infeasible_rows_.erase(ii);
+        index exit_var = infeasible_rows_.back();
+        infeasible_rows_.pop_back();
+        vars_[exit_var].infeasible = false;
 
         // exit_var might have become basic after some other pivoting
         // so allow for the case of its not being there any longer.
-        if (!is_basic_var(exit_var))
+        if (!vars_[exit_var].used || !is_basic(exit_var))
             continue;
 
-        auto& expr = row_expression(exit_var);
-        if (expr.constant() >= 0)
+        const row& expr = row_of(exit_var);
+        if (expr.constant >= 0)
             continue; // Skip this row if it's feasible.
 
+        const row& objective = row_of(objective_);
         double ratio = std::numeric_limits<double>::max();
         double r = 0.0;
-        variable entry_var{variable::nil_var()};
+        index entry_var = nil;
 
-        for (auto& p : expr.terms()) {
-            const variable& v = p.first;
-            double c = p.second;
-            if (c > 0 && v.is_pivotable()) {
-                r = row.coefficient(v) / c;
+        for (auto& p : expr.terms) {
+            if (p.coeff > 0 && vars_[p.var].pivotable) {
+                r = coefficient(objective, p.var) / p.coeff;
                 if (r < ratio) {
-                    entry_var = v;
+                    entry_var = p.var;
                     ratio = r;
                 }
             }
@@ -710,7 +750,7 @@ void simplex_solver::dual_optimize()
     }
 }
 
-void simplex_solver::pivot(const variable& entry, const variable& exit)
+void simplex_solver::pivot(index entry, index exit)
 {
     // The entryVar might be non-pivotable if we're doing a RemoveConstraint --
     // otherwise it should be a pivotable variable -- enforced at call sites,
@@ -720,17 +760,14 @@ void simplex_solver::pivot(const variable& entry, const variable& exit)
     // --
     // so that the old tableau includes the equation:
     //   exitVar = expr
-    auto expr = remove_row(exit);
+    row& expr = pivot_row_;
+    remove_row(exit, expr);
 
     // Compute an Expression for the entry variable.  Since expr has
     // been deleted from the tableau we can destructively modify it to
     // build this Expression.
-    expr.change_subject(exit, entry);
+    change_subject(expr, exit, entry);
     substitute_out(entry, expr);
-
-    if (entry.is_external())
-        external_parametric_vars_.erase(entry);
-
     add_row(entry, expr);
 }
 
@@ -741,29 +778,23 @@ void simplex_solver::reset_stay_constants()
 
     for (; ip != stay_plus_error_vars_.end(); ++ip, ++im) {
         assert(im != stay_minus_error_vars_.end());
-        if (is_basic_var(*ip))
-            row_expression(*ip).set_constant(0);
-        if (is_basic_var(*im))
-            row_expression(*im).set_constant(0);
+        if (is_basic(*ip))
+            row_of(*ip).constant = 0;
+        if (is_basic(*im))
+            row_of(*im).constant = 0;
     }
 }
 
 void simplex_solver::set_external_variables()
 {
-    // Set external parametric variables first
-    // in case I've screwed up
-    for (variable v : external_parametric_vars_) {
-        if (is_basic_var(v)) {
-            assert(false);
-        } else {
-            change(v, 0.0);
-        }
+    // Basic variables take the constant of their row, parametric
+    // variables are zero.  Indexed, in case a callback changes the
+    // tableau.
+    for (size_t n = 0; n < externals_.size(); ++n) {
+        var_info& info = vars_[externals_[n]];
+        change(info.var, info.row == nil ? 0.0 : rows_[info.row].constant);
     }
 
-    // Only iterate over the rows w/ external variables
-    for (variable v : external_rows_)
-        change(v, row_expression(v).constant());
-
     needs_solving_ = false;
 }
 
@@ -774,11 +805,12 @@ bool simplex_solver::is_constraint_satisfied(const constraint& c) const
 
     auto ie = error_vars_.find(c);
     if (ie != error_vars_.end()) {
-        for (variable v : ie->second) {
-            if (is_parametric_var(v))
+        for (const variable& var : ie->second) {
+            index v = find(var);
+            if (v == nil || !is_basic(v))
                 continue;
 
-            if (!near_zero(row_expression(v).constant()))
+            if (!near_zero(row_of(v).constant))
                 return false;
         }
     }
@@ -801,17 +833,18 @@ void simplex_solver::change_strength_and_weight(constraint c,
     if (new_coeff == old_coeff)
         return;
 
-    auto& row = row_expression(objective_);
-    for (const variable& v : ie->second) {
-        if (!is_basic_var(v)) {
-            row.add(v, -old_coeff, objective_, *this);
-            row.add(v, new_coeff, objective_, *this);
+    index objective_slot = vars_[objective_].row;
+    row& objective = rows_[objective_slot];
+    for (const variable& var : ie->second) {
+        index v = intern(var);
+        if (!is_basic(v)) {
+            add_to(objective, v, new_coeff - old_coeff, objective_slot);
         } else {
-            const linear_expression& expr(row_expression(v));
-            row.add(expr * -old_coeff, objective_, *this);
-            row.add(expr * new_coeff, objective_, *this);
+            add_to(objective, row_of(v), -old_coeff, objective_slot);
+            add_to(objective, row_of(v), new_coeff, objective_slot);
         }
     }
+    collect_unused();
     needs_solving_ = true;
 
     if (auto_solve_)
@@ -833,7 +866,7 @@ simplex_solver& simplex_solver::begin_edit()
     if (edit_info_list_.empty())
         throw edit_misuse();
 
-    infeasible_rows_.clear();
+    clear_infeasible();
     reset_stay_constants();
     cedcns_.push(edit_info_list_.size());
 
@@ -852,18 +885,17 @@ simplex_solver& simplex_solver::end_edit()
     return *this;
 }
 
-constraint_list
-simplex_solver::build_explanation(const variable& v,
-                                  const linear_expression& expr) const
+constraint_list simplex_solver::build_explanation(index v,
+                                                  const row& expr) const
 {
     constraint_list result;
 
-    auto found = constraints_marked_.find(v);
+    auto found = constraints_marked_.find(vars_[v].var);
     if (found != constraints_marked_.end())
         result.push_back(found->second);
 
-    for (auto& term : expr.terms()) {
-        auto found2 = constraints_marked_.find(term.first);
+    for (auto& term : expr.terms) {
+        auto found2 = constraints_marked_.find(vars_[term.var].var);
         if (found2 != constraints_marked_.end())
             result.push_back(found2->second);
     }
@@ -206,7 +206,7 @@ protected:
      *  This struct is only used as a return variable of make_epression().*/
     struct expression_result
     {
-        linear_expression expr;
+        row expr;
         variable minus;
         variable plus;
         double previous_constant;
@@ -234,12 +234,11 @@ protected:
      * whether this has succeeded or not.
      * @return True iff the expression could be added.
      *         False and a list of the constraints involved if not */
-    std::pair<bool, constraint_list>
-    add_with_artificial_variable(linear_expression& expr);
+    std::pair<bool, constraint_list> add_with_artificial_variable(row& expr);
 
     /** Add the constraint \f$expr = 0\f$ to the inequality tableau.
      * @return True iff the expression could be added */
-    bool try_adding_directly(linear_expression& expr);
+    bool try_adding_directly(row& expr);
 
     /** Try to choose a subject (that is, a variable to become basic) from
      ** among the current variables in \a expr.
@@ -261,7 +260,7 @@ protected:
      *
      * \param expr  The expression that is being added to the solver
      * \return An appropriate subject, or nil */
-    variable choose_subject(linear_expression& expr);
+    index choose_subject(row& expr);
 
     void delta_edit_constant(double delta, const variable& v1,
                              const variable& v2);
@@ -272,13 +271,13 @@ protected:
     /** Minimize the value of an objective.
      * \pre The tableau is feasible.
      * \param z The objective to optimize for */
-    void optimize(const variable& z);
+    void optimize(index z);
 
     /** Perform a pivot operation.
      *  Move entry into the basis (i.e. make it a basic variable), and move
      *  exit out of the basis (i.e., make it a parametric variable).
      */
-    void pivot(const variable& entry, const variable& exit);
+    void pivot(index entry, index exit);
 
     /** Set the external variables known to this solver to their appropriate
      ** values.
@@ -300,8 +299,7 @@ protected:
         }
     }
 
-    constraint_list build_explanation(const variable& v,
-                                      const linear_expression& expr) const;
+    constraint_list build_explanation(index v, const row& expr) const;
 
 private:
     typedef std::unordered_map<constraint, variable_set>
@@ -312,14 +310,16 @@ private:
     // The arrays of positive and negative error vars for the stay
     // constraints.  (We need to keep positive and negative separate,
     // since the error vars are always non-negative.)
-    std::vector<variable> stay_minus_error_vars_;
-    std::vector<variable> stay_plus_error_vars_;
+    // Both are pinned in the tableau, so their indices stay valid.
+    std::vector<index> stay_minus_error_vars_;
+    std::vector<index> stay_plus_error_vars_;
 
     constraint_to_varset_map error_vars_;
     constraint_to_var_map marker_vars_;
     var_to_constraint_map constraints_marked_;
 
-    variable objective_;
+    index objective_;
+    row pivot_row_;
 
     // Map edit variables to their constraints, errors, and prior value.
     std::list<edit_info> edit_info_list_;
@@ -0,0 +1,336 @@
+//---------------------------------------------------------------------------
+/// \file   small_vector.hpp
+/// \brief  A vector that keeps its first few elements inline
+//
+// Copyright 2012-2014, nocte@hippie.nu       Released under the MIT License.
+//---------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rhea
+{
+
+/** A sequence container like std::vector, with room for \a N elements
+ ** inside the object itself.
+ * The heap is only used once the vector grows past \a N elements.  Most
+ * expressions and rows in a tableau only have a handful of terms, so
+ * this saves an allocation for nearly every one of them.
+ *
+ * Unlike std::vector, moving a small_vector that fits inline moves its
+ * elements one by one, and invalidates iterators into it. */
+template <typename T, size_t N, typename A = std::allocator<T>>
+class small_vector : private A
+{
+    typedef std::allocator_traits<A> traits;
+
+public:
+    typedef T value_type;
+    typedef A allocator_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+public:
+    explicit small_vector(const A& alloc = A())
+        : A(alloc)
+        , begin_{inline_begin()}
+        , end_{begin_}
+        , capacity_end_{begin_ + N}
+    {
+    }
+
+    template <typename InputIterator>
+    small_vector(InputIterator first, InputIterator last,
+                 const A& alloc = A())
+        : small_vector(alloc)
+    {
+        for (; first != last; ++first)
+            push_back(*first);
+    }
+
+    small_vector(const small_vector& copy)
+        : small_vector(traits::select_on_container_copy_construction(
+              copy.allocator()))
+    {
+        reserve(copy.size());
+        end_ = std::uninitialized_copy(copy.begin(), copy.end(), begin_);
+    }
+
+    small_vector(small_vector&& move) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+        : small_vector(move.allocator())
+    {
+        steal(move);
+    }
+
+    ~small_vector()
+    {
+        clear();
+        release();
+    }
+
+    small_vector& operator=(const small_vector& copy)
+    {
+        if (this != &copy) {
+            clear();
+            reserve(copy.size());
+            end_ = std::uninitialized_copy(copy.begin(), copy.end(), begin_);
+        }
+        return *this;
+    }
+
+    small_vector& operator=(small_vector&& move)
+    {
+        if (this != &move) {
+            clear();
+            release();
+            steal(move);
+        }
+        return *this;
+    }
+
+    iterator begin() { return begin_; }
+    const_iterator begin() const { return begin_; }
+    iterator end() { return end_; }
+    const_iterator end() const { return end_; }
+    reverse_iterator rbegin() { return reverse_iterator(end_); }
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end_);
+    }
+    reverse_iterator rend() { return reverse_iterator(begin_); }
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin_);
+    }
+
+    bool empty() const { return begin_ == end_; }
+    size_type size() const { return size_type(end_ - begin_); }
+    size_type capacity() const { return size_type(capacity_end_ - begin_); }
+    size_type max_size() const { return traits::max_size(allocator()); }
+
+    T* data() { return begin_; }
+    const T* data() const { return begin_; }
+
+    T& operator[](size_type i) { return begin_[i]; }
+    const T& operator[](size_type i) const { return begin_[i]; }
+
+    T& front() { return *begin_; }
+    const T& front() const { return *begin_; }
+    T& back() { return end_[-1]; }
+    const T& back() const { return end_[-1]; }
+
+    void reserve(size_type n)
+    {
+        if (n > capacity())
+            reallocate(n);
+    }
+
+    void clear()
+    {
+        destroy(begin_, end_);
+        end_ = begin_;
+    }
+
+    void push_back(const T& x) { emplace_back(x); }
+
+    void push_back(T&& x) { emplace_back(std::move(x)); }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        if (end_ == capacity_end_) {
+            // Construct first, the arguments may refer to an element
+            T x(std::forward<Args>(args)...);
+            grow(size() + 1);
+            ::new (static_cast<void*>(end_)) T(std::move(x));
+        } else {
+            ::new (static_cast<void*>(end_)) T(std::forward<Args>(args)...);
+        }
+        ++end_;
+    }
+
+    void pop_back()
+    {
+        --end_;
+        end_->~T();
+    }
+
+    iterator insert(const_iterator pos, const T& x)
+    {
+        return insert(pos, T(x));
+    }
+
+    iterator insert(const_iterator pos, T&& x)
+    {
+        size_type n = size_type(pos - begin_);
+        if (end_ == capacity_end_) {
+            T moved(std::move(x));
+            grow(size() + 1);
+            return insert_at(begin_ + n, std::move(moved));
+        }
+        return insert_at(begin_ + n, std::move(x));
+    }
+
+    iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        iterator i = begin_ + (first - begin_);
+        if (first != last) {
+            iterator new_end = std::move(begin_ + (last - begin_), end_, i);
+            destroy(new_end, end_);
+            end_ = new_end;
+        }
+        return i;
+    }
+
+    void swap(small_vector& other)
+    {
+        if (!is_inline() && !other.is_inline()) {
+            std::swap(begin_, other.begin_);
+            std::swap(end_, other.end_);
+            std::swap(capacity_end_, other.capacity_end_);
+        } else {
+            small_vector tmp(std::move(other));
+            other = std::move(*this);
+            *this = std::move(tmp);
+        }
+    }
+
+    allocator_type get_allocator() const { return allocator(); }
+
+private:
+    A& allocator() { return *this; }
+    const A& allocator() const { return *this; }
+
+    iterator insert_at(iterator i, T&& x)
+    {
+        if (i == end_) {
+            ::new (static_cast<void*>(end_)) T(std::move(x));
+        } else {
+            ::new (static_cast<void*>(end_)) T(std::move(end_[-1]));
+            std::move_backward(i, end_ - 1, end_);
+            *i = std::move(x);
+        }
+        ++end_;
+        return i;
+    }
+
+    T* inline_begin() { return reinterpret_cast<T*>(&inline_); }
+
+    bool is_inline() const
+    {
+        return begin_ == reinterpret_cast<const T*>(&inline_);
+    }
+
+    static void destroy(T* first, T* last)
+    {
+        for (; first != last; ++first)
+            first->~T();
+    }
+
+    void grow(size_type min_size)
+    {
+        reallocate(std::max(min_size, capacity() * 2));
+    }
+
+    void reallocate(size_type n)
+    {
+        T* storage = traits::allocate(allocator(), n);
+        T* last = storage;
+        try {
+            for (T* i = begin_; i != end_; ++i, ++last)
+                ::new (static_cast<void*>(last)) T(std::move_if_noexcept(*i));
+        } catch (...) {
+            destroy(storage, last);
+            traits::deallocate(allocator(), storage, n);
+            throw;
+        }
+        clear();
+        release();
+        begin_ = storage;
+        end_ = last;
+        capacity_end_ = storage + n;
+    }
+
+    /** Give the heap storage back, if any.
+     * \pre The vector is empty */
+    void release()
+    {
+        if (!is_inline())
+            traits::deallocate(allocator(), begin_, capacity());
+
+        begin_ = end_ = inline_begin();
+        capacity_end_ = begin_ + N;
+    }
+
+    /** Take over the elements of \a from, leaving it empty.
+     * \pre This vector is empty and inline */
+    void steal(small_vector& from)
+    {
+        if (from.is_inline()) {
+            for (T* i = from.begin_; i != from.end_; ++i, ++end_)
+                ::new (static_cast<void*>(end_)) T(std::move(*i));
+
+            from.clear();
+        } else {
+            begin_ = from.begin_;
+            end_ = from.end_;
+            capacity_end_ = from.capacity_end_;
+            from.begin_ = from.end_ = from.inline_begin();
+            from.capacity_end_ = from.begin_ + N;
+        }
+    }
+
+private:
+    T* begin_;
+    T* end_;
+    T* capacity_end_;
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type inline_;
+};
+
+template <typename T, size_t N, typename A>
+inline bool operator==(const small_vector<T, N, A>& lhs,
+                       const small_vector<T, N, A>& rhs)
+{
+    return lhs.size() == rhs.size()
+           && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <typename T, size_t N, typename A>
+inline bool operator!=(const small_vector<T, N, A>& lhs,
+                       const small_vector<T, N, A>& rhs)
+{
+    return !(lhs == rhs);
+}
+
+template <typename T, size_t N, typename A>
+inline bool operator<(const small_vector<T, N, A>& lhs,
+                      const small_vector<T, N, A>& rhs)
+{
+    return std::lexicographical_compare(lhs.begin(), lhs.end(),
+                                        rhs.begin(), rhs.end());
+}
+
+template <typename T, size_t N, typename A>
+void swap(small_vector<T, N, A>& lhs, small_vector<T, N, A>& rhs)
+{
+    lhs.swap(rhs);
+}
+
+} // namespace rhea
@@ -5,135 +5,378 @@
 //---------------------------------------------------------------------------
 #include "tableau.hpp"
 
+#include <algorithm>
+
 namespace rhea
 {
 
-void tableau::add_row(const variable& var, const linear_expression& expr)
+tableau::index tableau::intern(const variable& v)
 {
-    assert(!var.is_nil());
-    rows_[var] = expr;
-    for (auto& p : expr.terms()) {
-        const variable& v = p.first;
-        columns_[v].insert(var);
-        if (v.is_external() && !is_basic_var(v))
-            external_parametric_vars_.insert(v);
+    assert(!v.is_nil());
+    auto found = indices_.find(v.id());
+    if (found != indices_.end())
+        return found->second;
+
+    index i;
+    if (free_vars_.empty()) {
+        i = index(vars_.size());
+        vars_.emplace_back();
+    } else {
+        i = free_vars_.back();
+        free_vars_.pop_back();
+    }
+
+    auto& info = vars_[i];
+    info.var = v;
+    info.key = v.id();
+    info.row = nil;
+    info.used = true;
+    info.restricted = v.is_restricted();
+    info.pivotable = v.is_pivotable();
+    info.dummy = v.is_dummy();
+    info.infeasible = false;
+    if (v.is_external()) {
+        info.external = index(externals_.size());
+        externals_.push_back(i);
     }
 
-    if (var.is_external())
-        external_rows_.insert(var);
+    indices_.emplace(info.key, i);
+    maybe_unused_.push_back(i);
+    return i;
 }
 
-bool tableau::remove_column(const variable& var)
+void tableau::collect_unused()
 {
-    assert(!var.is_nil());
-    auto ic = columns_.find(var);
-    if (ic == columns_.end())
-        return false;
-
-    for (const variable& v : ic->second)
-        rows_[v].erase(var);
+    for (index i : maybe_unused_) {
+        auto& info = vars_[i];
+        if (!info.used || info.pins || info.row != nil
+            || !info.column.empty())
+            continue;
 
-    if (var.is_external()) {
-        external_rows_.erase(var);
-        external_parametric_vars_.erase(var);
+        if (info.external != nil) {
+            index moved = externals_.back();
+            externals_[info.external] = moved;
+            vars_[moved].external = info.external;
+            externals_.pop_back();
+            info.external = nil;
+        }
+        indices_.erase(info.key);
+        info.var = variable::nil_var();
+        info.used = false;
+        free_vars_.push_back(i);
     }
-    columns_.erase(ic);
+    maybe_unused_.clear();
+}
 
-    return true;
+const tableau::term* tableau::find_term(const row& r, index v) const
+{
+    size_t key = vars_[v].key;
+    auto i = std::lower_bound(
+        r.terms.begin(), r.terms.end(), key,
+        [&](const term& t, size_t k) { return vars_[t.var].key < k; });
+
+    return i != r.terms.end() && i->var == v ? &*i : nullptr;
 }
 
-linear_expression tableau::remove_row(const variable& var)
+double tableau::coefficient(const row& r, index v) const
 {
-    assert(!var.is_nil());
-    auto ir = rows_.find(var);
-    assert(ir != rows_.end());
-    for (auto& p : ir->second.terms()) {
-        auto ic = columns_.find(p.first);
-        assert(ic != columns_.end());
-        ic->second.erase(var);
-        if (ic->second.empty()) {
-            columns_.erase(ic);
-            external_parametric_vars_.erase(p.first);
-        }
+    const term* t = find_term(r, v);
+    return t ? t->coeff : 0.0;
+}
+
+tableau::index tableau::add_row(index basic, row& expr)
+{
+    index slot;
+    if (free_rows_.empty()) {
+        slot = index(rows_.size());
+        rows_.emplace_back();
+    } else {
+        slot = free_rows_.back();
+        free_rows_.pop_back();
     }
 
-    infeasible_rows_.erase(var);
-    if (var.is_external()) {
-        external_rows_.erase(var);
-        external_parametric_vars_.erase(var);
+    auto& r = rows_[slot];
+    r.basic = basic;
+    r.constant = expr.constant;
+    r.terms.swap(expr.terms);
+    expr.terms.clear();
+    vars_[basic].row = slot;
+    for (auto& t : r.terms) {
+        auto& column = vars_[t.var].column;
+        t.pos = index(column.size());
+        column.push_back(slot);
     }
 
-    linear_expression result{std::move(ir->second)};
-    rows_.erase(ir);
+    return slot;
+}
+
+void tableau::remove_row(index basic, row& out)
+{
+    index slot = vars_[basic].row;
+    assert(slot != nil);
+    auto& r = rows_[slot];
+    for (auto& t : r.terms)
+        remove_from_column(t.var, slot, t.pos);
 
-    return result;
+    out.basic = nil;
+    out.constant = r.constant;
+    out.terms.swap(r.terms);
+    r.terms.clear();
+    r.basic = nil;
+    vars_[basic].row = nil;
+    free_rows_.push_back(slot);
+    maybe_unused_.push_back(basic);
 }
 
-void tableau::substitute_out(const variable& old,
-                             const linear_expression& expr)
+void tableau::remove_row(index basic)
 {
-    auto ic = columns_.find(old);
-    if (ic == columns_.end())
-        return;
+    row discarded;
+    remove_row(basic, discarded);
+}
 
-    for (auto& v : ic->second) {
-        auto& row = rows_[v];
-        row.substitute_out(old, expr, v, *this);
-        if (v.is_restricted() && row.constant() < 0)
-            infeasible_rows_.insert(v);
+void tableau::remove_column(index v)
+{
+    auto& column = vars_[v].column;
+    for (index slot : column) {
+        auto& terms = rows_[slot].terms;
+        const term* t = find_term(rows_[slot], v);
+        assert(t != nullptr);
+        terms.erase(terms.begin() + (t - terms.data()));
     }
+    column.clear();
+    maybe_unused_.push_back(v);
+}
+
+void tableau::remove_from_column(index v, index slot, index pos)
+{
+    auto& column = vars_[v].column;
+    if (pos >= column.size() || column[pos] != slot)
+        throw internal_error("remove_from_column: row not in column");
 
-    columns_.erase(old);
+    index moved = column.back();
+    column.pop_back();
+    if (pos < column.size()) {
+        column[pos] = moved;
+        term* t = find_term(rows_[moved], v);
+        assert(t != nullptr);
+        t->pos = pos;
+    } else if (column.empty()) {
+        maybe_unused_.push_back(v);
+    }
+}
 
-    if (old.is_external()) {
-        if (!columns_[old].empty())
-            external_rows_.insert(old);
+void tableau::substitute_out(index old, const row& expr)
+{
+    // Indexed, as substituting never adds to this column
+    for (size_t n = 0; n < vars_[old].column.size(); ++n) {
+        index slot = vars_[old].column[n];
+        auto& r = rows_[slot];
+        auto& terms = r.terms;
+        const term* t = find_term(r, old);
+        assert(t != nullptr);
+        double multiplier = t->coeff;
+        terms.erase(terms.begin() + (t - terms.data()));
+        if (near_zero(multiplier))
+            continue;
 
-        external_parametric_vars_.erase(old);
+        add_to(r, expr, multiplier, slot);
+        if (vars_[r.basic].restricted && r.constant < 0)
+            mark_infeasible(r.basic);
     }
+    vars_[old].column.clear();
+    maybe_unused_.push_back(old);
 }
 
-bool tableau::is_valid() const
+void tableau::add_to(row& into, const row& from, double multiplier,
+                     index slot)
 {
-    for (auto& r : rows_) {
-        const auto& clv = r.first;
-        if (clv.is_external()) {
-            if (external_rows_.count(clv) == 0)
-                return false;
-        }
+    into.constant += multiplier * from.constant;
+
+    // A handful of terms into a long row, such as the objective, is
+    // cheaper to insert one by one than to merge
+    if (from.terms.size() * 16 < into.terms.size()) {
+        for (auto& t : from.terms)
+            add_to(into, t.var, multiplier * t.coeff, slot);
+
+        return;
+    }
 
-        auto& expr = r.second;
-        for (auto& p : expr.terms()) {
-            const variable& v = p.first;
-            if (v.is_external()) {
-                if (external_parametric_vars_.count(v) == 0)
-                    return false;
+    // Both are ordered by key, so this is a merge
+    merged_.clear();
+    merged_.reserve(into.terms.size() + from.terms.size());
+    auto a = into.terms.begin(), a_end = into.terms.end();
+    auto b = from.terms.begin(), b_end = from.terms.end();
+    while (a != a_end || b != b_end) {
+        if (b == b_end
+            || (a != a_end && vars_[a->var].key < vars_[b->var].key)) {
+            merged_.push_back(*a++);
+        } else if (a == a_end || vars_[b->var].key < vars_[a->var].key) {
+            double c = multiplier * b->coeff;
+            if (!near_zero(c)) {
+                auto& column = vars_[b->var].column;
+                merged_.push_back({b->var, index(column.size()), c});
+                if (slot != nil)
+                    column.push_back(slot);
             }
+            ++b;
+        } else {
+            double c = a->coeff + multiplier * b->coeff;
+            if (!near_zero(c))
+                merged_.push_back({a->var, a->pos, c});
+            else if (slot != nil)
+                remove_from_column(a->var, slot, a->pos);
+            ++a;
+            ++b;
         }
     }
-    return true;
+    into.terms.swap(merged_);
+}
+
+void tableau::add_to(row& into, index v, double c, index slot)
+{
+    size_t key = vars_[v].key;
+    auto i = std::lower_bound(
+        into.terms.begin(), into.terms.end(), key,
+        [&](const term& t, size_t k) { return vars_[t.var].key < k; });
+
+    if (i == into.terms.end() || i->var != v) {
+        if (!near_zero(c)) {
+            auto& column = vars_[v].column;
+            into.terms.insert(i, {v, index(column.size()), c});
+            if (slot != nil)
+                column.push_back(slot);
+        }
+    } else if (near_zero(i->coeff += c)) {
+        index pos = i->pos;
+        into.terms.erase(i);
+        if (slot != nil)
+            remove_from_column(v, slot, pos);
+    }
+}
+
+double tableau::new_subject(row& expr, index subj)
+{
+    const term* t = find_term(expr, subj);
+    assert(t != nullptr);
+    double reciprocal = 1.0 / t->coeff;
+    expr.terms.erase(expr.terms.begin() + (t - expr.terms.data()));
+
+    expr.constant *= -reciprocal;
+    for (auto& p : expr.terms)
+        p.coeff *= -reciprocal;
+
+    return reciprocal;
+}
+
+void tableau::negate(row& expr)
+{
+    expr.constant = -expr.constant;
+    for (auto& t : expr.terms)
+        t.coeff = -t.coeff;
+}
+
+void tableau::change_subject(row& expr, index old_subj, index new_subj)
+{
+    if (old_subj == new_subj)
+        return;
+
+    double reciprocal = new_subject(expr, new_subj);
+    add_to(expr, old_subj, reciprocal);
+}
+
+void tableau::mark_infeasible(index basic)
+{
+    if (!vars_[basic].infeasible) {
+        vars_[basic].infeasible = true;
+        infeasible_rows_.push_back(basic);
+    }
+}
+
+void tableau::clear_infeasible()
+{
+    for (index i : infeasible_rows_)
+        vars_[i].infeasible = false;
+
+    infeasible_rows_.clear();
+}
+
+linear_expression tableau::to_expression(const row& r) const
+{
+    linear_expression result{r.constant};
+    for (auto& t : r.terms)
+        result.set(vars_[t.var].var, t.coeff);
+
+    return result;
+}
+
+linear_expression tableau::row_expression(const variable& v) const
+{
+    index i = find(v);
+    if (i == nil || vars_[i].row == nil)
+        throw row_not_found();
+
+    return to_expression(row_of(i));
 }
 
-void tableau::note_removed_variable(const variable& v, const variable& subj)
+tableau::columns_map tableau::columns() const
 {
-    auto& column = columns_[v];
-    auto i(column.find(subj));
-    if (i == column.end())
-        throw internal_error("note_removed_variable: subject not in column");
+    columns_map result;
+    for (auto& info : vars_) {
+        if (!info.used || info.column.empty())
+            continue;
 
-    column.erase(i);
-    if (column.empty()) {
-        columns_.erase(v);
-        external_rows_.erase(v);
-        external_parametric_vars_.erase(v);
+        auto& basics = result[info.var];
+        for (index slot : info.column)
+            basics.insert(vars_[rows_[slot].basic].var);
     }
+    return result;
+}
+
+tableau::rows_map tableau::rows() const
+{
+    rows_map result;
+    for (auto& r : rows_) {
+        if (r.basic != nil)
+            result.emplace(vars_[r.basic].var, to_expression(r));
+    }
+    return result;
 }
 
-void tableau::note_added_variable(const variable& v, const variable& subj)
+bool tableau::is_valid() const
 {
-    columns_[v].insert(subj);
-    if (v.is_external() && !is_basic_var(v))
-        external_parametric_vars_.insert(v);
+    for (index slot = 0; slot < rows_.size(); ++slot) {
+        auto& r = rows_[slot];
+        if (r.basic == nil)
+            continue;
+
+        if (!vars_[r.basic].used || vars_[r.basic].row != slot)
+            return false;
+
+        for (size_t n = 0; n < r.terms.size(); ++n) {
+            auto& info = vars_[r.terms[n].var];
+            if (!info.used || info.row != nil)
+                return false;
+
+            if (n > 0 && vars_[r.terms[n - 1].var].key >= info.key)
+                return false;
+
+            index pos = r.terms[n].pos;
+            if (pos >= info.column.size() || info.column[pos] != slot)
+                return false;
+
+            if (std::count(info.column.begin(), info.column.end(), slot)
+                != 1)
+                return false;
+        }
+    }
+
+    for (index i = 0; i < vars_.size(); ++i) {
+        for (index slot : vars_[i].column) {
+            if (rows_[slot].basic == nil || !find_term(rows_[slot], i))
+                return false;
+        }
+    }
+    return true;
 }
 
 } // namespace rhea
@@ -6,11 +6,13 @@
 //---------------------------------------------------------------------------
 #pragma once
 
+#include <cstdint>
 #include <unordered_map>
-#include <iostream>
+#include <vector>
 #include "errors.hpp"
 #include "variable.hpp"
 #include "linear_expression.hpp"
+#include "small_vector.hpp"
 
 namespace rhea
 {
@@ -43,6 +45,14 @@ namespace rhea
  * variable.)
  * If the free variables are assumed to be zero, the solution can be read
  * from the first row.
+ *
+ * Internally every variable in the tableau gets a dense integer index.
+ * Rows are sparse vectors of (index, coefficient) terms, kept in slots
+ * that are recycled along with their storage, and each column is a flat
+ * array of the row slots the variable occurs in.  Every term knows its
+ * position in that column, so dropping a term is constant time.
+ * Pivoting and substitution only touch these arrays; variable handles
+ * are looked up when a constraint is added or removed, never per term.
  */
 class tableau
 {
@@ -51,99 +61,192 @@ public:
     typedef std::unordered_map<variable, linear_expression> rows_map;
 
 public:
-    /** This function should be invoked when v has been removed from an
-     ** expression, so the column indices can be updated. */
-    void note_removed_variable(const variable& v, const variable& subj);
+    tableau() {}
 
-    /** This function should be invoked when v has been added to an
-     ** expression, so the column indices can be updated. */
-    void note_added_variable(const variable& v, const variable& subj);
+    virtual ~tableau() {}
 
     /** Check the internal consistency of this data structure. */
     bool is_valid() const;
 
-public:
-    tableau() {}
+    /** A copy of the columns: every variable that occurs in a row,
+     ** mapped to the basic variables of those rows.
+     * Meant for inspection and debugging, as the map is built on every
+     * call. */
+    columns_map columns() const;
 
-    virtual ~tableau() {}
+    /** A copy of the rows, by basic variable.
+     * Meant for inspection and debugging, as the map is built on every
+     * call. */
+    rows_map rows() const;
 
-    /** Add a new row to the tableau. */
-    void add_row(const variable& v, const linear_expression& e);
+    bool columns_has_key(const variable& v) const
+    {
+        index i = find(v);
+        return i != nil && !vars_[i].column.empty();
+    }
 
-    /** Remove a variable from the tableau.
-     * \return True iff the variable was known */
-    bool remove_column(const variable& v);
+    /** Get the linear expression that the given row represents. */
+    linear_expression row_expression(const variable& v) const;
 
-    /** Remove a row from the tableau.
-     * \param v  The basic variable that is used to index the row
-     * \return The expression represented by the removed row */
-    linear_expression remove_row(const variable& v);
+    /** Check if v is one of the basic variables. */
+    bool is_basic_var(const variable& v) const
+    {
+        index i = find(v);
+        return i != nil && vars_[i].row != nil;
+    }
 
-    /** Replace all occurrences of \a old_var with \a expr, and update
-     ** column cross indices.
-     *  \a old_var should now be a basic variable.
-     *  This function calls substitute_out on each row that has old_var
-     *  in it.
-     * @post old_var is no longer a basic variable */
-    void substitute_out(const variable& old_var,
-                        const linear_expression& expr);
+    /** Check if f is one of the parametric (aka. free) variables. */
+    bool is_parametric_var(const variable& v) const
+    {
+        return !is_basic_var(v);
+    }
 
-    const columns_map& columns() const { return columns_; }
+protected:
+    /** Dense index of a variable, or of a row slot. */
+    typedef std::uint32_t index;
 
-    const rows_map& rows() const { return rows_; }
+    static const index nil = ~index(0);
 
-    bool columns_has_key(const variable& subj) const
+    struct term
     {
-        return columns_.count(subj) > 0;
-    }
+        index var;
+        /** Where the row's slot is in the variable's column, for rows
+         ** that are in the tableau. */
+        index pos;
+        double coeff;
+    };
+
+    /** A row: basic = constant + sum of terms, with the terms in the
+     ** order of their variables' ids. */
+    struct row
+    {
+        index basic = nil;
+        double constant = 0.0;
+        std::vector<term> terms;
+    };
 
-    /** Get the linear expression that the given row represents. */
-    const linear_expression& row_expression(const variable& v) const
+    struct var_info
     {
-        auto i = rows_.find(v);
-        if (i == rows_.end())
-            throw row_not_found();
+        variable var{variable::nil_var()};
+        /** The variable's id, which orders the terms of every row. */
+        size_t key = 0;
+        /** The slot of the row this variable is basic in, or nil. */
+        index row = nil;
+        /** Row slots the variable occurs in, unordered. */
+        small_vector<index, 4> column;
+        /** Position in externals_, for external variables. */
+        index external = nil;
+        /** Held in the tableau even while it occurs in no row. */
+        unsigned pins = 0;
+        bool used = false;
+        bool restricted = false;
+        bool pivotable = false;
+        bool dummy = false;
+        bool infeasible = false;
+    };
 
-        return i->second;
-    }
+protected:
+    /** The index of a variable in the tableau, giving it one if needed.
+     * Indices that end up unused are reclaimed by collect_unused(). */
+    index intern(const variable& v);
 
-    /** Get the linear expression that the given row represents. */
-    linear_expression& row_expression(const variable& v)
+    /** The index of a variable, or nil if it is not in the tableau. */
+    index find(const variable& v) const
     {
-        auto i = rows_.find(v);
-        if (i == rows_.end())
-            throw row_not_found();
-
-        return i->second;
+        auto i = indices_.find(v.id());
+        return i == indices_.end() ? nil : i->second;
     }
 
-    /** Check if v is one of the basic variables. */
-    bool is_basic_var(const variable& v) const { return rows_.count(v) > 0; }
+    bool is_basic(index v) const { return vars_[v].row != nil; }
 
-    /** Check if f is one of the parametric (aka. free) variables. */
-    bool is_parametric_var(const variable& v) const
+    row& row_of(index basic) { return rows_[vars_[basic].row]; }
+
+    const row& row_of(index basic) const { return rows_[vars_[basic].row]; }
+
+    double coefficient(const row& r, index v) const;
+
+    /** Add a new row, taking over the terms of \a expr.
+     * \return The row's slot */
+    index add_row(index basic, row& expr);
+
+    /** Remove a row from the tableau, moving its expression to \a out. */
+    void remove_row(index basic, row& out);
+
+    /** Remove a row from the tableau and discard it. */
+    void remove_row(index basic);
+
+    /** Remove a variable from every row it occurs in. */
+    void remove_column(index v);
+
+    /** Replace all occurrences of \a old with \a expr in every row, and
+     ** update the columns.
+     * @post old occurs in no row */
+    void substitute_out(index old, const row& expr);
+
+    /** into += multiplier * from.  If \a slot is the slot of \a into in
+     ** the tableau, the columns are updated as terms come and go. */
+    void add_to(row& into, const row& from, double multiplier,
+                index slot = nil);
+
+    /** into += c * v, dropping the term if it cancels out. */
+    void add_to(row& into, index v, double c, index slot = nil);
+
+    /** Replace \a subj = expr with an expression for \a new_subj.
+     * \sa linear_expression::change_subject() */
+    void change_subject(row& expr, index old_subj, index new_subj);
+
+    /** Turn expr = 0 into an expression for \a subj.
+     * \sa linear_expression::new_subject() */
+    double new_subject(row& expr, index subj);
+
+    static void negate(row& expr);
+
+    void mark_infeasible(index basic);
+
+    void clear_infeasible();
+
+    linear_expression to_expression(const row& r) const;
+
+    void pin(index v) { ++vars_[v].pins; }
+
+    void unpin(index v)
     {
-        return rows_.count(v) == 0;
+        if (--vars_[v].pins == 0)
+            maybe_unused_.push_back(v);
     }
 
-protected:
-    /** A mapping from variables which occur in expressions to the
-     ** rows whose expressions contain them. */
-    columns_map columns_;
+    /** Forget unpinned variables that are no longer in any row. */
+    void collect_unused();
 
-    /** A mapping from the basic variables to the expressions for that
-     ** row in the tableau. */
-    rows_map rows_;
+private:
+    void remove_from_column(index v, index slot, index pos);
 
-    /** The collection of basic variables that have infeasible rows.
-     *  This is used internally when optimizing. */
-    variable_set infeasible_rows_;
+    const term* find_term(const row& r, index v) const;
 
-    /** A map to quickly find rows with external basic variables. */
-    variable_set external_rows_;
+    term* find_term(row& r, index v)
+    {
+        return const_cast<term*>(
+            static_cast<const tableau*>(this)->find_term(r, v));
+    }
 
-    /** A map to quickly find rows with external parametric variables. */
-    variable_set external_parametric_vars_;
+protected:
+    std::vector<var_info> vars_;
+    std::vector<row> rows_;
+
+    /** The basic variables that have infeasible rows.
+     *  This is used internally when optimizing.  Entries may be stale. */
+    std::vector<index> infeasible_rows_;
+
+    /** The external variables in the tableau, whose values are set from
+     ** the solution. */
+    std::vector<index> externals_;
+
+private:
+    std::unordered_map<size_t, index> indices_;
+    std::vector<index> free_vars_;
+    std::vector<index> free_rows_;
+    std::vector<index> maybe_unused_;
+    std::vector<term> merged_;
 };
 
 } // namespace rhea
@@ -11,6 +11,7 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <unordered_set>
 
 #include "approx.hpp"
@@ -69,7 +70,7 @@ class variable
 {
 public:
     variable()
-        : p_{std::make_shared<float_variable>(0.0)}
+        : p_{acquire(new float_variable(0.0))}
     {
     }
 
@@ -77,34 +78,37 @@ public:
      *  This function only serves to make code more readable. */
     static variable nil_var() { return {nil_()}; }
 
-    /** Wrap an abstract variable on the heap.
-     * \param p  Shared pointer to a variable.
+    /** Make a new variable of a given type.
+     * \param args  The arguments for T's constructor
      */
-    template <typename T>
-    variable(std::shared_ptr<T>&& p)
-        : p_{std::move(p)}
+    template <typename T, typename... Args>
+    static variable make(Args&&... args)
     {
+        return variable{acquire(new T(std::forward<Args>(args)...))};
     }
 
     /** "Copy" a variable.
      *  The resulting variable won't be a true copy, but rather another
      *  counted reference to the same variable. */
     variable(const variable& copy)
-        : p_{copy.p_}
+        : p_{acquire(copy.p_)}
     {
     }
 
     /** Move constructor. */
-    variable(variable&& copy)
-        : p_{std::move(copy.p_)}
+    variable(variable&& copy) noexcept
+        : p_{copy.p_}
     {
+        copy.p_ = nullptr;
     }
 
+    ~variable() { release(p_); }
+
     /** Create a new floating pointe variable.
      * \param value  The variable's initial value
      */
     variable(int value)
-        : p_{std::make_shared<float_variable>(value)}
+        : p_{acquire(new float_variable(value))}
     {
     }
 
@@ -112,7 +116,7 @@ public:
      * \param value  The variable's initial value
      */
     variable(unsigned int value)
-        : p_{std::make_shared<float_variable>(value)}
+        : p_{acquire(new float_variable(value))}
     {
     }
 
@@ -120,7 +124,7 @@ public:
      * \param value  The variable's initial value
      */
     variable(float value)
-        : p_{std::make_shared<float_variable>(value)}
+        : p_{acquire(new float_variable(value))}
     {
     }
 
@@ -128,7 +132,7 @@ public:
      * \param value  The variable's initial value
      */
     variable(double value)
-        : p_{std::make_shared<float_variable>(value)}
+        : p_{acquire(new float_variable(value))}
     {
     }
 
@@ -138,7 +142,7 @@ public:
      * \param value  This variable will be automatically updated
      */
     variable(int& value, const linked&)
-        : p_{std::make_shared<link_int>(value)}
+        : p_{acquire(new link_int(value))}
     {
     }
 
@@ -148,7 +152,7 @@ public:
      * \param value  This variable will be automatically updated
      */
     variable(float& value, const linked&)
-        : p_{std::make_shared<link_variable<float>>(value)}
+        : p_{acquire(new link_variable<float>(value))}
     {
     }
 
@@ -158,25 +162,27 @@ public:
      * \param value  This variable will be automatically updated
      */
     variable(double& value, const linked&)
-        : p_{std::make_shared<link_variable<double>>(value)}
+        : p_{acquire(new link_variable<double>(value))}
     {
     }
 
     /** Create a variable that calls a function whenever it is updated. */
     variable(std::function<void(double)> callback, double init_val = 0.0)
-        : p_{std::make_shared<action_variable>(callback, init_val)}
+        : p_{acquire(new action_variable(callback, init_val))}
     {
     }
 
     variable& operator=(const variable& assign)
     {
-        p_ = assign.p_;
+        abstract_variable* old = p_;
+        p_ = acquire(assign.p_);
+        release(old);
         return *this;
     }
 
-    variable& operator=(variable&& move)
+    variable& operator=(variable&& move) noexcept
     {
-        p_ = std::move(move.p_);
+        std::swap(p_, move.p_);
         return *this;
     }
 
@@ -255,11 +261,34 @@ private:
     {
     };
 
-    variable(const nil_&) {}
+    variable(const nil_&)
+        : p_{nullptr}
+    {
+    }
+
+    /** Adopt a pointer that has already been counted. */
+    explicit variable(abstract_variable* p)
+        : p_{p}
+    {
+    }
+
+    static abstract_variable* acquire(abstract_variable* p)
+    {
+        if (p)
+            p->retain();
+
+        return p;
+    }
+
+    static void release(abstract_variable* p)
+    {
+        if (p && p->release())
+            delete p;
+    }
 
 private:
     /** Reference counted pointer to the actual variable. */
-    std::shared_ptr<abstract_variable> p_;
+    abstract_variable* p_;
 };
 
 /** Convenience typedef for sets of variables. */
@@ -7,12 +7,36 @@
 
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <new>
 #include <vector>
 
 #include "../rhea/simplex_solver.hpp"
 #include "../rhea/linear_equation.hpp"
 
+// Count heap allocations, to see what adding a constraint costs besides time
+static size_t allocations(0);
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
 inline double uniform_rand()
 {
     return double(rand()) / RAND_MAX;
@@ -71,6 +95,7 @@ int main(int argc, char** argv)
     }
 
     auto timer(clock.now());
+    size_t allocations_before(allocations), total_added(0);
     for (auto& s : slv) {
         size_t added(0), exceptions(0);
         for (size_t j(0); added < cns && j < cns_made; ++j) {
@@ -81,9 +106,12 @@ int main(int argc, char** argv)
                 ++exceptions;
             }
         }
+        total_added += added;
     }
     auto end(clock.now());
     auto time_add(end - timer);
+    double allocs_per_add(double(allocations - allocations_before)
+                          / total_added);
 
     // ------
 
@@ -121,7 +149,8 @@ int main(int argc, char** argv)
 
     std::cout << "add: " << msec(time_add) << "  edit: " << msec(time_edit)
               << "  resolve: " << msec(time_resolve)
-              << "  endedit: " << msec(time_endedit) << std::endl;
+              << "  endedit: " << msec(time_endedit)
+              << "  allocs/add: " << allocs_per_add << std::endl;
 
     return 0;
 }
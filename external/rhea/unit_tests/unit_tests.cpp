@@ -4,6 +4,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <random>
+#include <string>
 #include <boost/range/algorithm.hpp>
 
 #include "../rhea/simplex_solver.hpp"
@@ -11,6 +12,7 @@
 #include "../rhea/iostream.hpp"
 #include "../rhea/errors_expl.hpp"
 #include "../rhea/link_variable.hpp"
+#include "../rhea/small_vector.hpp"
 
 using namespace rhea;
 
@@ -1027,3 +1029,258 @@ BOOST_AUTO_TEST_CASE(independent_values_can_be_suggested_for_concurrent_edits)
     s.change_strength(e1, strength::weak());
     BOOST_CHECK_EQUAL(v.value(), 21);
 }
+
+BOOST_AUTO_TEST_CASE(add_remove_cycles)
+{
+    std::mt19937 rng(1);
+    auto pick = [&](int n) { return int(rng() % n); };
+    const strength strengths[]
+        = {strength::strong(), strength::medium(), strength::weak()};
+
+    variable v[4];
+    simplex_solver solver;
+    for (int round = 0; round < 200; ++round) {
+        std::vector<constraint> cs;
+        for (int i = 0; i < 10; ++i) {
+            linear_expression e(pick(21) - 10);
+            for (int n = pick(3) + 1; n > 0; --n)
+                e += linear_expression(v[pick(4)], pick(9) - 4);
+
+            strength s = strengths[pick(3)];
+            if (pick(4) == 0)
+                cs.emplace_back(
+                    std::make_shared<stay_constraint>(v[pick(4)], s));
+            else if (pick(3) == 0)
+                cs.emplace_back(linear_inequality(e, s));
+            else
+                cs.emplace_back(linear_equation(e, s));
+
+            solver.add_constraint(cs.back());
+            BOOST_CHECK(solver.is_valid());
+        }
+
+        std::shuffle(cs.begin(), cs.end(), rng);
+        for (auto& c : cs) {
+            solver.remove_constraint(c);
+            BOOST_CHECK(solver.is_valid());
+        }
+
+        // Nothing but the empty objective is left
+        BOOST_CHECK_EQUAL(solver.rows().size(), 1);
+        BOOST_CHECK_EQUAL(solver.columns().size(), 0);
+    }
+}
+
+static constraint eq(linear_expression x, strength s = strength::required())
+{
+    return linear_equation(x, s);
+}
+
+static constraint geq(linear_expression x, strength s = strength::required())
+{
+    return linear_inequality(x, s);
+}
+
+BOOST_AUTO_TEST_CASE(remove_after_rounding_error)
+{
+    // Removing the last constraint used to leave a tiny negative
+    // coefficient in the objective, and throw "objective function is
+    // unbounded".
+    variable a, b, c, d, e;
+    simplex_solver solver;
+
+    auto strong = strength::strong(), medium = strength::medium();
+
+    constraint c2{geq(-4 * b - 3)}, c5{eq(-5 * d + 3 * e + 8, strong)},
+        c6{eq(a - 2 * d + 2, strong)}, c13{eq(-4 * e - 2, strong)};
+
+    solver.add_constraints({eq(b + 8, medium), geq(-2 * a - 8), c2,
+                            geq(-2 * b - 4 * c - 4 * e + 6, medium),
+                            eq(-2 * d - 6, medium), c5, c6});
+    solver.remove_constraint(c5);
+    solver.add_constraint(eq(4 * c + 2 * d - 6, medium));
+    solver.remove_constraint(c2);
+    solver.add_constraints({eq(-5 * b - 7, strong),
+                            geq(3 * c - 2 * e - 3, strong),
+                            eq(3 * c + 9, strong), c13});
+    solver.remove_constraint(c6);
+    solver.add_constraint(
+        geq(2 * b - 2 * c - 3 * e - 10, strength::weak()));
+    solver.add_stay(c).add_stay(d);
+
+    BOOST_CHECK_NO_THROW(solver.remove_constraint(c13));
+    BOOST_CHECK(solver.is_valid());
+    BOOST_CHECK(approx(b.value(), -1.4));
+    BOOST_CHECK(approx(c.value(), -3));
+    BOOST_CHECK(approx(d.value(), -3));
+
+    // The same, with a bounded error variable in the objective
+    variable x, y, z, u, w;
+    simplex_solver solver2;
+
+    constraint d2{eq(3 * y + u + 1, strength::weak())},
+        d5{eq(3 * y - 4 * w - 1)}, d6{eq(-2 * x + 3 * z - 10)},
+        d7{geq(z - 10, medium)}, d13{eq(-2 * x + 4 * z, medium)};
+
+    solver2.add_constraints({eq(3 * x - y - z + 4, strong),
+                             geq(-2 * x + 3 * y - z + 6, medium), d2,
+                             geq(-4 * x + u + w + 4, medium)});
+    solver2.remove_constraint(d2);
+    solver2.add_constraints({d5, d6, d7});
+    solver2.remove_constraint(d6);
+    solver2.add_constraints({geq(-2 * y + 2 * w - 3, strong),
+                             geq(3 * y - 3 * z + 2, strong)});
+    solver2.remove_constraint(d5);
+    solver2.add_constraints({geq(-4 * z + 2 * u - w + 4), d13});
+    solver2.remove_constraint(d13);
+    solver2.add_constraints(
+        {geq(-3 * u - 2, medium), eq(2 * z - u - 2, strength::weak())});
+
+    BOOST_CHECK_NO_THROW(solver2.remove_constraint(d7));
+    BOOST_CHECK(solver2.is_valid());
+    BOOST_CHECK(approx(u.value(), -49));
+}
+
+typedef small_vector<std::string, 4> strings;
+
+static strings make_strings(int n)
+{
+    strings result;
+    for (int i = 0; i < n; ++i)
+        result.push_back(std::to_string(i));
+
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(small_vector_grow_and_shrink)
+{
+    strings v;
+    BOOST_CHECK(v.empty());
+    BOOST_CHECK_EQUAL(v.capacity(), 4);
+
+    for (int i = 0; i < 4; ++i)
+        v.push_back(std::to_string(i));
+    BOOST_CHECK_EQUAL(v.capacity(), 4);
+
+    // Past the inline capacity, onto the heap
+    v.push_back("4");
+    v.emplace_back(3, 'x');
+    BOOST_CHECK_EQUAL(v.size(), 6);
+    BOOST_CHECK(v.capacity() >= 6);
+    BOOST_CHECK_EQUAL(v[3], "3");
+    BOOST_CHECK_EQUAL(v[4], "4");
+    BOOST_CHECK_EQUAL(v.back(), "xxx");
+
+    // Pushing an element of the vector itself while it reallocates
+    v.push_back(v.front());
+    BOOST_CHECK_EQUAL(v.back(), "0");
+
+    while (v.size() > 2)
+        v.pop_back();
+    BOOST_CHECK_EQUAL(v.size(), 2);
+    BOOST_CHECK_EQUAL(v.front(), "0");
+    BOOST_CHECK_EQUAL(v.back(), "1");
+
+    v.clear();
+    BOOST_CHECK(v.empty());
+    v.push_back("again");
+    BOOST_CHECK_EQUAL(v.front(), "again");
+
+    // Inserting into a full vector
+    strings w = make_strings(4);
+    w.insert(w.begin() + 1, "a");
+    std::vector<std::string> expected{"0", "a", "1", "2", "3"};
+    BOOST_CHECK_EQUAL_COLLECTIONS(w.begin(), w.end(), expected.begin(),
+                                  expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(small_vector_copy_and_move)
+{
+    for (int n : {3, 9}) {
+        const strings original = make_strings(n);
+
+        strings copy(original);
+        BOOST_CHECK(copy == original);
+        BOOST_CHECK(copy.data() != original.data());
+
+        strings assigned = make_strings(6 - n);
+        assigned = original;
+        BOOST_CHECK(assigned == original);
+
+        strings source(original);
+        const std::string* storage = source.data();
+        strings moved(std::move(source));
+        BOOST_CHECK(moved == original);
+        BOOST_CHECK(source.empty());
+        // Heap storage is handed over, inline elements are moved
+        BOOST_CHECK_EQUAL(moved.data() == storage, n > 4);
+
+        strings move_assigned = make_strings(12 - n);
+        move_assigned = std::move(moved);
+        BOOST_CHECK(move_assigned == original);
+        BOOST_CHECK(moved.empty());
+
+        // Both are still usable afterwards
+        moved.push_back("x");
+        source = moved;
+        BOOST_CHECK_EQUAL(source.size(), 1);
+        BOOST_CHECK_EQUAL(source.front(), "x");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(small_vector_self_assignment)
+{
+    for (int n : {3, 9}) {
+        const strings original = make_strings(n);
+        strings v(original);
+        strings& alias = v;
+
+        v = alias;
+        BOOST_CHECK(v == original);
+
+        v = std::move(alias);
+        BOOST_CHECK(v == original);
+
+        swap(v, alias);
+        BOOST_CHECK(v == original);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(small_vector_swap)
+{
+    for (int m : {2, 7}) {
+        for (int n : {3, 9}) {
+            strings a = make_strings(m), b = make_strings(n);
+            swap(a, b);
+            BOOST_CHECK(a == make_strings(n));
+            BOOST_CHECK(b == make_strings(m));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(small_vector_erase)
+{
+    for (int n : {4, 9}) {
+        strings v = make_strings(n);
+
+        auto i = v.erase(v.begin());
+        BOOST_CHECK(i == v.begin());
+        BOOST_CHECK_EQUAL(v.front(), "1");
+
+        i = v.erase(v.begin() + 1);
+        BOOST_CHECK_EQUAL(*i, "3");
+
+        i = v.erase(v.end() - 1);
+        BOOST_CHECK(i == v.end());
+
+        strings expected;
+        for (int k = 1; k < n - 1; ++k) {
+            if (k != 2)
+                expected.push_back(std::to_string(k));
+        }
+        BOOST_CHECK(v == expected);
+
+        v.erase(v.begin(), v.end());
+        BOOST_CHECK(v.empty());
+    }
+}
@@ -0,0 +1,188 @@
+#define BOOST_TEST_MODULE command_buffer
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "entityx/entityx.h"
+#include "vibrant/body.hpp"
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/fixed_timestep.hpp"
+#include "vibrant/layer.hpp"
+#include "vibrant/renderable.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+struct Scene
+{
+  Scene() : entities(events) {}
+
+  // Several chunks' worth, of every primitive, some in layers and out of z order
+  void populate(int count)
+  {
+    Gradient gradient(GradientType::Linear, Vector2d(0, 0), Vector2d(1, 1),
+                      {{0, Rgb(1, 0, 0)}, {1, Rgb(0, 0, 1, 0.5)}});
+    for (int i = 0; i < count; ++i)
+    {
+      entityx::Entity entity = entities.create();
+      entity.assign<Body>(Vector2d(i % 100, i / 100), Vector2d(10, 10), i * 0.01);
+      double z = (i * 7919) % 100;
+      switch (i % 4)
+      {
+        case 0:
+          entity.assign<Renderable>(Rectangle({1, Rgb()}, {Rgb(0, 0.5, 1)}), z);
+          break;
+        case 1:
+          entity.assign<Renderable>(Rectangle({0, Rgb()}, {Rgb(), gradient}), z);
+          break;
+        case 2:
+          entity.assign<Renderable>(Text("label " + std::to_string(i), Font("Sans", 12), {Rgb()}),
+                                    z);
+          break;
+        case 3:
+          entity.assign<Renderable>(Line({2, Rgb(1, 0, 0)}), z);
+          break;
+      }
+      if (i % 10 == 0) entity.assign<Layer>(i % 3);
+      created.push_back(entity);
+    }
+  }
+
+  entityx::EventManager events;
+  entityx::EntityManager entities;
+  std::vector<entityx::Entity> created;
+};
+
+struct Collect
+{
+  void operator()(const RenderCommand& command) { commands.push_back(command); }
+
+  std::vector<RenderCommand> commands;
+};
+}
+
+BOOST_AUTO_TEST_CASE(threads_record_what_one_thread_does)
+{
+  Scene scene;
+  scene.populate(20000);
+
+  RenderCommandBuffer serial;
+  serial.record(scene.entities);
+  BOOST_REQUIRE_EQUAL(serial.size(), 20000u);
+  BOOST_CHECK(std::is_sorted(serial.begin(), serial.end(),
+                             [](const RenderCommand& a, const RenderCommand& b)
+                             { return a.z < b.z; }));
+
+  for (unsigned int threads : {2u, 3u, 8u})
+  {
+    RenderCommandBuffer parallel;
+    parallel.record(scene.entities, threads);
+    BOOST_CHECK_MESSAGE(parallel == serial, threads << " threads");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(rerecording_on_threads_follows_changes)
+{
+  Scene scene;
+  scene.populate(20000);
+
+  RenderCommandBuffer parallel, serial;
+  parallel.record(scene.entities, 4);
+
+  // Primitives change kind, bodies move, entities come and go between frames of the same buffer
+  for (int frame = 0; frame < 3; ++frame)
+  {
+    for (size_t i = frame; i < scene.created.size(); i += 97)
+    {
+      entityx::Entity entity = scene.created[i];
+      if (!entity.valid()) continue;
+
+      entity.component<Body>()->position.x += 1;
+      entity.component<Renderable>()->primitive = Text("changed", Font("Serif", 10), {Rgb()});
+    }
+    scene.created[frame * 1000].destroy();
+    scene.populate(10);
+
+    parallel.record(scene.entities, 4);
+    serial.record(scene.entities);
+    BOOST_CHECK_MESSAGE(parallel == serial, "frame " << frame);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(interpolates_on_threads)
+{
+  Scene scene;
+  scene.populate(10000);
+  store_previous_bodies(scene.entities);
+  for (entityx::Entity entity : scene.created) entity.component<Body>()->position.x += 10;
+
+  RenderCommandBuffer parallel, serial;
+  parallel.record(scene.entities, 4, 0.25);
+  serial.record(scene.entities, 1, 0.25);
+  BOOST_CHECK(parallel == serial);
+
+  RenderCommandBuffer latest;
+  latest.record(scene.entities);
+  BOOST_CHECK(parallel != latest);
+}
+
+BOOST_AUTO_TEST_CASE(diff_finds_changed_added_and_removed)
+{
+  Scene scene;
+  scene.populate(100);
+  RenderCommandBuffer before;
+  before.record(scene.entities);
+
+  scene.created[3].component<Body>()->position.y += 1;
+  scene.created[5].component<Renderable>()->z = 1000;
+  entityx::Entity::Id removed = scene.created[7].id();
+  scene.created[7].destroy();
+  scene.populate(1);
+
+  RenderCommandBuffer after;
+  after.record(scene.entities);
+  std::vector<entityx::Entity::Id> changed;
+  after.diff(before, changed);
+
+  std::vector<entityx::Entity::Id> expected = {scene.created[3].id(), scene.created[5].id(),
+                                               removed, scene.created[100].id()};
+  std::sort(changed.begin(), changed.end());
+  std::sort(expected.begin(), expected.end());
+  BOOST_CHECK(changed == expected);
+
+  changed.clear();
+  after.diff(after, changed);
+  BOOST_CHECK(changed.empty());
+}
+
+BOOST_AUTO_TEST_CASE(replay_and_copies_keep_the_commands)
+{
+  Scene scene;
+  scene.populate(50);
+  RenderCommandBuffer buffer;
+  buffer.record(scene.entities);
+
+  Collect collect;
+  buffer.replay(collect);
+  BOOST_REQUIRE_EQUAL(collect.commands.size(), buffer.size());
+  BOOST_CHECK(std::equal(collect.commands.begin(), collect.commands.end(), buffer.begin()));
+
+  RenderCommandBuffer copy(buffer);
+  BOOST_CHECK(copy == buffer);
+  copy.clear();
+  BOOST_CHECK(copy != buffer);
+  copy = buffer;
+  BOOST_CHECK(copy == buffer);
+
+  // Buffers recorded separately merge into one z order
+  RenderCommandBuffer merged;
+  merged.append(buffer);
+  merged.append(buffer);
+  merged.sort();
+  BOOST_CHECK_EQUAL(merged.size(), 100u);
+  BOOST_CHECK(std::is_sorted(merged.begin(), merged.end(),
+                             [](const RenderCommand& a, const RenderCommand& b)
+                             { return a.z < b.z; }));
+}
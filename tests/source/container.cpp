@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE container
+#include <boost/test/included/unit_test.hpp>
+
+#include <memory>
+
+#include "entityx/entityx.h"
+#include "vibrant/body.hpp"
+#include "vibrant/container.hpp"
+#include "vibrant/layout.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+struct Scene
+{
+  Scene() : entities(events), systems(entities, events), layout(std::make_shared<LayoutSystem>())
+  {
+    systems.add(layout);
+    systems.configure();
+  }
+
+  entityx::Entity container(Vector2d position)
+  {
+    entityx::Entity entity = entities.create();
+    entity.assign<Body>(position, Vector2d(200, 200));
+    entity.assign<Container>(Arrangement::Stack, Axis::Vertical, 0, 10);
+    return entity;
+  }
+
+  entityx::Entity item()
+  {
+    entityx::Entity entity = entities.create();
+    entity.assign<Sizing>(Vector2d(50, 20));
+    return entity;
+  }
+
+  void update() { systems.update<LayoutSystem>(1); }
+
+  entityx::EventManager events;
+  entityx::EntityManager entities;
+  entityx::SystemManager systems;
+  std::shared_ptr<LayoutSystem> layout;
+};
+}
+
+BOOST_AUTO_TEST_CASE(tree_is_arranged_without_the_solver)
+{
+  Scene scene;
+  entityx::Entity outer = scene.container(Vector2d(100, 100));
+  entityx::Entity inner = scene.entities.create();
+  inner.assign<Container>(Arrangement::Stack, Axis::Horizontal);
+  inner.component<Container>()->add(scene.item());
+  outer.component<Container>()->add(scene.item());
+  outer.component<Container>()->add(inner);
+  scene.update();
+
+  BOOST_CHECK_EQUAL(scene.layout->containerStats().direct, 2u);
+  BOOST_CHECK_EQUAL(scene.layout->containerStats().constrained, 0u);
+  BOOST_CHECK(!inner.has_component<Layout>());
+}
+
+BOOST_AUTO_TEST_CASE(edits_are_arranged)
+{
+  Scene scene;
+  entityx::Entity list = scene.container(Vector2d(100, 100));
+  list.component<Container>()->add(scene.item());
+  scene.update();
+  scene.update();
+  BOOST_CHECK_EQUAL(scene.layout->containerStats().placed, 0u);
+
+  entityx::Entity added = scene.item();
+  list.component<Container>()->add(added);
+  scene.update();
+  BOOST_REQUIRE(added.has_component<Body>());
+  BOOST_CHECK_CLOSE(added.component<Body>()->position.y, 40, 1e-6);
+
+  list.component<Container>()->spacing = 5;
+  list.component<Container>()->invalidate();
+  scene.update();
+  BOOST_CHECK_CLOSE(added.component<Body>()->position.y, 45, 1e-6);
+}
+
+// Each container sees the child shared, whichever walks it first
+BOOST_AUTO_TEST_CASE(shared_child_leaves_both_containers_to_the_solver)
+{
+  Scene scene;
+  entityx::Entity first = scene.container(Vector2d(100, 100));
+  entityx::Entity second = scene.container(Vector2d(400, 300));
+  entityx::Entity shared = scene.item();
+  first.component<Container>()->add(scene.item());
+  first.component<Container>()->add(shared);
+  second.component<Container>()->add(shared);
+  scene.update();
+
+  BOOST_CHECK_EQUAL(scene.layout->containerStats().direct, 0u);
+  BOOST_CHECK_EQUAL(scene.layout->containerStats().constrained, 2u);
+
+  // Only the solver places it, so the linear pass can't have moved it since
+  BOOST_REQUIRE(shared.has_component<Layout>());
+  Layout::Handle layout = shared.component<Layout>();
+  Body::Handle body = shared.component<Body>();
+  BOOST_CHECK_CLOSE(body->position.x, layout->x.value(), 1e-6);
+  BOOST_CHECK_CLOSE(body->position.y, layout->y.value(), 1e-6);
+
+  scene.update();
+  BOOST_CHECK_EQUAL(scene.layout->containerStats().placed, 0u);
+}
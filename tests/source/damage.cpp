@@ -0,0 +1,264 @@
+#define BOOST_TEST_MODULE damage
+#include <boost/test/included/unit_test.hpp>
+
+#include <vector>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/cairo/damage.hpp"
+#include "vibrant/cairo/render.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+const Vector2u frame_size(320, 240);
+
+RenderCommand box(uint32_t entity, Vector2d position, Rgb colour = Rgb(0.2, 0.4, 0.8))
+{
+  return RenderCommand(entityx::Entity::Id(entity), Body(position, Vector2d(20, 20)),
+                       Renderable(Rectangle({1, Rgb()}, {colour}), entity), NoLayer);
+}
+
+RenderCommandBuffer buffer(const std::vector<RenderCommand>& commands)
+{
+  RenderCommandBuffer buffer;
+  for (auto& command : commands) buffer.push_back(command);
+  buffer.sort();
+  return buffer;
+}
+
+std::vector<RenderCommand> boxes(size_t count, double offset = 0)
+{
+  std::vector<RenderCommand> commands;
+  for (size_t i = 0; i < count; ++i)
+    commands.push_back(box(i + 1, Vector2d(20 + (i % 10) * 28 + offset, 20 + (i / 10) * 28)));
+  return commands;
+}
+
+bool damaged(const CairoDamageTracker& damage, int x, int y)
+{
+  return cairo_region_contains_point(damage.region(), x, y);
+}
+
+bool wholeFrame(const CairoDamageTracker& damage)
+{
+  cairo_rectangle_int_t whole = {0, 0, (int)frame_size.x, (int)frame_size.y};
+  return cairo_region_contains_rectangle(damage.region(), &whole) == CAIRO_REGION_OVERLAP_IN;
+}
+
+cairo_surface_t* blank()
+{
+  cairo_surface_t* surface =
+      cairo_image_surface_create(CAIRO_FORMAT_RGB24, frame_size.x, frame_size.y);
+  cairo_t* context = cairo_create(surface);
+  cairo_set_source_rgb(context, 1, 1, 1);
+  cairo_paint(context);
+  cairo_destroy(context);
+  return surface;
+}
+
+// Paints the background and buffer into surface, within region unless that is nullptr
+void draw(cairo_surface_t* surface, CairoRenderSystem& render_system,
+          const RenderCommandBuffer& buffer, const cairo_region_t* region)
+{
+  cairo_t* context = cairo_create(surface);
+  clip_to_region(context, region);
+  cairo_set_source_rgb(context, 1, 1, 1);
+  cairo_paint(context);
+  render_system.setContext(context);
+  render_system.execute(buffer);
+  render_system.setContext(nullptr);
+  cairo_destroy(context);
+  cairo_surface_flush(surface);
+}
+
+// Number of pixels that differ, ignoring the unused byte of RGB24
+size_t differences(cairo_surface_t* a, cairo_surface_t* b)
+{
+  size_t count = 0;
+  int stride = cairo_image_surface_get_stride(a);
+  const unsigned char* a_data = cairo_image_surface_get_data(a);
+  const unsigned char* b_data = cairo_image_surface_get_data(b);
+  for (unsigned int y = 0; y < frame_size.y; ++y)
+  {
+    auto a_row = reinterpret_cast<const uint32_t*>(a_data + y * stride);
+    auto b_row = reinterpret_cast<const uint32_t*>(b_data + y * stride);
+    for (unsigned int x = 0; x < frame_size.x; ++x)
+      if ((a_row[x] ^ b_row[x]) & 0xffffff) ++count;
+  }
+  return count;
+}
+}
+
+BOOST_AUTO_TEST_CASE(first_frame_is_all_damage)
+{
+  CairoDamageTracker damage;
+  damage.frame(buffer(boxes(3)), frame_size);
+  BOOST_CHECK(wholeFrame(damage));
+}
+
+BOOST_AUTO_TEST_CASE(unchanged_frame_is_no_damage)
+{
+  CairoDamageTracker damage;
+  damage.frame(buffer(boxes(30)), frame_size);
+  damage.frame(buffer(boxes(30)), frame_size);
+  BOOST_CHECK(damage.empty());
+}
+
+BOOST_AUTO_TEST_CASE(moved_command_damages_old_and_new_bounds)
+{
+  CairoDamageTracker damage;
+  std::vector<RenderCommand> commands = {box(1, Vector2d(50, 50)), box(2, Vector2d(250, 200))};
+  damage.frame(buffer(commands), frame_size);
+
+  commands[0].body.position = Vector2d(100, 50);
+  damage.frame(buffer(commands), frame_size);
+
+  BOOST_CHECK(damaged(damage, 50, 50));
+  BOOST_CHECK(damaged(damage, 100, 50));
+  BOOST_CHECK(!damaged(damage, 75, 50));
+  BOOST_CHECK(!damaged(damage, 250, 200));
+}
+
+BOOST_AUTO_TEST_CASE(added_and_removed_commands_are_damage)
+{
+  CairoDamageTracker damage;
+  damage.frame(buffer({box(1, Vector2d(50, 50))}), frame_size);
+  damage.frame(buffer({box(2, Vector2d(200, 150))}), frame_size);
+
+  BOOST_CHECK(damaged(damage, 50, 50));
+  BOOST_CHECK(damaged(damage, 200, 150));
+  BOOST_CHECK(!damaged(damage, 125, 100));
+}
+
+BOOST_AUTO_TEST_CASE(changed_appearance_is_damage)
+{
+  CairoDamageTracker damage;
+  damage.frame(buffer({box(1, Vector2d(50, 50))}), frame_size);
+  damage.frame(buffer({box(1, Vector2d(50, 50), Rgb(1, 0, 0))}), frame_size);
+  BOOST_CHECK(damaged(damage, 50, 50));
+}
+
+BOOST_AUTO_TEST_CASE(resize_and_invalidate_damage_everything)
+{
+  CairoDamageTracker damage;
+  damage.frame(buffer(boxes(3)), Vector2u(100, 100));
+  damage.frame(buffer(boxes(3)), frame_size);
+  BOOST_CHECK(wholeFrame(damage));
+
+  damage.frame(buffer(boxes(3)), frame_size);
+  BOOST_CHECK(damage.empty());
+
+  damage.invalidate();
+  damage.frame(buffer(boxes(3)), frame_size);
+  BOOST_CHECK(wholeFrame(damage));
+}
+
+BOOST_AUTO_TEST_CASE(damage_is_clipped_to_the_frame)
+{
+  CairoDamageTracker damage;
+  damage.frame(buffer({box(1, Vector2d(0, 0))}), frame_size);
+  damage.frame(buffer({box(1, Vector2d(frame_size.x, frame_size.y))}), frame_size);
+
+  cairo_rectangle_int_t extents;
+  cairo_region_get_extents(damage.region(), &extents);
+  BOOST_CHECK_GE(extents.x, 0);
+  BOOST_CHECK_GE(extents.y, 0);
+  BOOST_CHECK_LE(extents.x + extents.width, (int)frame_size.x);
+  BOOST_CHECK_LE(extents.y + extents.height, (int)frame_size.y);
+}
+
+BOOST_AUTO_TEST_CASE(many_rectangles_merge_into_their_extents)
+{
+  CairoDamageTracker damage;
+  damage.setMaxRectangles(4);
+  damage.frame(buffer(boxes(10)), frame_size);
+  damage.frame(buffer(boxes(10, 2)), frame_size);
+
+  BOOST_CHECK_EQUAL(cairo_region_num_rectangles(damage.region()), 1);
+  BOOST_CHECK(damaged(damage, 20, 20));
+  BOOST_CHECK(damaged(damage, 20 + 9 * 28, 20));
+}
+
+BOOST_AUTO_TEST_CASE(overflow_keeps_the_extents)
+{
+  CairoDamageTracker damage;
+  damage.setMaxRectangles(1000);
+
+  // More changed commands than the tracker unions one by one
+  std::vector<RenderCommand> commands;
+  for (uint32_t i = 0; i < 300; ++i) commands.push_back(box(i + 1, Vector2d(30 + i % 10, 40)));
+  damage.frame(buffer(commands), frame_size);
+  for (auto& command : commands) command.body.position.y = 200;
+  damage.frame(buffer(commands), frame_size);
+
+  BOOST_CHECK_EQUAL(cairo_region_num_rectangles(damage.region()), 1);
+  BOOST_CHECK(damaged(damage, 30, 40));
+  BOOST_CHECK(damaged(damage, 39, 200));
+  // Between the old and new rows; only the extents cover it
+  BOOST_CHECK(damaged(damage, 35, 120));
+}
+
+BOOST_AUTO_TEST_CASE(clip_to_region_limits_drawing)
+{
+  cairo_surface_t* surface = blank();
+  cairo_region_t* region = cairo_region_create();
+  cairo_rectangle_int_t rectangle = {10, 10, 20, 20};
+  cairo_region_union_rectangle(region, &rectangle);
+
+  cairo_t* context = cairo_create(surface);
+  clip_to_region(context, region);
+  cairo_set_source_rgb(context, 0, 0, 0);
+  cairo_paint(context);
+  cairo_destroy(context);
+  cairo_surface_flush(surface);
+
+  int stride = cairo_image_surface_get_stride(surface);
+  auto pixel = [&](int x, int y)
+  {
+    return reinterpret_cast<const uint32_t*>(cairo_image_surface_get_data(surface) +
+                                             y * stride)[x] & 0xffffff;
+  };
+  BOOST_CHECK_EQUAL(pixel(10, 10), 0u);
+  BOOST_CHECK_EQUAL(pixel(29, 29), 0u);
+  BOOST_CHECK_EQUAL(pixel(30, 30), 0xffffffu);
+  BOOST_CHECK_EQUAL(pixel(9, 20), 0xffffffu);
+
+  cairo_region_destroy(region);
+  cairo_surface_destroy(surface);
+}
+
+// What --present relies on: redrawing only the damage over the previous frame gives the same
+// pixels as drawing the whole frame
+BOOST_AUTO_TEST_CASE(damaged_redraw_matches_full_redraw)
+{
+  CairoRenderSystem incremental_render, full_render;
+  CairoDamageTracker damage;
+  cairo_surface_t* incremental = blank();
+
+  std::vector<RenderCommand> commands = boxes(60);
+  for (int frame = 0; frame < 20; ++frame)
+  {
+    // A few boxes move by fractions of a pixel, one changes colour, one comes and goes
+    for (size_t i = 0; i < commands.size(); i += 7)
+      commands[i].body.position.x += 0.35 * ((frame % 4) - 1.5);
+    commands[3] = box(4, commands[3].body.position, Rgb(frame % 2, 0.5, 0));
+    if (frame % 3 == 0)
+      commands.push_back(box(1000, Vector2d(frame * 15, 220)));
+    else if (commands.size() > 60)
+      commands.pop_back();
+
+    RenderCommandBuffer frame_buffer = buffer(commands);
+    damage.frame(frame_buffer, frame_size);
+    draw(incremental, incremental_render, frame_buffer, damage.region());
+
+    cairo_surface_t* full = blank();
+    draw(full, full_render, frame_buffer, nullptr);
+    BOOST_CHECK_MESSAGE(differences(incremental, full) == 0, "frame " << frame);
+    cairo_surface_destroy(full);
+  }
+
+  cairo_surface_destroy(incremental);
+}
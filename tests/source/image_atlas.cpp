@@ -0,0 +1,86 @@
+#define BOOST_TEST_MODULE image_atlas
+#include <boost/test/included/unit_test.hpp>
+
+#include <initializer_list>
+#include <string>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/cairo/image_atlas.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+// Four 30x30 images, padded, fill a 64x64 page
+const int page_size = 64;
+const size_t page_bytes = page_size * page_size * 4;
+
+std::string path(int image) { return "image-atlas-" + std::to_string(image) + ".png"; }
+
+void writeImages(int count)
+{
+  for (int i = 0; i < count; ++i)
+  {
+    cairo_surface_t* png = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 30, 30);
+    cairo_t* context = cairo_create(png);
+    cairo_set_source_rgb(context, i / (double)count, 0.5, 1);
+    cairo_paint(context);
+    cairo_destroy(context);
+    BOOST_REQUIRE_EQUAL(cairo_surface_write_to_png(png, path(i).c_str()), CAIRO_STATUS_SUCCESS);
+    cairo_surface_destroy(png);
+  }
+}
+
+// A frame drawing the images, the way CairoRenderSystem drives the atlas once they're decoded
+void frame(CairoImageAtlas& atlas, std::initializer_list<int> images)
+{
+  for (int image : images) atlas.lookup(path(image));
+  atlas.waitForDecodes();
+  atlas.beginFrame();
+  for (int image : images) BOOST_CHECK_MESSAGE(atlas.lookup(path(image)), path(image));
+  atlas.endFrame();
+}
+}
+
+BOOST_AUTO_TEST_CASE(pages_with_images_in_use_stay_whole)
+{
+  writeImages(12);
+  CairoImageAtlas atlas(page_size);
+  atlas.setMemoryBudget(2 * page_bytes);
+
+  frame(atlas, {0, 1, 2, 3});
+  frame(atlas, {4, 5, 6, 7});
+  BOOST_CHECK_EQUAL(atlas.stats().pages, 2u);
+
+  // A third page; the first still has an image in use, so the second goes
+  frame(atlas, {0, 8, 9});
+  BOOST_CHECK_LE(atlas.memoryUsage(), atlas.memoryBudget());
+  BOOST_CHECK_EQUAL(atlas.stats().pages, 2u);
+  BOOST_CHECK_EQUAL(atlas.stats().evictions, 4u);
+
+  // The first page's other images were kept rather than evicted to no avail
+  for (int image : {1, 2, 3}) BOOST_CHECK_MESSAGE(atlas.lookup(path(image)), path(image));
+  atlas.endFrame();
+
+  // Both pages mix images in use with images that aren't; nothing more is evicted or repacked
+  for (int i = 0; i < 10; ++i)
+  {
+    frame(atlas, {i % 4, 8 + i % 2});
+    BOOST_CHECK_LE(atlas.memoryUsage(), atlas.memoryBudget());
+  }
+  BOOST_CHECK_EQUAL(atlas.stats().pages, 2u);
+  BOOST_CHECK_EQUAL(atlas.stats().evictions, 4u);
+}
+
+BOOST_AUTO_TEST_CASE(pages_in_use_are_kept_over_budget)
+{
+  writeImages(8);
+  CairoImageAtlas atlas(page_size);
+  atlas.setMemoryBudget(page_bytes);
+
+  frame(atlas, {0, 1, 2, 3});
+  frame(atlas, {0, 4});
+  BOOST_CHECK_EQUAL(atlas.stats().pages, 2u);
+  BOOST_CHECK_EQUAL(atlas.stats().evictions, 0u);
+}
@@ -0,0 +1,130 @@
+#define BOOST_TEST_MODULE layout_async
+#include <boost/test/included/unit_test.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "entityx/entityx.h"
+#include "vibrant/body.hpp"
+#include "vibrant/layout.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+struct Scene
+{
+  Scene() : entities(events), systems(entities, events), layout(std::make_shared<LayoutSystem>())
+  {
+    systems.add(layout);
+    systems.configure();
+  }
+
+  // A row of boxes, each right of the one before, so the worker has something to chew on
+  void addRow(int count)
+  {
+    rhea::constraint_list constraints;
+    for (int i = 0; i < count; ++i)
+    {
+      entityx::Entity box = entities.create();
+      box.assign<Body>(Vector2d(0, 0), Vector2d(0, 0));
+      box.assign<Layout>(0, 0, 0, 0);
+      const Layout& current = *box.component<Layout>();
+      constraints.push_back(current.width == 10.0);
+      constraints.push_back(current.height == 10.0);
+      constraints.push_back(current.y == 0.0);
+      if (boxes.empty())
+      {
+        // Weak, so animating it moves the whole row
+        constraints.emplace_back(current.x == layout->left_limit, rhea::strength::weak());
+      }
+      else
+      {
+        const Layout& previous = *boxes.back().component<Layout>();
+        constraints.emplace_back(current.x == previous.x + previous.width + 1.0,
+                                 rhea::strength::strong());
+      }
+      boxes.push_back(box);
+    }
+    layout->addConstraints(constraints);
+  }
+
+  void update() { systems.update<LayoutSystem>(1); }
+
+  entityx::EventManager events;
+  entityx::EntityManager entities;
+  entityx::SystemManager systems;
+  std::shared_ptr<LayoutSystem> layout;
+  std::vector<entityx::Entity> boxes;
+};
+}
+
+BOOST_AUTO_TEST_CASE(animate_while_solving)
+{
+  Scene scene;
+  scene.addRow(10);
+  scene.update();
+  BOOST_CHECK_CLOSE(scene.boxes[9].component<Body>()->position.x, 99, 1e-6);
+
+  scene.layout->setAsynchronous(true);
+  // Published when going asynchronous, so animate() needn't touch the variables
+  BOOST_CHECK_CLOSE(scene.layout->value(scene.boxes[9].component<Layout>()->x), 99, 1e-6);
+  scene.layout->animate(scene.boxes[0].component<Layout>()->x, 20, 5, Ease::InOutQuad);
+
+  // Keeps the worker busy for a while, then solves a variable nothing has published yet
+  scene.addRow(300);
+  rhea::variable end;
+  const Layout& last = *scene.boxes.back().component<Layout>();
+  scene.layout->addConstraint(
+      rhea::constraint(end == last.x + last.width, rhea::strength::weak()));
+
+  // Each animate() asks where end is while the worker may be writing it
+  for (int frame = 0; frame < 50; ++frame)
+  {
+    scene.layout->animate(end, 4000, 5, Ease::InOutQuad);
+    scene.update();
+    for (entityx::Entity box : scene.boxes)
+    {
+      const Body& body = *box.component<Body>();
+      BOOST_CHECK(!std::isnan(body.position.x) && !std::isnan(body.size.x));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    scene.layout->waitForSolver();
+    scene.update();
+  }
+  BOOST_CHECK_EQUAL(scene.layout->animating(), 0);
+  BOOST_CHECK_CLOSE(scene.layout->value(end), 4000, 1e-6);
+
+  // Every box got its solved place, from the snapshots alone
+  for (size_t i = 0; i < scene.boxes.size(); ++i)
+  {
+    const Body& body = *scene.boxes[i].component<Body>();
+    BOOST_CHECK_CLOSE(body.position.x, 20 + i * 11.0, 1e-6);
+    BOOST_CHECK_CLOSE(body.size.x, 10, 1e-6);
+  }
+
+  scene.layout->setAsynchronous(false);
+  BOOST_CHECK_CLOSE(last.x.value(), 20 + 309 * 11.0, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(layout_added_while_asynchronous)
+{
+  Scene scene;
+  scene.layout->setAsynchronous(true);
+  scene.addRow(3);
+
+  // Not published yet, so not read
+  BOOST_CHECK(std::isnan(scene.layout->value(scene.boxes[2].component<Layout>()->x)));
+
+  scene.layout->waitForSolver();
+  scene.update();
+  BOOST_CHECK_EQUAL(scene.layout->value(scene.boxes[2].component<Layout>()->x), 22);
+  BOOST_CHECK_EQUAL(scene.boxes[2].component<Body>()->position.x, 22);
+}
@@ -0,0 +1,81 @@
+#define BOOST_TEST_MODULE text_measure
+#include <boost/test/included/unit_test.hpp>
+
+#include <memory>
+
+#include "entityx/entityx.h"
+#include "vibrant/body.hpp"
+#include "vibrant/layout.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+struct Scene
+{
+  Scene() : entities(events), systems(entities, events), layout(std::make_shared<LayoutSystem>())
+  {
+    systems.add(layout);
+    systems.configure();
+    layout->setTextMeasure([this](const Text& text)
+                           {
+                             ++measured;
+                             return Vector2d(text.text.size() * 10.0, 20);
+                           });
+  }
+
+  entityx::Entity label(const std::string& text)
+  {
+    entityx::Entity entity = entities.create();
+    entity.assign<Body>(Vector2d(0, 0), Vector2d(0, 0));
+    entity.assign<Layout>(0, 0, 0, 0);
+    entity.assign<Renderable>(Text(text, Font("Sans", 14), {Rgb()}), 0);
+    return entity;
+  }
+
+  void update() { systems.update<LayoutSystem>(1); }
+
+  entityx::EventManager events;
+  entityx::EntityManager entities;
+  entityx::SystemManager systems;
+  std::shared_ptr<LayoutSystem> layout;
+  int measured = 0;
+};
+}
+
+BOOST_AUTO_TEST_CASE(measured_once_until_edited)
+{
+  Scene scene;
+  entityx::Entity label = scene.label("Button");
+  scene.update();
+  BOOST_CHECK_EQUAL(scene.measured, 1);
+  BOOST_CHECK_GE(label.component<Body>()->size.x, 60);
+
+  for (int i = 0; i < 10; ++i) scene.update();
+  BOOST_CHECK_EQUAL(scene.measured, 1);
+
+  boost::get<Text>(label.component<Renderable>()->primitive).text = "A longer button";
+  scene.layout->remeasure(label);
+  scene.update();
+  BOOST_CHECK_EQUAL(scene.measured, 2);
+  BOOST_CHECK_GE(label.component<Body>()->size.x, 150);
+}
+
+BOOST_AUTO_TEST_CASE(entities_from_before_measurement_are_measured)
+{
+  Scene scene;
+  scene.layout->setTextMeasure(nullptr);
+  entityx::Entity label = scene.label("Button");
+  scene.update();
+
+  int measured = 0;
+  scene.layout->setTextMeasure([&](const Text&)
+                               {
+                                 ++measured;
+                                 return Vector2d(80, 20);
+                               });
+  scene.update();
+  scene.update();
+  BOOST_CHECK_EQUAL(measured, 1);
+  BOOST_CHECK_GE(label.component<Body>()->size.x, 80);
+}
@@ -0,0 +1,122 @@
+#define BOOST_TEST_MODULE vector_export
+#include <boost/test/included/unit_test.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <string>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/cairo/vector_export.hpp"
+
+using namespace vibrant;
+
+namespace
+{
+const Vector2d page_size(400, 300);
+
+RenderCommand command(uint32_t entity, Vector2d position, Vector2d size,
+                      RenderPrimitive primitive, double z, LayerId layer = NoLayer)
+{
+  return RenderCommand(entityx::Entity::Id(entity), Body(position, size),
+                       Renderable(primitive, z), layer);
+}
+
+// Gradients and alpha everywhere vector output supports them without rasterising
+RenderCommandBuffer translucentScene()
+{
+  RenderCommandBuffer buffer;
+  Gradient linear(GradientType::Linear, Vector2d(0, 0), Vector2d(1, 1),
+                  {{0, Rgb(1, 0, 0, 0.25)}, {0.5, Rgb(0, 1, 0)}, {1, Rgb(0, 0, 1, 0.75)}});
+  Gradient radial(GradientType::Radial, Vector2d(0.5, 0.5), Vector2d(1, 0.5),
+                  {{0, Rgb(1, 1, 1, 0.9)}, {1, Rgb(0, 0, 0, 0)}});
+
+  buffer.push_back(command(1, Vector2d(100, 80), Vector2d(160, 120),
+                           Rectangle({2, Rgb(0, 0, 0, 0.5)}, {Rgb(), linear}), 0));
+  buffer.push_back(command(2, Vector2d(250, 150), Vector2d(120, 120),
+                           Rectangle({0, Rgb()}, {Rgb(), radial}), 1));
+  buffer.push_back(command(3, Vector2d(200, 200), Vector2d(200, 60),
+                           Rectangle({4, Rgb(1, 0.5, 0, 0.3)}, {Rgb(0, 0.5, 1, 0.4)}), 2));
+  buffer.push_back(command(4, Vector2d(50, 250), Vector2d(300, 0), Line({3, Rgb(0, 0, 0, 0.6)}),
+                           3));
+  buffer.push_back(command(5, Vector2d(200, 40), Vector2d(200, 30),
+                           Text("Translucent", Font("sans", 18), {Rgb(0.2, 0.2, 0.2, 0.5)}), 4));
+  // Drawn in place for vector output rather than composited from a raster
+  buffer.push_back(command(6, Vector2d(80, 200), Vector2d(60, 60),
+                           Rectangle({1, Rgb()}, {Rgb(1, 0, 1, 0.5)}), 5, 0));
+  buffer.push_back(command(7, Vector2d(110, 230), Vector2d(60, 60),
+                           Rectangle({0, Rgb()}, {Rgb(), linear}), 6, 0));
+  buffer.sort();
+  return buffer;
+}
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Image XObjects are streams, which PDF keeps out of compressed object streams, so their
+// dictionaries are always plain text
+bool pdfHasImage(const std::string& pdf)
+{
+  return std::regex_search(pdf, std::regex("/Subtype\\s*/Image\\b"));
+}
+
+bool svgHasImage(const std::string& svg) { return svg.find("<image") != std::string::npos; }
+
+void exportFrames(VectorFormat format, const std::string& path, const RenderCommandBuffer& buffer)
+{
+  CairoVectorExport exporter(format, path, page_size);
+  exporter.frame(buffer);
+  exporter.frame(buffer);
+  exporter.finish();
+  BOOST_REQUIRE_EQUAL(exporter.status(), CAIRO_STATUS_SUCCESS);
+  BOOST_CHECK_EQUAL(exporter.frames(), 2u);
+}
+}
+
+BOOST_AUTO_TEST_CASE(pdf_without_image_fallbacks)
+{
+  exportFrames(VectorFormat::Pdf, "vector-export.pdf", translucentScene());
+
+  std::string pdf = readFile("vector-export.pdf");
+  BOOST_REQUIRE(!pdf.empty());
+  BOOST_CHECK(!pdfHasImage(pdf));
+}
+
+BOOST_AUTO_TEST_CASE(svg_without_image_fallbacks)
+{
+  exportFrames(VectorFormat::Svg, "vector-export-%d.svg", translucentScene());
+
+  for (const char* path : {"vector-export-0.svg", "vector-export-1.svg"})
+  {
+    std::string svg = readFile(path);
+    BOOST_REQUIRE(!svg.empty());
+    BOOST_CHECK_MESSAGE(!svgHasImage(svg), path);
+  }
+}
+
+// So the checks above can tell when there is an image
+BOOST_AUTO_TEST_CASE(images_are_found)
+{
+  cairo_surface_t* png = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 8, 8);
+  cairo_t* context = cairo_create(png);
+  cairo_set_source_rgba(context, 0, 0.5, 1, 0.5);
+  cairo_paint(context);
+  cairo_destroy(context);
+  BOOST_REQUIRE_EQUAL(cairo_surface_write_to_png(png, "vector-export.png"),
+                      CAIRO_STATUS_SUCCESS);
+  cairo_surface_destroy(png);
+
+  RenderCommandBuffer buffer;
+  buffer.push_back(command(1, Vector2d(200, 150), Vector2d(64, 64), Image("vector-export.png"), 0));
+
+  exportFrames(VectorFormat::Pdf, "vector-export-image.pdf", buffer);
+  BOOST_CHECK(pdfHasImage(readFile("vector-export-image.pdf")));
+
+  exportFrames(VectorFormat::Svg, "vector-export-image-%d.svg", buffer);
+  BOOST_CHECK(svgHasImage(readFile("vector-export-image-0.svg")));
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_BOUNDS_HPP
+
+#include <algorithm>
+#include <cmath>
+
+#include "vibrant/command_buffer.hpp"
+
+namespace vibrant
+{
+struct Bounds
+{
+  void add(double x, double y, double pad)
+  {
+    x1 = std::min(x1, x - pad);
+    y1 = std::min(y1, y - pad);
+    x2 = std::max(x2, x + pad);
+    y2 = std::max(y2, y + pad);
+  }
+
+  bool empty() const { return x2 <= x1 || y2 <= y1; }
+
+  double x1 = HUGE_VAL, y1 = HUGE_VAL, x2 = -HUGE_VAL, y2 = -HUGE_VAL;
+};
+
+// Grows bounds by the extents of command as drawn by CairoRenderSystem without a transform,
+// padded for antialiasing
+void add_bounds(Bounds& bounds, const RenderCommand& command);
+}
+
+#endif  // VIBRANT_CAIRO_BOUNDS_HPP
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_DAMAGE_HPP
+
+#include "cairo/cairo.h"
+
+#include "vibrant/vector.hpp"
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/cairo/bounds.hpp"
+
+namespace vibrant
+{
+// Tracks which part of the frame changed since the previous one, so presenting it only has to
+// copy that part.
+//
+// Drawing is deterministic, so outside the bounds of commands that were added, removed or changed
+// a frame is identical to the one before. Anything that changes drawing without changing the
+// commands, like a resize, a new quality level or a different clear colour, needs invalidate().
+class CairoDamageTracker
+{
+ public:
+  CairoDamageTracker();
+  ~CairoDamageTracker();
+
+  CairoDamageTracker(const CairoDamageTracker&) = delete;
+  CairoDamageTracker& operator=(const CairoDamageTracker&) = delete;
+
+  // Compares buffer with the previous frame. region() is then what changed, within size.
+  void frame(const RenderCommandBuffer& buffer, Vector2u size);
+
+  // Damages the whole of the next frame
+  void invalidate() { invalidated = true; }
+
+  const cairo_region_t* region() const { return damage; }
+  bool empty() const { return cairo_region_is_empty(damage); }
+
+  // Damage made of more rectangles than this is merged into its extents; each rectangle is a
+  // separate copy when presenting
+  void setMaxRectangles(int count) { max_rectangles = count; }
+
+ private:
+  void add(const RenderCommand& command);
+  void add(const Bounds& bounds);
+
+  // Commands damaged this frame; past overflow only their extents are tracked
+  static const size_t overflow = 256;
+  size_t added = 0;
+  Bounds extents;
+
+  RenderCommandBuffer previous;
+  Vector2u previous_size;
+  cairo_region_t* damage;
+  bool invalidated = true;
+  int max_rectangles = 16;
+};
+
+// Clips context to region, or leaves it unclipped for nullptr
+void clip_to_region(cairo_t* context, const cairo_region_t* region);
+}
+
+#endif  // VIBRANT_CAIRO_DAMAGE_HPP
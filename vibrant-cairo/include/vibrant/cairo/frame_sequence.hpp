@@ -0,0 +1,96 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_FRAME_SEQUENCE_HPP
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/vector.hpp"
+
+namespace vibrant
+{
+enum class FrameFormat
+{
+  Png,  // a file per frame
+  Rgba  // unpremultiplied 8 bit RGBA frames back to back in a single stream
+};
+
+struct FrameSequenceStats
+{
+  size_t frames = 0;     // handed to the encoders
+  size_t stalls = 0;     // beginFrame() had to wait for an encoder
+  double stall_ms = 0;   // total time spent waiting
+};
+
+// Renders an animation offline into a ring of image surfaces while a pool of encoder threads
+// writes finished frames out, so rendering frame N+1 overlaps encoding frame N. When every
+// surface in the ring is waiting to be encoded, beginFrame() blocks until one is free.
+//
+// Drive it with a fixed timestep: beginFrame(), draw, endFrame(), per step.
+class CairoFrameSequence
+{
+ public:
+  // For Png, path is a printf pattern for the frame number, like "frame-%04d.png". For Rgba, path
+  // is the file (or named pipe) to stream to, or "-" for stdout; frames are written in order.
+  // encoder_count defaults to one fewer than the number of cores.
+  CairoFrameSequence(FrameFormat format, std::string path, Vector2u size, size_t ring_size = 4,
+                     unsigned int encoder_count = 0);
+  ~CairoFrameSequence();
+
+  CairoFrameSequence(const CairoFrameSequence&) = delete;
+  CairoFrameSequence& operator=(const CairoFrameSequence&) = delete;
+
+  // A context on a cleared ring surface, owned by the sequence until endFrame()
+  cairo_t* beginFrame();
+  void endFrame();
+
+  // Waits for every frame to be written and closes the output; called by the destructor if
+  // need be
+  void finish();
+
+  FrameSequenceStats stats() const;
+  // The first error; frames after one are dropped
+  cairo_status_t status() const;
+
+ private:
+  struct Slot
+  {
+    cairo_surface_t* surface;
+    size_t frame;
+  };
+
+  void encode();
+  cairo_status_t writePng(const Slot& slot);
+  cairo_status_t convertRgba(const Slot& slot, std::vector<unsigned char>& pixels);
+
+  FrameFormat format;
+  std::string path;
+  Vector2u size;
+  FILE* stream = nullptr;
+  std::vector<Slot> slots;
+  size_t current;
+  cairo_t* context = nullptr;
+
+  // Shared with the encoder threads
+  mutable std::mutex mutex;
+  std::condition_variable queued_changed;
+  std::condition_variable free_changed;
+  std::condition_variable written;
+  std::deque<size_t> free_slots;
+  std::deque<size_t> queued;
+  size_t next_write = 0;
+  bool stopping = false;
+  FrameSequenceStats sequence_stats;
+  cairo_status_t error = CAIRO_STATUS_SUCCESS;
+
+  std::vector<std::thread> encoders;
+};
+}
+
+#endif  // VIBRANT_CAIRO_FRAME_SEQUENCE_HPP
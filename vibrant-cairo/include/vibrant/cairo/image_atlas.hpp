@@ -0,0 +1,130 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_IMAGE_ATLAS_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "cairo/cairo.h"
+
+namespace vibrant
+{
+struct ImageAtlasStats
+{
+  size_t pages = 0;
+  size_t images = 0;
+  size_t pending = 0;
+  size_t failed = 0;
+  size_t evictions = 0;
+};
+
+// Packs decoded images into a few large image surfaces so many image draws share a handful of
+// sources.
+//
+// Images are decoded lazily on a background thread the first time they are looked up, and packed
+// into pages with a shelf packer by beginFrame(). While the atlas is over its memory budget,
+// endFrame() frees whole pages with no image drawn during the frame, least recently used first,
+// evicting their images. All functions but the destructor must be called from the same (render)
+// thread.
+class CairoImageAtlas
+{
+ public:
+  struct Slot
+  {
+    cairo_surface_t* page;
+    int x, y, width, height;
+  };
+
+  explicit CairoImageAtlas(int page_size = 2048);
+  ~CairoImageAtlas();
+
+  CairoImageAtlas(const CairoImageAtlas&) = delete;
+  CairoImageAtlas& operator=(const CairoImageAtlas&) = delete;
+
+  // Where the image is packed, or nullptr while it is being decoded or if it failed to decode.
+  // Counts as a reference for the current frame.
+  const Slot* lookup(const std::string& path);
+
+  // Packs images decoded since the last call. Returns true if any of them became drawable.
+  bool beginFrame();
+  // Evicts unreferenced pages while over the memory budget, and resets reference counts
+  void endFrame();
+
+  // Blocks until every image looked up so far is decoded, for output that can't show images
+  // popping in later. beginFrame() packs them.
+  void waitForDecodes();
+
+  void setMemoryBudget(size_t bytes) { memory_budget = bytes; }
+  size_t memoryBudget() const { return memory_budget; }
+  size_t memoryUsage() const { return memory_usage; }
+
+  ImageAtlasStats stats() const;
+
+ private:
+  struct Shelf
+  {
+    int y, height, x;
+  };
+
+  struct Page
+  {
+    cairo_surface_t* surface;
+    int width, height;
+    size_t bytes;
+    std::vector<Shelf> shelves;
+  };
+
+  enum class State
+  {
+    Pending,
+    Ready,
+    Failed
+  };
+
+  struct Entry
+  {
+    State state = State::Pending;
+    Page* page = nullptr;
+    Slot slot;
+    unsigned int references = 0;
+    uint64_t last_used = 0;
+  };
+
+  struct Decoded
+  {
+    std::string path;
+    cairo_surface_t* surface;
+  };
+
+  void decode();
+  void pack(Entry& entry, cairo_surface_t* decoded);
+  bool place(Page& page, int width, int height, int& x, int& y);
+  void evict(Page* page);
+
+  int page_size;
+  std::list<Page> pages;
+  std::unordered_map<std::string, Entry> entries;
+  size_t memory_budget = 64 * 1024 * 1024;
+  size_t memory_usage = 0;
+  uint64_t frame = 0;
+  size_t evictions = 0;
+
+  // Shared with the decoding thread
+  std::mutex mutex;
+  std::condition_variable requested;
+  std::condition_variable idle;
+  std::deque<std::string> requests;
+  std::vector<Decoded> decoded;
+  bool decoding = false;
+  bool stopping = false;
+  std::thread decoder;
+};
+}
+
+#endif  // VIBRANT_CAIRO_IMAGE_ATLAS_HPP
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_LAYER_CACHE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "entityx/entityx.h"
+#include "cairo/cairo.h"
+
+#include "vibrant/layer.hpp"
+#include "vibrant/command_buffer.hpp"
+
+namespace vibrant
+{
+struct LayerCacheStats
+{
+  size_t hits = 0;           // composited from the cached surface
+  size_t misses = 0;         // had to be rasterised
+  size_t invalidations = 0;  // a member's Body or Renderable changed
+  size_t evictions = 0;      // dropped to stay under the memory limit
+  size_t uncached = 0;       // drawn directly; too large or changing every frame
+};
+
+class CairoLayerCache
+{
+ public:
+  typedef std::vector<const RenderCommand*> Members;
+  typedef std::function<void(cairo_t*)> RasteriseFunction;
+
+  CairoLayerCache() {}
+  ~CairoLayerCache();
+
+  CairoLayerCache(const CairoLayerCache&) = delete;
+  CairoLayerCache& operator=(const CairoLayerCache&) = delete;
+
+  // Composites layer id onto context with a single paint. The layer is re-rasterised into its
+  // offscreen surface through rasterise first if it isn't cached yet or a member changed since.
+  // Layers that can't be cached are rasterised directly onto context instead. Surfaces hold
+  // device pixels, so scaling or rotating context re-rasterises the layer; translating it by
+  // whole pixels doesn't.
+  void draw(cairo_t* context, LayerId id, const Members& members, RasteriseFunction rasterise);
+
+  void evict(LayerId id);
+  void clear();
+
+  void setMemoryLimit(size_t bytes);
+  size_t memoryLimit() const { return memory_limit; }
+  size_t memoryUsage() const { return memory_usage; }
+  size_t size() const { return entries.size(); }
+
+  // Number of consecutive changed frames after which a layer is drawn directly rather than
+  // re-rasterised every frame. It is cached again once it stays unchanged for a frame.
+  void setVolatileFrames(unsigned int frames) { volatile_frames = frames; }
+
+  const LayerCacheStats& stats() const { return cache_stats; }
+  void resetStats() { cache_stats = LayerCacheStats(); }
+
+ private:
+  struct Entry
+  {
+    cairo_surface_t* surface = nullptr;
+    int x = 0, y = 0, width = 0, height = 0;
+    size_t bytes = 0;
+    size_t fingerprint = 0;
+    unsigned int changes = 0;
+    uint64_t last_used = 0;
+  };
+
+  void release(Entry& entry);
+  void evictToFit(size_t bytes, LayerId keep);
+
+  std::unordered_map<LayerId, Entry> entries;
+  size_t memory_limit = 64 * 1024 * 1024;
+  size_t memory_usage = 0;
+  unsigned int volatile_frames = 2;
+  uint64_t use_clock = 0;
+  LayerCacheStats cache_stats;
+};
+}
+
+#endif  // VIBRANT_CAIRO_LAYER_CACHE_HPP
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_PATH_CACHE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include "entityx/entityx.h"
+#include "cairo/cairo.h"
+
+namespace vibrant
+{
+// Identifies the local-space geometry of a primitive. Two keys compare equal exactly when the
+// primitive would build the same path, so transform-only changes never invalidate.
+struct PathKey
+{
+  int kind;
+  double a, b;
+};
+
+inline bool operator==(const PathKey& lhs, const PathKey& rhs)
+{
+  return lhs.kind == rhs.kind && lhs.a == rhs.a && lhs.b == rhs.b;
+}
+
+struct PathCacheStats
+{
+  size_t hits = 0;
+  size_t builds = 0;
+  size_t evictions = 0;
+};
+
+// Per-entity paths in local coordinates. Drawing appends the cached path under the entity's
+// current transform, so path construction only costs anything when geometry changes.
+class CairoPathCache
+{
+ public:
+  typedef std::function<void(cairo_t*)> BuildFunction;
+
+  CairoPathCache();
+  ~CairoPathCache();
+
+  CairoPathCache(const CairoPathCache&) = delete;
+  CairoPathCache& operator=(const CairoPathCache&) = delete;
+
+  // Appends the path of entity to context's current path, calling build on a scratch context
+  // with an identity transform first if key differs from the cached geometry
+  void append(cairo_t* context, entityx::Entity::Id entity, const PathKey& key,
+              BuildFunction build);
+
+  // Drops the paths of entities that weren't drawn since the previous call
+  void prune();
+  void clear();
+
+  size_t size() const { return entries.size(); }
+
+  const PathCacheStats& stats() const { return cache_stats; }
+  void resetStats() { cache_stats = PathCacheStats(); }
+
+ private:
+  struct Entry
+  {
+    PathKey key;
+    cairo_path_t* path;
+    uint64_t generation;
+  };
+
+  cairo_surface_t* scratch_surface;
+  cairo_t* scratch;
+  std::unordered_map<uint64_t, Entry> entries;
+  uint64_t generation = 0;
+  PathCacheStats cache_stats;
+};
+}
+
+#endif  // VIBRANT_CAIRO_PATH_CACHE_HPP
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_PATTERN_CACHE_HPP
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/gradient.hpp"
+
+namespace vibrant
+{
+struct PatternCacheStats
+{
+  size_t hits = 0;
+  size_t creations = 0;
+  size_t evictions = 0;
+};
+
+// Gradient patterns shared between everything drawn with an identical gradient. Patterns are
+// built in the gradient's unit box coordinates and never modified afterwards; callers map them
+// onto a shape by setting them as the source under a scaled transform.
+class CairoPatternCache
+{
+ public:
+  CairoPatternCache() {}
+  ~CairoPatternCache();
+
+  CairoPatternCache(const CairoPatternCache&) = delete;
+  CairoPatternCache& operator=(const CairoPatternCache&) = delete;
+
+  // Owned by the cache; valid until the next prune() or clear()
+  cairo_pattern_t* get(const Gradient& gradient);
+
+  // Drops the patterns that weren't used since the previous call
+  void prune();
+  void clear();
+
+  size_t size() const { return entries.size(); }
+
+  const PatternCacheStats& stats() const { return cache_stats; }
+  void resetStats() { cache_stats = PatternCacheStats(); }
+
+ private:
+  struct GradientHash
+  {
+    size_t operator()(const Gradient& gradient) const;
+  };
+
+  struct Entry
+  {
+    cairo_pattern_t* pattern;
+    uint64_t generation;
+  };
+
+  std::unordered_map<Gradient, Entry, GradientHash> entries;
+  uint64_t generation = 0;
+  PatternCacheStats cache_stats;
+};
+}
+
+#endif  // VIBRANT_CAIRO_PATTERN_CACHE_HPP
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_QUALITY_GOVERNOR_HPP
+
+#include <atomic>
+#include <mutex>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/cairo/visibility.hpp"
+
+namespace vibrant
+{
+enum class QualityLevel
+{
+  Best,
+  Reduced,
+  Minimal
+};
+
+const size_t QualityLevels = 3;
+
+struct QualitySettings
+{
+  cairo_antialias_t antialias;
+  // Maximum error when flattening curves, in device pixels; larger is coarser and cheaper
+  double tolerance;
+  VisibilityPolicy visibility;
+};
+
+struct QualityGovernorSettings
+{
+  QualityGovernorSettings();
+
+  double budget_ms = 1000 / 60.0;
+  // The smoothed render time must stay above budget_ms * degrade_above for degrade_frames frames
+  // to drop a level, and below budget_ms * restore_below for restore_frames frames to go back up
+  double degrade_above = 1.0;
+  double restore_below = 0.5;
+  unsigned int degrade_frames = 3;
+  unsigned int restore_frames = 60;
+  // Weight of the latest frame in the smoothed render time
+  double smoothing = 0.25;
+
+  QualitySettings levels[QualityLevels];  // indexed by QualityLevel
+};
+
+struct QualityMetrics
+{
+  QualityLevel level = QualityLevel::Best;
+  double last_ms = 0;
+  double smoothed_ms = 0;
+  size_t frames[QualityLevels] = {};  // rendered at each level
+  size_t degrades = 0;
+  size_t restores = 0;       // gradual, as render time recovered
+  size_t idle_restores = 0;  // straight back to best because the scene went idle
+};
+
+// Trades rendering quality for speed under load. CairoRenderSystem applies the current level's
+// settings to every frame it executes and reports how long the frame took; the governor steps
+// down a level when frames stay over budget and back up once they have headroom again. When the
+// host reports the scene idle, e.g. no EasingSystem has anything active, it goes straight back to
+// best quality so still frames look their best.
+//
+// Disabled by default; the context's antialias and tolerance are then left alone and the render
+// system's own VisibilityPolicy applies.
+class CairoQualityGovernor
+{
+ public:
+  CairoQualityGovernor() {}
+
+  CairoQualityGovernor(const CairoQualityGovernor&) = delete;
+  CairoQualityGovernor& operator=(const CairoQualityGovernor&) = delete;
+
+  void setEnabled(bool enable) { enabled_flag = enable; }
+  bool enabled() const { return enabled_flag; }
+
+  void setSettings(const QualityGovernorSettings& settings);
+  QualityGovernorSettings settings() const;
+
+  // May be called from another thread than the one rendering, but then applies to whichever
+  // frame finishes next. To apply it to a given frame, set it where that frame is executed.
+  void setIdle(bool idle) { idle_flag = idle; }
+
+  QualitySettings current() const;
+  // Records a frame's render time and picks the level for the next frame
+  void frame(double render_ms);
+
+  QualityMetrics metrics() const;
+  void resetMetrics();
+
+ private:
+  mutable std::mutex mutex;
+  QualityGovernorSettings governor_settings;
+  QualityMetrics quality_metrics;
+  unsigned int over_frames = 0;
+  unsigned int under_frames = 0;
+  std::atomic<bool> enabled_flag{false};
+  std::atomic<bool> idle_flag{false};
+};
+}
+
+#endif  // VIBRANT_CAIRO_QUALITY_GOVERNOR_HPP
@@ -6,6 +6,15 @@
 
 #include "vibrant/renderable.hpp"
 #include "vibrant/body.hpp"
+#include "vibrant/layer.hpp"
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/cairo/layer_cache.hpp"
+#include "vibrant/cairo/path_cache.hpp"
+#include "vibrant/cairo/text_cache.hpp"
+#include "vibrant/cairo/image_atlas.hpp"
+#include "vibrant/cairo/pattern_cache.hpp"
+#include "vibrant/cairo/visibility.hpp"
+#include "vibrant/cairo/quality_governor.hpp"
 
 namespace vibrant
 {
@@ -14,16 +23,61 @@ class CairoRenderSystem : public entityx::System<CairoRenderSystem>
  public:
   CairoRenderSystem() {}
 
+  // Records the frame into commands() and executes it
   void update(entityx::EntityManager& es, entityx::EventManager& events,
               entityx::TimeDelta dt) override;
 
+  // Draws a recorded frame onto the context. This doesn't touch the ECS, so it can run on another
+  // thread while the next frame is simulated.
+  void execute(const RenderCommandBuffer& buffer);
+
   void setContext(cairo_t* arg_context) { context = arg_context; }
 
+  // How far update() interpolates bodies between the last two simulation steps, see FixedTimestep
+  void setInterpolation(double alpha) { interpolation = alpha; }
+  // Threads update() records large frames with, see RenderCommandBuffer::record
+  void setRecordThreads(unsigned int threads) { record_threads = threads; }
+
+  // Set when drawing to a vector surface such as PDF or SVG. Layers are drawn in place rather
+  // than composited from cached rasters, and images are decoded before drawing. The visibility
+  // pass only skips primitives that draw nothing at any resolution.
+  void setVectorOutput(bool vector) { vector_output = vector; }
+
+  void setVisibilityPolicy(const VisibilityPolicy& policy) { visibility_policy = policy; }
+  const VisibilityPolicy& visibilityPolicy() const { return visibility_policy; }
+  const RenderStats& frameStats() const { return frame_stats; }
+
+  // Overrides the visibility policy, antialiasing and tolerance while enabled
+  CairoQualityGovernor& qualityGovernor() { return quality_governor; }
+
+  const RenderCommandBuffer& commands() const { return command_buffer; }
+  CairoLayerCache& layerCache() { return layer_cache; }
+  CairoPathCache& pathCache() { return path_cache; }
+  // Also measures text for LayoutSystem::setTextMeasure; safe to use from another thread
+  CairoTextCache& textCache() { return text_cache; }
+  CairoImageAtlas& imageAtlas() { return image_atlas; }
+  CairoPatternCache& patternCache() { return pattern_cache; }
+
  private:
+  void classify(const RenderCommandBuffer& buffer, const VisibilityPolicy& policy);
+  void draw(cairo_t* target, const RenderCommand& command, PrimitiveVisibility visibility);
+
   cairo_t* context = nullptr;
-  typedef std::tuple<Renderable::Handle, Body::Handle> EntityPack;
-  std::vector<EntityPack> m_orderedEntities;
+  bool vector_output = false;
+  double interpolation = 1;
+  unsigned int record_threads = 1;
+  VisibilityPolicy visibility_policy;
+  RenderStats frame_stats;
+  std::vector<PrimitiveVisibility> m_visibility;
+  RenderCommandBuffer command_buffer;
+  std::unordered_map<LayerId, CairoLayerCache::Members> m_layers;
+  CairoLayerCache layer_cache;
+  CairoPathCache path_cache;
+  CairoTextCache text_cache;
+  CairoImageAtlas image_atlas;
+  CairoPatternCache pattern_cache;
+  CairoQualityGovernor quality_governor;
 };
 }
 
-#endif  // VIBRANT_CAIRO_RENDER_HPP
\ No newline at end of file
+#endif  // VIBRANT_CAIRO_RENDER_HPP
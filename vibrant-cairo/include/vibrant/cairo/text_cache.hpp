@@ -0,0 +1,100 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_TEXT_CACHE_HPP
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/renderable.hpp"
+#include "vibrant/vector.hpp"
+
+namespace vibrant
+{
+// Shaped glyphs of a string, positioned with the baseline's left end at the origin
+struct GlyphRun
+{
+  cairo_scaled_font_t* font;
+  std::vector<cairo_glyph_t> glyphs;
+  double advance;
+  double ascent;
+  double descent;
+
+  // Logical size used for layout: the advance by the font's line height
+  Vector2d size() const { return Vector2d(advance, ascent + descent); }
+};
+
+struct TextCacheStats
+{
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+};
+
+// LRU cache of glyph runs keyed by (string, font), so unchanged labels are never re-shaped.
+// Shared between the render thread drawing text and the simulation thread measuring it for layout.
+//
+// A scaled font is kept while any cached run uses it and counts against the memory limit, so
+// animating a font size doesn't pile up a font for every size it passed through.
+class CairoTextCache
+{
+ public:
+  CairoTextCache() {}
+  ~CairoTextCache();
+
+  CairoTextCache(const CairoTextCache&) = delete;
+  CairoTextCache& operator=(const CairoTextCache&) = delete;
+
+  // The returned run stays valid even if it is evicted meanwhile
+  std::shared_ptr<const GlyphRun> shape(const std::string& text, const Font& font);
+
+  // Intrinsic size of text, as used by LayoutSystem
+  Vector2d measure(const Text& text) { return shape(text.text, text.font)->size(); }
+
+  void setMemoryLimit(size_t bytes);
+  size_t memoryLimit() const;
+  size_t memoryUsage() const;
+  size_t size() const;
+  // Scaled fonts held for the cached runs
+  size_t fontCount() const;
+
+  TextCacheStats stats() const;
+  double hitRate() const;
+  void resetStats();
+
+  void clear();
+
+ private:
+  struct Entry
+  {
+    std::shared_ptr<const GlyphRun> run;
+    std::list<std::string>::iterator lru;
+    size_t bytes;
+    std::string font;
+  };
+
+  struct FontEntry
+  {
+    cairo_scaled_font_t* font;
+    size_t runs;
+  };
+
+  FontEntry& scaledFont(const std::string& key, const Font& font);
+  void release(const std::string& font);
+  void evictToFit();
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, Entry> runs;
+  std::list<std::string> lru;  // most recently used first
+  std::unordered_map<std::string, FontEntry> fonts;
+  size_t memory_limit = 16 * 1024 * 1024;
+  size_t memory_usage = 0;
+  TextCacheStats cache_stats;
+};
+}
+
+#endif  // VIBRANT_CAIRO_TEXT_CACHE_HPP
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_VECTOR_EXPORT_HPP
+
+#include <string>
+
+#include "cairo/cairo.h"
+
+#include "vibrant/vector.hpp"
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/cairo/render.hpp"
+
+namespace vibrant
+{
+enum class VectorFormat
+{
+  Pdf,
+  Svg
+};
+
+// Renders recorded frames to PDF or SVG with vector output. Each frame is written out as soon as
+// it's drawn, so an export of hundreds of pages needs about as much memory as one.
+class CairoVectorExport
+{
+ public:
+  // A PDF export writes every frame as a page of the document at path. An SVG export writes a
+  // document per frame; path is a printf pattern for the frame number, like "frame-%04d.svg".
+  // One pixel of size is one point.
+  CairoVectorExport(VectorFormat format, std::string path, Vector2d size);
+  ~CairoVectorExport();
+
+  CairoVectorExport(const CairoVectorExport&) = delete;
+  CairoVectorExport& operator=(const CairoVectorExport&) = delete;
+
+  void frame(const RenderCommandBuffer& buffer);
+  // Completes the output; called by the destructor if need be
+  void finish();
+
+  size_t frames() const { return frame_count; }
+  // The first error; nothing more is written after one
+  cairo_status_t status() const { return error; }
+
+ private:
+  void check(cairo_status_t status);
+
+  VectorFormat format;
+  std::string path;
+  Vector2d size;
+  cairo_surface_t* document = nullptr;
+  size_t frame_count = 0;
+  cairo_status_t error = CAIRO_STATUS_SUCCESS;
+  CairoRenderSystem render_system;
+};
+}
+
+#endif  // VIBRANT_CAIRO_VECTOR_EXPORT_HPP
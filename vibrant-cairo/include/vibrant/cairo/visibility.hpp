@@ -0,0 +1,42 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_VISIBILITY_HPP
+
+#include <cstddef>
+
+namespace vibrant
+{
+// Thresholds for the visibility pass that runs over a frame before it is drawn. Extents are in
+// device pixels.
+struct VisibilityPolicy
+{
+  // Drawing with less alpha than this doesn't change an 8 bit pixel
+  double min_alpha = 0.5 / 255;
+  // Primitives smaller than this in both dimensions are skipped
+  double min_extent = 0.1;
+  // Rectangles no larger than this in both dimensions are drawn as a single pixel, with their
+  // coverage folded into its alpha. Zero disables the collapse.
+  double pixel_extent = 1.0;
+};
+
+// How the visibility pass treats a primitive
+enum class PrimitiveVisibility
+{
+  Draw,
+  Pixel,
+  Transparent,
+  Empty,
+  Subpixel
+};
+
+// What the visibility pass did with the last frame
+struct RenderStats
+{
+  size_t drawn = 0;
+  size_t pixels = 0;       // collapsed to a single pixel write
+  size_t transparent = 0;  // no visible fill or stroke
+  size_t empty = 0;        // zero area, or nothing to draw
+  size_t subpixel = 0;     // smaller than VisibilityPolicy::min_extent
+};
+}
+
+#endif  // VIBRANT_CAIRO_VISIBILITY_HPP
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef VIBRANT_CAIRO_XLIB_PRESENTER_HPP
+
+#include "cairo/cairo.h"
+
+#if defined(CAIRO_HAS_XLIB_SURFACE)
+
+#include <cstddef>
+
+#include <X11/Xlib.h>
+#if defined(VIBRANT_HAS_XSHM)
+#include <X11/extensions/XShm.h>
+#endif
+
+#include "vibrant/vector.hpp"
+
+namespace vibrant
+{
+struct PresentStats
+{
+  size_t presents = 0;
+  size_t rectangles = 0;  // copied to the window
+  size_t pixels = 0;
+  double last_ms = 0;
+  double total_ms = 0;
+};
+
+// Presents an RGB24 backbuffer to an X window.
+//
+// With MIT-SHM the backbuffer is the shared memory image itself, so drawing into it is drawing
+// into what the server reads from and presenting is a server-side copy per damaged rectangle.
+// present() waits for the server to finish reading before returning, as the next frame draws into
+// the same memory. Without MIT-SHM, e.g. on a remote display, the backbuffer is painted through a
+// cairo-xlib surface instead.
+class CairoXlibPresenter
+{
+ public:
+  // Uses the window's visual and depth. Must be destroyed before the display is closed.
+  CairoXlibPresenter(Display* display, Window window);
+  ~CairoXlibPresenter();
+
+  CairoXlibPresenter(const CairoXlibPresenter&) = delete;
+  CairoXlibPresenter& operator=(const CairoXlibPresenter&) = delete;
+
+  // An RGB24 surface at least size large, owned by the presenter. It is only recreated when it
+  // has to grow, so shrinking a window keeps the one it has.
+  cairo_surface_t* backbuffer(Vector2u size);
+  Vector2u backbufferSize() const { return size; }
+
+  // Copies the damaged part of the backbuffer, or all of it for nullptr, to the window
+  void present(const cairo_region_t* damage = nullptr);
+
+  bool sharedMemory() const;
+
+  const PresentStats& stats() const { return present_stats; }
+  void resetStats() { present_stats = PresentStats(); }
+
+ private:
+  bool createShared();
+  void destroy();
+
+  Display* display;
+  Window window;
+  Visual* visual;
+  int depth;
+  GC gc;
+  Vector2u size;
+  cairo_surface_t* surface = nullptr;
+  cairo_surface_t* window_surface = nullptr;
+#if defined(VIBRANT_HAS_XSHM)
+  bool shm_supported;
+  XShmSegmentInfo shm_info;
+  XImage* shm_image = nullptr;
+#endif
+  PresentStats present_stats;
+};
+}
+
+#endif  // CAIRO_HAS_XLIB_SURFACE
+
+#endif  // VIBRANT_CAIRO_XLIB_PRESENTER_HPP
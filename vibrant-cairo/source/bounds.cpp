@@ -0,0 +1,53 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/bounds.hpp"
+
+namespace vibrant
+{
+namespace
+{
+class bounds_visitor : public boost::static_visitor<>
+{
+ public:
+  bounds_visitor(Bounds& bounds, const Body& body) : bounds(bounds), body(body) {}
+
+  void operator()(const Line& line) const
+  {
+    double pad = line.stroke.width / 2 + 1;
+    double length = std::max(body.size.x, body.size.y);
+    bounds.add(body.position.x, body.position.y, pad);
+    bounds.add(body.position.x + cos(body.rotation) * length,
+               body.position.y + sin(body.rotation) * length, pad);
+  }
+
+  void operator()(const Rectangle& rect) const { addBox(fabs(rect.stroke.width) / 2 + 1); }
+
+  void operator()(const Text& text) const
+  {
+    // Glyphs can overhang their logical box, which is what layout gives the body
+    addBox(text.font.size + fabs(text.stroke.width) / 2 + 1);
+  }
+
+  void operator()(const Image& image) const { addBox(fabs(image.stroke.width) / 2 + 1); }
+
+ private:
+  void addBox(double pad) const
+  {
+    double c = cos(body.rotation), s = sin(body.rotation);
+    double hw = body.size.x / 2, hh = body.size.y / 2;
+    double extent_x = fabs(c * hw) + fabs(s * hh);
+    double extent_y = fabs(s * hw) + fabs(c * hh);
+    bounds.add(body.position.x - extent_x, body.position.y - extent_y, pad);
+    bounds.add(body.position.x + extent_x, body.position.y + extent_y, pad);
+  }
+
+  Bounds& bounds;
+  const Body& body;
+};
+}
+
+void add_bounds(Bounds& bounds, const RenderCommand& command)
+{
+  boost::apply_visitor(bounds_visitor(bounds, command.body), command.primitive);
+}
+}
@@ -0,0 +1,111 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/damage.hpp"
+
+#include <unordered_map>
+
+namespace vibrant
+{
+CairoDamageTracker::CairoDamageTracker() : damage(cairo_region_create()) {}
+
+CairoDamageTracker::~CairoDamageTracker() { cairo_region_destroy(damage); }
+
+void CairoDamageTracker::frame(const RenderCommandBuffer& buffer, Vector2u size)
+{
+  cairo_region_destroy(damage);
+  damage = cairo_region_create();
+
+  cairo_rectangle_int_t whole = {0, 0, (int)size.x, (int)size.y};
+  if (invalidated || size.x != previous_size.x || size.y != previous_size.y)
+  {
+    cairo_region_union_rectangle(damage, &whole);
+  }
+  else
+  {
+    added = 0;
+    extents = Bounds();
+
+    std::unordered_map<uint64_t, const RenderCommand*> before;
+    before.reserve(previous.size());
+    for (auto& command : previous) before.emplace(command.entity.id(), &command);
+
+    // A changed command damages both where it was and where it is now
+    for (auto& command : buffer)
+    {
+      auto found = before.find(command.entity.id());
+      if (found == before.end())
+      {
+        add(command);
+        continue;
+      }
+
+      if (*found->second != command)
+      {
+        add(*found->second);
+        add(command);
+      }
+      before.erase(found);
+    }
+
+    for (auto& removed : before) add(*removed.second);
+
+    if (added > overflow)
+    {
+      cairo_region_destroy(damage);
+      damage = cairo_region_create();
+      add(extents);
+    }
+
+    cairo_region_intersect_rectangle(damage, &whole);
+    if (cairo_region_num_rectangles(damage) > max_rectangles)
+    {
+      cairo_rectangle_int_t rectangle;
+      cairo_region_get_extents(damage, &rectangle);
+      cairo_region_destroy(damage);
+      damage = cairo_region_create_rectangle(&rectangle);
+    }
+  }
+
+  previous = buffer;
+  previous_size = size;
+  invalidated = false;
+}
+
+void CairoDamageTracker::add(const RenderCommand& command)
+{
+  // Past a few rectangles' worth, the union only grows the extents; a region of thousands of
+  // rectangles would cost more to build than copying its extents
+  if (++added > overflow)
+  {
+    add_bounds(extents, command);
+    return;
+  }
+
+  Bounds bounds;
+  add_bounds(bounds, command);
+  add_bounds(extents, command);
+  add(bounds);
+}
+
+void CairoDamageTracker::add(const Bounds& bounds)
+{
+  if (bounds.empty()) return;
+
+  int x = (int)floor(bounds.x1), y = (int)floor(bounds.y1);
+  cairo_rectangle_int_t rectangle = {x, y, (int)ceil(bounds.x2) - x, (int)ceil(bounds.y2) - y};
+  cairo_region_union_rectangle(damage, &rectangle);
+}
+
+void clip_to_region(cairo_t* context, const cairo_region_t* region)
+{
+  if (!region) return;
+
+  for (int i = 0; i < cairo_region_num_rectangles(region); ++i)
+  {
+    cairo_rectangle_int_t rectangle;
+    cairo_region_get_rectangle(region, i, &rectangle);
+    cairo_rectangle(context, rectangle.x, rectangle.y, rectangle.width, rectangle.height);
+  }
+  cairo_clip(context);
+}
+}
@@ -0,0 +1,209 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/frame_sequence.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+
+namespace vibrant
+{
+CairoFrameSequence::CairoFrameSequence(FrameFormat format, std::string path, Vector2u size,
+                                       size_t ring_size, unsigned int encoder_count)
+    : format(format), path(path), size(size), current(ring_size)
+{
+  if (format == FrameFormat::Rgba)
+  {
+    stream = path == "-" ? stdout : fopen(path.c_str(), "wb");
+    if (!stream) error = CAIRO_STATUS_WRITE_ERROR;
+  }
+
+  for (size_t i = 0; i < ring_size; ++i)
+  {
+    slots.push_back(
+        {cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)size.x, (int)size.y), 0});
+    free_slots.push_back(i);
+  }
+
+  // Leave a core for the thread rendering the frames
+  unsigned int cores = std::thread::hardware_concurrency();
+  if (!encoder_count) encoder_count = cores > 1 ? cores - 1 : 1;
+  for (unsigned int i = 0; i < encoder_count; ++i)
+    encoders.emplace_back(&CairoFrameSequence::encode, this);
+}
+
+CairoFrameSequence::~CairoFrameSequence()
+{
+  finish();
+  for (auto& slot : slots) cairo_surface_destroy(slot.surface);
+}
+
+cairo_t* CairoFrameSequence::beginFrame()
+{
+  assert(!context);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (free_slots.empty())
+    {
+      auto start = std::chrono::steady_clock::now();
+      free_changed.wait(lock, [this] { return !free_slots.empty(); });
+      ++sequence_stats.stalls;
+      sequence_stats.stall_ms += std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - start).count();
+    }
+    current = free_slots.front();
+    free_slots.pop_front();
+  }
+
+  context = cairo_create(slots[current].surface);
+  cairo_save(context);
+  cairo_set_operator(context, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(context);
+  cairo_restore(context);
+  return context;
+}
+
+void CairoFrameSequence::endFrame()
+{
+  assert(context);
+  cairo_destroy(context);
+  context = nullptr;
+  cairo_surface_flush(slots[current].surface);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    slots[current].frame = sequence_stats.frames++;
+    queued.push_back(current);
+  }
+  queued_changed.notify_one();
+}
+
+void CairoFrameSequence::finish()
+{
+  if (encoders.empty()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  queued_changed.notify_all();
+  for (auto& encoder : encoders) encoder.join();
+  encoders.clear();
+
+  if (stream)
+  {
+    if (fflush(stream) != 0 && error == CAIRO_STATUS_SUCCESS) error = CAIRO_STATUS_WRITE_ERROR;
+    if (stream != stdout) fclose(stream);
+    stream = nullptr;
+  }
+}
+
+FrameSequenceStats CairoFrameSequence::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return sequence_stats;
+}
+
+cairo_status_t CairoFrameSequence::status() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return error;
+}
+
+void CairoFrameSequence::encode()
+{
+  std::vector<unsigned char> pixels;
+  for (;;)
+  {
+    size_t index;
+    bool failed;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      queued_changed.wait(lock, [this] { return stopping || !queued.empty(); });
+      if (queued.empty()) return;
+
+      index = queued.front();
+      queued.pop_front();
+      failed = error != CAIRO_STATUS_SUCCESS;
+    }
+
+    const Slot& slot = slots[index];
+    size_t frame = slot.frame;
+    // After an error frames are dropped
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    if (!failed) status = format == FrameFormat::Png ? writePng(slot) : convertRgba(slot, pixels);
+
+    // The surface can be rendered into again as soon as its pixels are copied out
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      free_slots.push_back(index);
+    }
+    free_changed.notify_one();
+
+    if (format == FrameFormat::Rgba)
+    {
+      // Frames are dequeued in order, so whoever holds frame next_write never waits here
+      std::unique_lock<std::mutex> lock(mutex);
+      written.wait(lock, [this, frame] { return next_write == frame; });
+      lock.unlock();
+
+      if (!failed && status == CAIRO_STATUS_SUCCESS &&
+          fwrite(pixels.data(), 1, pixels.size(), stream) != pixels.size())
+        status = CAIRO_STATUS_WRITE_ERROR;
+
+      lock.lock();
+      ++next_write;
+      lock.unlock();
+      written.notify_all();
+    }
+
+    if (status != CAIRO_STATUS_SUCCESS)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (error == CAIRO_STATUS_SUCCESS) error = status;
+    }
+  }
+}
+
+cairo_status_t CairoFrameSequence::writePng(const Slot& slot)
+{
+  std::vector<char> file(path.size() + 32);
+  snprintf(file.data(), file.size(), path.c_str(), (int)slot.frame);
+  return cairo_surface_write_to_png(slot.surface, file.data());
+}
+
+cairo_status_t CairoFrameSequence::convertRgba(const Slot& slot,
+                                               std::vector<unsigned char>& pixels)
+{
+  int width = cairo_image_surface_get_width(slot.surface);
+  int height = cairo_image_surface_get_height(slot.surface);
+  int stride = cairo_image_surface_get_stride(slot.surface);
+  const unsigned char* data = cairo_image_surface_get_data(slot.surface);
+  if (!data) return CAIRO_STATUS_NULL_POINTER;
+
+  pixels.resize((size_t)width * height * 4);
+  unsigned char* out = pixels.data();
+  for (int y = 0; y < height; ++y)
+  {
+    // ARGB32 is premultiplied, native endian
+    const uint32_t* row = reinterpret_cast<const uint32_t*>(data + (size_t)y * stride);
+    for (int x = 0; x < width; ++x, out += 4)
+    {
+      uint32_t pixel = row[x];
+      unsigned int a = pixel >> 24;
+      unsigned int r = (pixel >> 16) & 0xff, g = (pixel >> 8) & 0xff, b = pixel & 0xff;
+      if (a && a != 255)
+      {
+        r = (r * 255 + a / 2) / a;
+        g = (g * 255 + a / 2) / a;
+        b = (b * 255 + a / 2) / a;
+      }
+      out[0] = (unsigned char)r;
+      out[1] = (unsigned char)g;
+      out[2] = (unsigned char)b;
+      out[3] = (unsigned char)a;
+    }
+  }
+  return CAIRO_STATUS_SUCCESS;
+}
+}
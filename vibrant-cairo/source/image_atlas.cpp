@@ -0,0 +1,257 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/image_atlas.hpp"
+
+#include <algorithm>
+
+namespace vibrant
+{
+namespace
+{
+// Transparent gap between packed images so bilinear filtering never samples a neighbour
+const int padding = 1;
+}
+
+CairoImageAtlas::CairoImageAtlas(int page_size)
+    : page_size(page_size), decoder(&CairoImageAtlas::decode, this)
+{
+}
+
+CairoImageAtlas::~CairoImageAtlas()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  requested.notify_all();
+  decoder.join();
+
+  for (auto& done : decoded) cairo_surface_destroy(done.surface);
+  for (auto& page : pages) cairo_surface_destroy(page.surface);
+}
+
+const CairoImageAtlas::Slot* CairoImageAtlas::lookup(const std::string& path)
+{
+  auto found = entries.find(path);
+  if (found == entries.end())
+  {
+    found = entries.emplace(path, Entry()).first;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      requests.push_back(path);
+    }
+    requested.notify_one();
+  }
+
+  Entry& entry = found->second;
+  ++entry.references;
+  entry.last_used = frame;
+  return entry.state == State::Ready ? &entry.slot : nullptr;
+}
+
+bool CairoImageAtlas::beginFrame()
+{
+  std::vector<Decoded> done;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done.swap(decoded);
+  }
+
+  bool packed = false;
+  for (auto& image : done)
+  {
+    auto found = entries.find(image.path);
+    if (found == entries.end() || !image.surface)
+    {
+      if (found != entries.end()) found->second.state = State::Failed;
+      if (image.surface) cairo_surface_destroy(image.surface);
+      continue;
+    }
+
+    pack(found->second, image.surface);
+    cairo_surface_destroy(image.surface);
+    packed = true;
+  }
+  return packed;
+}
+
+void CairoImageAtlas::endFrame()
+{
+  if (memory_usage > memory_budget)
+  {
+    // Shelf space isn't reclaimed piecemeal, so only whole pages give memory back: evict those
+    // without an image drawn this frame, least recently used first
+    std::unordered_map<Page*, uint64_t> unreferenced;
+    for (auto& page : pages) unreferenced.emplace(&page, 0);
+    for (auto& entry : entries)
+    {
+      auto found = unreferenced.find(entry.second.page);
+      if (found == unreferenced.end()) continue;
+
+      if (entry.second.references)
+        unreferenced.erase(found);
+      else
+        found->second = std::max(found->second, entry.second.last_used);
+    }
+
+    std::vector<std::pair<uint64_t, Page*>> oldest;
+    for (auto& page : unreferenced) oldest.emplace_back(page.second, page.first);
+    std::sort(oldest.begin(), oldest.end());
+    for (auto& page : oldest)
+    {
+      if (memory_usage <= memory_budget) break;
+      evict(page.second);
+    }
+  }
+
+  for (auto& entry : entries) entry.second.references = 0;
+  ++frame;
+}
+
+void CairoImageAtlas::waitForDecodes()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return requests.empty() && !decoding; });
+}
+
+ImageAtlasStats CairoImageAtlas::stats() const
+{
+  ImageAtlasStats stats;
+  stats.pages = pages.size();
+  stats.evictions = evictions;
+  for (auto& entry : entries)
+  {
+    if (entry.second.state == State::Ready) ++stats.images;
+    if (entry.second.state == State::Pending) ++stats.pending;
+    if (entry.second.state == State::Failed) ++stats.failed;
+  }
+  return stats;
+}
+
+void CairoImageAtlas::decode()
+{
+  for (;;)
+  {
+    std::string path;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      requested.wait(lock, [this] { return stopping || !requests.empty(); });
+      if (stopping) return;
+
+      path = requests.front();
+      requests.pop_front();
+      decoding = true;
+    }
+
+    cairo_surface_t* surface = cairo_image_surface_create_from_png(path.c_str());
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy(surface);
+      surface = nullptr;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      decoded.push_back({path, surface});
+      decoding = false;
+    }
+    idle.notify_all();
+  }
+}
+
+void CairoImageAtlas::pack(Entry& entry, cairo_surface_t* image)
+{
+  int width = cairo_image_surface_get_width(image);
+  int height = cairo_image_surface_get_height(image);
+
+  Page* target = nullptr;
+  int x = 0, y = 0;
+  for (auto& page : pages)
+  {
+    if (place(page, width, height, x, y))
+    {
+      target = &page;
+      break;
+    }
+  }
+
+  if (!target)
+  {
+    // Images larger than a page get a page of their own
+    int page_width = std::max(page_size, width + padding);
+    int page_height = std::max(page_size, height + padding);
+    cairo_surface_t* surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, page_width, page_height);
+    size_t bytes = (size_t)cairo_image_surface_get_stride(surface) * page_height;
+    pages.push_back({surface, page_width, page_height, bytes, {}});
+    memory_usage += bytes;
+
+    target = &pages.back();
+    place(*target, width, height, x, y);
+  }
+
+  cairo_t* context = cairo_create(target->surface);
+  cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(context, image, x, y);
+  cairo_rectangle(context, x, y, width, height);
+  cairo_fill(context);
+  cairo_destroy(context);
+
+  entry.state = State::Ready;
+  entry.page = target;
+  entry.slot = {target->surface, x, y, width, height};
+}
+
+bool CairoImageAtlas::place(Page& page, int width, int height, int& x, int& y)
+{
+  width += padding;
+  height += padding;
+
+  // The lowest shelf that fits wastes the least height
+  Shelf* best = nullptr;
+  for (auto& shelf : page.shelves)
+  {
+    if (shelf.height < height || shelf.x + width > page.width) continue;
+    if (!best || shelf.height < best->height) best = &shelf;
+  }
+
+  if (!best)
+  {
+    int top = page.shelves.empty() ? 0 : page.shelves.back().y + page.shelves.back().height;
+    if (top + height > page.height || width > page.width) return false;
+
+    page.shelves.push_back({top, height, 0});
+    best = &page.shelves.back();
+  }
+
+  x = best->x;
+  y = best->y;
+  best->x += width;
+  return true;
+}
+
+void CairoImageAtlas::evict(Page* page)
+{
+  for (auto it = entries.begin(); it != entries.end();)
+  {
+    if (it->second.page != page)
+    {
+      ++it;
+      continue;
+    }
+
+    it = entries.erase(it);
+    ++evictions;
+  }
+
+  memory_usage -= page->bytes;
+  cairo_surface_destroy(page->surface);
+  for (auto it = pages.begin(); it != pages.end(); ++it)
+  {
+    if (&*it != page) continue;
+
+    pages.erase(it);
+    break;
+  }
+}
+}
@@ -0,0 +1,265 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/layer_cache.hpp"
+#include "vibrant/cairo/bounds.hpp"
+
+#include "boost/functional/hash.hpp"
+
+namespace vibrant
+{
+namespace
+{
+void hash_color(size_t& seed, const Rgb& color)
+{
+  boost::hash_combine(seed, color.r);
+  boost::hash_combine(seed, color.g);
+  boost::hash_combine(seed, color.b);
+  boost::hash_combine(seed, color.a);
+}
+
+void hash_fill(size_t& seed, const Fill& fill)
+{
+  hash_color(seed, fill.color);
+  const Gradient& gradient = fill.gradient;
+  boost::hash_combine(seed, (int)gradient.type);
+  boost::hash_combine(seed, gradient.start.x);
+  boost::hash_combine(seed, gradient.start.y);
+  boost::hash_combine(seed, gradient.end.x);
+  boost::hash_combine(seed, gradient.end.y);
+  for (auto& stop : gradient.stops)
+  {
+    boost::hash_combine(seed, stop.offset);
+    hash_color(seed, stop.color);
+  }
+}
+
+class fingerprint_visitor : public boost::static_visitor<>
+{
+ public:
+  fingerprint_visitor(size_t& seed) : seed(seed) {}
+
+  void operator()(const Line& line) const
+  {
+    boost::hash_combine(seed, 0);
+    boost::hash_combine(seed, line.stroke.width);
+    hash_color(seed, line.stroke.color);
+  }
+
+  void operator()(const Rectangle& rect) const
+  {
+    boost::hash_combine(seed, 1);
+    boost::hash_combine(seed, rect.stroke.width);
+    hash_color(seed, rect.stroke.color);
+    hash_fill(seed, rect.fill);
+  }
+
+  void operator()(const Text& text) const
+  {
+    boost::hash_combine(seed, 2);
+    boost::hash_combine(seed, text.text);
+    boost::hash_combine(seed, text.font.family);
+    boost::hash_combine(seed, text.font.size);
+    boost::hash_combine(seed, text.font.bold);
+    boost::hash_combine(seed, text.font.italic);
+    boost::hash_combine(seed, text.stroke.width);
+    hash_color(seed, text.stroke.color);
+    hash_fill(seed, text.fill);
+  }
+
+  void operator()(const Image& image) const
+  {
+    boost::hash_combine(seed, 3);
+    boost::hash_combine(seed, image.path);
+    boost::hash_combine(seed, image.opacity);
+    boost::hash_combine(seed, image.stroke.width);
+    hash_color(seed, image.stroke.color);
+  }
+
+ private:
+  size_t& seed;
+};
+
+size_t layer_fingerprint(const CairoLayerCache::Members& members)
+{
+  size_t seed = members.size();
+  for (const RenderCommand* member : members)
+  {
+    const Body& body = member->body;
+    boost::hash_combine(seed, body.position.x);
+    boost::hash_combine(seed, body.position.y);
+    boost::hash_combine(seed, body.size.x);
+    boost::hash_combine(seed, body.size.y);
+    boost::hash_combine(seed, body.rotation);
+    boost::hash_combine(seed, member->z);
+    boost::apply_visitor(fingerprint_visitor(seed), member->primitive);
+  }
+  return seed;
+}
+
+// Device pixels onto device pixels, so the cached surface composites without resampling whatever
+// the CTM scales or rotates
+void composite(cairo_t* context, cairo_surface_t* surface, double x, double y)
+{
+  cairo_save(context);
+  cairo_identity_matrix(context);
+  cairo_set_source_surface(context, surface, x, y);
+  cairo_paint(context);
+  cairo_restore(context);
+}
+}
+
+CairoLayerCache::~CairoLayerCache() { clear(); }
+
+void CairoLayerCache::draw(cairo_t* context, LayerId id, const Members& members,
+                           RasteriseFunction rasterise)
+{
+  // Layers are rasterised in device space, so the pixels depend on the CTM too. Whole pixels of
+  // translation only move them, and are left out.
+  cairo_matrix_t ctm;
+  cairo_get_matrix(context, &ctm);
+  double shift_x = floor(ctm.x0), shift_y = floor(ctm.y0);
+
+  size_t fingerprint = layer_fingerprint(members);
+  boost::hash_combine(fingerprint, ctm.xx);
+  boost::hash_combine(fingerprint, ctm.yx);
+  boost::hash_combine(fingerprint, ctm.xy);
+  boost::hash_combine(fingerprint, ctm.yy);
+  boost::hash_combine(fingerprint, ctm.x0 - shift_x);
+  boost::hash_combine(fingerprint, ctm.y0 - shift_y);
+
+  auto found = entries.find(id);
+  bool fresh = found == entries.end();
+  if (fresh) found = entries.emplace(id, Entry()).first;
+  Entry& entry = found->second;
+  entry.last_used = ++use_clock;
+
+  if (entry.surface && entry.fingerprint == fingerprint)
+  {
+    ++cache_stats.hits;
+    composite(context, entry.surface, entry.x + shift_x, entry.y + shift_y);
+    return;
+  }
+
+  ++cache_stats.misses;
+  if (!fresh && entry.fingerprint != fingerprint)
+  {
+    ++cache_stats.invalidations;
+    ++entry.changes;
+  }
+  else
+  {
+    entry.changes = 0;
+  }
+  entry.fingerprint = fingerprint;
+
+  Bounds bounds;
+  for (const RenderCommand* member : members)
+    add_bounds(bounds, *member);
+  if (bounds.empty())
+  {
+    release(entry);
+    return;
+  }
+
+  // The device-space box around the user-space one, with another pixel for antialiasing in case
+  // the CTM scales down
+  Bounds device;
+  const double corners[4][2] = {{bounds.x1, bounds.y1}, {bounds.x2, bounds.y1},
+                                {bounds.x2, bounds.y2}, {bounds.x1, bounds.y2}};
+  for (auto& corner : corners)
+  {
+    double x = corner[0], y = corner[1];
+    cairo_user_to_device(context, &x, &y);
+    device.add(x - shift_x, y - shift_y, 1);
+  }
+
+  // Snap to whole pixels so the cached surface composites without resampling
+  int x = (int)floor(device.x1), y = (int)floor(device.y1);
+  int width = (int)ceil(device.x2) - x, height = (int)ceil(device.y2) - y;
+  size_t bytes = (size_t)cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width) * height;
+
+  // Re-rasterising a layer that changes every frame costs more than drawing it directly
+  if (entry.changes >= volatile_frames || bytes > memory_limit)
+  {
+    release(entry);
+    ++cache_stats.uncached;
+    rasterise(context);
+    return;
+  }
+
+  if (entry.surface && (entry.width != width || entry.height != height)) release(entry);
+
+  if (!entry.surface)
+  {
+    evictToFit(bytes, id);
+    entry.surface = cairo_surface_create_similar(cairo_get_target(context),
+                                                 CAIRO_CONTENT_COLOR_ALPHA, width, height);
+    entry.width = width;
+    entry.height = height;
+    entry.bytes = bytes;
+    memory_usage += bytes;
+  }
+  entry.x = x;
+  entry.y = y;
+
+  cairo_t* layer_context = cairo_create(entry.surface);
+  cairo_set_operator(layer_context, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(layer_context);
+  cairo_set_operator(layer_context, CAIRO_OPERATOR_OVER);
+  cairo_translate(layer_context, -x - shift_x, -y - shift_y);
+  cairo_transform(layer_context, &ctm);
+  rasterise(layer_context);
+  cairo_destroy(layer_context);
+
+  composite(context, entry.surface, entry.x + shift_x, entry.y + shift_y);
+}
+
+void CairoLayerCache::evict(LayerId id)
+{
+  auto found = entries.find(id);
+  if (found == entries.end()) return;
+
+  release(found->second);
+  entries.erase(found);
+}
+
+void CairoLayerCache::clear()
+{
+  for (auto& entry : entries) release(entry.second);
+  entries.clear();
+}
+
+void CairoLayerCache::setMemoryLimit(size_t bytes)
+{
+  memory_limit = bytes;
+  evictToFit(0, 0);
+}
+
+void CairoLayerCache::release(Entry& entry)
+{
+  if (!entry.surface) return;
+
+  cairo_surface_destroy(entry.surface);
+  entry.surface = nullptr;
+  memory_usage -= entry.bytes;
+  entry.bytes = 0;
+}
+
+void CairoLayerCache::evictToFit(size_t bytes, LayerId keep)
+{
+  // Least recently composited first
+  while (memory_usage + bytes > memory_limit)
+  {
+    auto oldest = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+      if (!it->second.surface || (bytes && it->first == keep)) continue;
+      if (oldest == entries.end() || it->second.last_used < oldest->second.last_used) oldest = it;
+    }
+    if (oldest == entries.end()) return;
+
+    release(oldest->second);
+    ++cache_stats.evictions;
+  }
+}
+}
@@ -0,0 +1,74 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/path_cache.hpp"
+
+namespace vibrant
+{
+CairoPathCache::CairoPathCache()
+    : scratch_surface(cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1)),
+      scratch(cairo_create(scratch_surface))
+{
+}
+
+CairoPathCache::~CairoPathCache()
+{
+  clear();
+  cairo_destroy(scratch);
+  cairo_surface_destroy(scratch_surface);
+}
+
+void CairoPathCache::append(cairo_t* context, entityx::Entity::Id entity, const PathKey& key,
+                            BuildFunction build)
+{
+  auto found = entries.find(entity.id());
+  if (found != entries.end() && found->second.key == key)
+  {
+    ++cache_stats.hits;
+  }
+  else
+  {
+    ++cache_stats.builds;
+    cairo_new_path(scratch);
+    build(scratch);
+    cairo_path_t* path = cairo_copy_path(scratch);
+    cairo_new_path(scratch);
+
+    if (found == entries.end())
+    {
+      found = entries.emplace(entity.id(), Entry{key, path, generation}).first;
+    }
+    else
+    {
+      cairo_path_destroy(found->second.path);
+      found->second.key = key;
+      found->second.path = path;
+    }
+  }
+
+  found->second.generation = generation;
+  cairo_append_path(context, found->second.path);
+}
+
+void CairoPathCache::prune()
+{
+  for (auto it = entries.begin(); it != entries.end();)
+  {
+    if (it->second.generation == generation)
+    {
+      ++it;
+      continue;
+    }
+
+    cairo_path_destroy(it->second.path);
+    it = entries.erase(it);
+    ++cache_stats.evictions;
+  }
+  ++generation;
+}
+
+void CairoPathCache::clear()
+{
+  for (auto& entry : entries) cairo_path_destroy(entry.second.path);
+  entries.clear();
+}
+}
@@ -0,0 +1,90 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/pattern_cache.hpp"
+
+#include "boost/functional/hash.hpp"
+
+namespace vibrant
+{
+CairoPatternCache::~CairoPatternCache() { clear(); }
+
+cairo_pattern_t* CairoPatternCache::get(const Gradient& gradient)
+{
+  auto found = entries.find(gradient);
+  if (found != entries.end())
+  {
+    ++cache_stats.hits;
+    found->second.generation = generation;
+    return found->second.pattern;
+  }
+
+  ++cache_stats.creations;
+  cairo_pattern_t* pattern;
+  if (gradient.type == GradientType::Radial)
+  {
+    double radius = hypot(gradient.end.x - gradient.start.x, gradient.end.y - gradient.start.y);
+    pattern = cairo_pattern_create_radial(gradient.start.x, gradient.start.y, 0,
+                                          gradient.start.x, gradient.start.y, radius);
+  }
+  else
+  {
+    pattern = cairo_pattern_create_linear(gradient.start.x, gradient.start.y, gradient.end.x,
+                                          gradient.end.y);
+  }
+
+  // Translucent stops need a soft mask in PDF output, so only add alpha where there is some
+  for (auto& stop : gradient.stops)
+  {
+    const Rgb& color = stop.color;
+    if (color.a >= 1)
+      cairo_pattern_add_color_stop_rgb(pattern, stop.offset, color.r, color.g, color.b);
+    else
+      cairo_pattern_add_color_stop_rgba(pattern, stop.offset, color.r, color.g, color.b, color.a);
+  }
+
+  entries.emplace(gradient, Entry{pattern, generation});
+  return pattern;
+}
+
+void CairoPatternCache::prune()
+{
+  for (auto it = entries.begin(); it != entries.end();)
+  {
+    if (it->second.generation == generation)
+    {
+      ++it;
+      continue;
+    }
+
+    cairo_pattern_destroy(it->second.pattern);
+    it = entries.erase(it);
+    ++cache_stats.evictions;
+  }
+  ++generation;
+}
+
+void CairoPatternCache::clear()
+{
+  for (auto& entry : entries) cairo_pattern_destroy(entry.second.pattern);
+  entries.clear();
+}
+
+size_t CairoPatternCache::GradientHash::operator()(const Gradient& gradient) const
+{
+  size_t seed = 0;
+  boost::hash_combine(seed, (int)gradient.type);
+  boost::hash_combine(seed, gradient.start.x);
+  boost::hash_combine(seed, gradient.start.y);
+  boost::hash_combine(seed, gradient.end.x);
+  boost::hash_combine(seed, gradient.end.y);
+  for (auto& stop : gradient.stops)
+  {
+    boost::hash_combine(seed, stop.offset);
+    boost::hash_combine(seed, stop.color.r);
+    boost::hash_combine(seed, stop.color.g);
+    boost::hash_combine(seed, stop.color.b);
+    boost::hash_combine(seed, stop.color.a);
+  }
+  return seed;
+}
+}
@@ -0,0 +1,108 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/quality_governor.hpp"
+
+namespace vibrant
+{
+QualityGovernorSettings::QualityGovernorSettings()
+{
+  QualitySettings& best = levels[(size_t)QualityLevel::Best];
+  best.antialias = CAIRO_ANTIALIAS_DEFAULT;
+  best.tolerance = 0.1;
+
+  QualitySettings& reduced = levels[(size_t)QualityLevel::Reduced];
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 12, 0)
+  reduced.antialias = CAIRO_ANTIALIAS_FAST;
+#else
+  reduced.antialias = CAIRO_ANTIALIAS_DEFAULT;
+#endif
+  reduced.tolerance = 0.5;
+  reduced.visibility.min_alpha = 2 / 255.0;
+  reduced.visibility.min_extent = 0.5;
+  reduced.visibility.pixel_extent = 2;
+
+  QualitySettings& minimal = levels[(size_t)QualityLevel::Minimal];
+  minimal.antialias = CAIRO_ANTIALIAS_NONE;
+  minimal.tolerance = 1.0;
+  minimal.visibility.min_alpha = 4 / 255.0;
+  minimal.visibility.min_extent = 1;
+  minimal.visibility.pixel_extent = 3;
+}
+
+void CairoQualityGovernor::setSettings(const QualityGovernorSettings& settings)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  governor_settings = settings;
+}
+
+QualityGovernorSettings CairoQualityGovernor::settings() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return governor_settings;
+}
+
+QualitySettings CairoQualityGovernor::current() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return governor_settings.levels[(size_t)quality_metrics.level];
+}
+
+void CairoQualityGovernor::frame(double render_ms)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  QualityMetrics& metrics = quality_metrics;
+  const QualityGovernorSettings& settings = governor_settings;
+
+  ++metrics.frames[(size_t)metrics.level];
+  metrics.last_ms = render_ms;
+  if (metrics.smoothed_ms == 0)
+    metrics.smoothed_ms = render_ms;
+  else
+    metrics.smoothed_ms += (render_ms - metrics.smoothed_ms) * settings.smoothing;
+
+  if (idle_flag)
+  {
+    if (metrics.level != QualityLevel::Best) ++metrics.idle_restores;
+    metrics.level = QualityLevel::Best;
+    over_frames = under_frames = 0;
+    return;
+  }
+
+  bool over = metrics.smoothed_ms > settings.budget_ms * settings.degrade_above;
+  bool under = metrics.smoothed_ms < settings.budget_ms * settings.restore_below;
+  over_frames = over ? over_frames + 1 : 0;
+  under_frames = under ? under_frames + 1 : 0;
+
+  size_t level = (size_t)metrics.level;
+  if (over_frames >= settings.degrade_frames && level + 1 < QualityLevels)
+  {
+    metrics.level = (QualityLevel)(level + 1);
+    ++metrics.degrades;
+    over_frames = 0;
+    // The smoothed time reflects the old level; let the new one show its cost before deciding
+    // again
+    metrics.smoothed_ms = 0;
+  }
+  else if (under_frames >= settings.restore_frames && level > 0)
+  {
+    metrics.level = (QualityLevel)(level - 1);
+    ++metrics.restores;
+    under_frames = 0;
+    metrics.smoothed_ms = 0;
+  }
+}
+
+QualityMetrics CairoQualityGovernor::metrics() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return quality_metrics;
+}
+
+void CairoQualityGovernor::resetMetrics()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  QualityLevel level = quality_metrics.level;
+  quality_metrics = QualityMetrics();
+  quality_metrics.level = level;
+}
+}
@@ -2,34 +2,70 @@
 
 #include "vibrant/cairo/render.hpp"
 
+#include <chrono>
+
 #include "vibrant/renderable.hpp"
 #include "vibrant/body.hpp"
 
 namespace vibrant
 {
-using std::get;
+namespace
+{
+// cairo_set_source_rgba makes PDF and PostScript output use transparency groups, which viewers
+// and printers may rasterise, even when the alpha is 1
+void set_source_color(cairo_t* context, const Rgb& color)
+{
+  if (color.a >= 1)
+    cairo_set_source_rgb(context, color.r, color.g, color.b);
+  else
+    cairo_set_source_rgba(context, color.r, color.g, color.b, color.a);
+}
+
+bool visible(const Stroke& stroke) { return fabs(stroke.width) > 0.00001 && stroke.color.a > 0; }
+
+bool visible(const Fill& fill)
+{
+  if (fill.gradient.stops.empty()) return fill.color.a > 0;
+  for (auto& stop : fill.gradient.stops)
+    if (stop.color.a > 0) return true;
+  return false;
+}
+}
 
 class render_visitor : public boost::static_visitor<>
 {
  public:
-  render_visitor(cairo_t* context, Body::Handle body) : context(context), body(body) {}
+  render_visitor(cairo_t* context, const RenderCommand& command, CairoPathCache& paths,
+                 CairoTextCache& texts, CairoImageAtlas& images, CairoPatternCache& patterns,
+                 bool vector_output)
+      : context(context),
+        command(command),
+        body(command.body),
+        paths(paths),
+        texts(texts),
+        images(images),
+        patterns(patterns),
+        vector_output(vector_output)
+  {
+  }
 
   void operator()(Line line) const
   {
-    cairo_save(context);
+    if (!visible(line.stroke)) return;
 
-    cairo_translate(context, body->position.x, body->position.y);
-    cairo_rotate(context, body->rotation);
-    cairo_move_to(context, 0, 0);
+    cairo_save(context);
 
-    double line_length = std::max(body->size.x, body->size.y);
+    cairo_translate(context, body.position.x, body.position.y);
+    cairo_rotate(context, body.rotation);
 
-    cairo_line_to(context, line_length, 0);
+    double line_length = std::max(body.size.x, body.size.y);
+    paths.append(context, command.entity, {0, line_length, 0}, [line_length](cairo_t* local)
+                 {
+                   cairo_move_to(local, 0, 0);
+                   cairo_line_to(local, line_length, 0);
+                 });
 
-    Rgb color = line.stroke.color;
-    // TODO: Using rgba on PDF/Postfix/Print might degrade to bitmaps even if alpha is fully opaque.
-    //       Confirm if this is true or not.
-    cairo_set_source_rgba(context, color.r, color.g, color.b, color.a);
+    set_source_color(context, line.stroke.color);
     cairo_set_line_width(context, line.stroke.width);
     cairo_stroke(context);
 
@@ -38,28 +74,30 @@ class render_visitor : public boost::static_visitor<>
 
   void operator()(Rectangle rect) const
   {
+    bool fill = visible(rect.fill), stroke = visible(rect.stroke);
+    if (!fill && !stroke) return;
+
     cairo_save(context);
 
-    cairo_translate(context, body->position.x, body->position.y);
-    cairo_rotate(context, body->rotation);
-    cairo_rectangle(context, -body->size.x / 2, -body->size.y / 2, body->size.x, body->size.y);
+    cairo_translate(context, body.position.x, body.position.y);
+    cairo_rotate(context, body.rotation);
 
-    Rgb fill_color = rect.fill.color;
-    // TODO: Using rgba on PDF/Postfix/Print might degrade to bitmaps even if alpha is fully opaque.
-    //       Confirm if this is true or not.
-    cairo_set_source_rgba(context, fill_color.r, fill_color.g, fill_color.b, fill_color.a);
-    cairo_fill_preserve(context);
+    Vector2d size = body.size;
+    paths.append(context, command.entity, {1, size.x, size.y}, [size](cairo_t* local)
+                 {
+                   cairo_rectangle(local, -size.x / 2, -size.y / 2, size.x, size.y);
+                 });
 
-    if (fabs(rect.stroke.width) > 0.00001)
+    if (fill)
     {
-      cairo_set_line_width(context, rect.stroke.width);
-      Rgb stroke_color = rect.stroke.color;
-      // TODO: Using rgba on PDF/Postfix/Print might degrade to bitmaps even if alpha is fully
-      // opaque.
-      //       Confirm if this is true or not.
-      cairo_set_source_rgba(context, stroke_color.r, stroke_color.g, stroke_color.b,
-                            stroke_color.a);
+      setFill(rect.fill);
+      cairo_fill_preserve(context);
+    }
 
+    if (stroke)
+    {
+      cairo_set_line_width(context, rect.stroke.width);
+      set_source_color(context, rect.stroke.color);
       cairo_stroke(context);
     }
     else
@@ -70,33 +108,372 @@ class render_visitor : public boost::static_visitor<>
     cairo_restore(context);
   }
 
+  void operator()(const Text& text) const
+  {
+    bool fill = visible(text.fill), stroke = visible(text.stroke);
+    if (!fill && !stroke) return;
+
+    auto run = texts.shape(text.text, text.font);
+    if (run->glyphs.empty()) return;
+
+    cairo_save(context);
+
+    cairo_translate(context, body.position.x, body.position.y);
+    cairo_rotate(context, body.rotation);
+    setFill(text.fill);
+    // Center the run's logical extents on the body
+    cairo_translate(context, -run->advance / 2, (run->ascent - run->descent) / 2);
+    cairo_set_scaled_font(context, run->font);
+
+    if (stroke)
+    {
+      cairo_glyph_path(context, run->glyphs.data(), (int)run->glyphs.size());
+      if (fill) cairo_fill_preserve(context);
+
+      cairo_set_line_width(context, text.stroke.width);
+      set_source_color(context, text.stroke.color);
+      cairo_stroke(context);
+    }
+    else
+    {
+      cairo_show_glyphs(context, run->glyphs.data(), (int)run->glyphs.size());
+    }
+
+    cairo_restore(context);
+  }
+
+  void operator()(const Image& image) const
+  {
+    // Nothing is drawn until the image has been decoded and packed
+    const CairoImageAtlas::Slot* slot = images.lookup(image.path);
+    if (!slot || (image.opacity <= 0 && !visible(image.stroke))) return;
+
+    cairo_save(context);
+
+    cairo_translate(context, body.position.x, body.position.y);
+    cairo_rotate(context, body.rotation);
+
+    Vector2d size = body.size;
+    if (image.opacity > 0)
+    {
+      cairo_save(context);
+      cairo_translate(context, -size.x / 2, -size.y / 2);
+      cairo_scale(context, size.x / slot->width, size.y / slot->height);
+      if (vector_output)
+      {
+        // Embed just this image rather than the whole atlas page
+        cairo_surface_t* subsurface = cairo_surface_create_for_rectangle(
+            slot->page, slot->x, slot->y, slot->width, slot->height);
+        cairo_set_source_surface(context, subsurface, 0, 0);
+        cairo_surface_destroy(subsurface);
+      }
+      else
+      {
+        cairo_set_source_surface(context, slot->page, -slot->x, -slot->y);
+        // Keep the filter from sampling outside the slot at the edges
+        cairo_pattern_set_extend(cairo_get_source(context), CAIRO_EXTEND_PAD);
+      }
+      cairo_rectangle(context, 0, 0, slot->width, slot->height);
+      if (image.opacity >= 1)
+      {
+        cairo_fill(context);
+      }
+      else
+      {
+        cairo_clip(context);
+        cairo_paint_with_alpha(context, image.opacity);
+      }
+      cairo_restore(context);
+    }
+
+    if (visible(image.stroke))
+    {
+      cairo_rectangle(context, -size.x / 2, -size.y / 2, size.x, size.y);
+      cairo_set_line_width(context, image.stroke.width);
+      set_source_color(context, image.stroke.color);
+      cairo_stroke(context);
+    }
+
+    cairo_restore(context);
+  }
+
  private:
+  // Sets fill as the source, with the origin at the center of the body
+  void setFill(const Fill& fill) const
+  {
+    Vector2d size = body.size;
+    if (fill.gradient.stops.empty() || size.x == 0 || size.y == 0)
+    {
+      set_source_color(context, fill.color);
+      return;
+    }
+
+    // The source is locked to the transform it is set under, so mapping the shared unit box
+    // pattern onto the body needs no per-draw pattern matrix
+    cairo_matrix_t matrix;
+    cairo_get_matrix(context, &matrix);
+    cairo_translate(context, -size.x / 2, -size.y / 2);
+    cairo_scale(context, size.x, size.y);
+    cairo_set_source(context, patterns.get(fill.gradient));
+    cairo_set_matrix(context, &matrix);
+  }
+
   cairo_t* context;
-  Body::Handle body;
+  const RenderCommand& command;
+  const Body& body;
+  CairoPathCache& paths;
+  CairoTextCache& texts;
+  CairoImageAtlas& images;
+  CairoPatternCache& patterns;
+  bool vector_output;
+};
+
+bool drawn(PrimitiveVisibility visibility)
+{
+  return visibility == PrimitiveVisibility::Draw || visibility == PrimitiveVisibility::Pixel;
+}
+
+bool has_image(const CairoLayerCache::Members& members)
+{
+  for (const RenderCommand* member : members)
+    if (boost::get<Image>(&member->primitive)) return true;
+  return false;
+}
+
+// Decides how a primitive is drawn, if at all. Sizes are scaled to device pixels. With exact, only
+// primitives that draw nothing at any resolution are skipped.
+class visibility_visitor : public boost::static_visitor<PrimitiveVisibility>
+{
+ public:
+  visibility_visitor(const Body& body, double scale, const VisibilityPolicy& policy, bool exact)
+      : body(body), scale(scale), policy(policy), exact(exact)
+  {
+  }
+
+  PrimitiveVisibility operator()(const Line& line) const
+  {
+    if (!visible(line.stroke)) return PrimitiveVisibility::Transparent;
+    double length = std::max(body.size.x, body.size.y);
+    if (length <= 0) return PrimitiveVisibility::Empty;
+    return byExtent(length, fabs(line.stroke.width), false);
+  }
+
+  PrimitiveVisibility operator()(const Rectangle& rect) const
+  {
+    bool fill = visible(rect.fill), stroke = visible(rect.stroke);
+    if (!fill && !stroke) return PrimitiveVisibility::Transparent;
+    if (!stroke && (body.size.x <= 0 || body.size.y <= 0)) return PrimitiveVisibility::Empty;
+
+    double width = stroke ? fabs(rect.stroke.width) : 0;
+    // A gradient doesn't reduce to a single color
+    bool collapsible = !fill || rect.fill.gradient.stops.empty();
+    return byExtent(body.size.x + width, body.size.y + width, collapsible);
+  }
+
+  PrimitiveVisibility operator()(const Text& text) const
+  {
+    if (!visible(text.fill) && !visible(text.stroke)) return PrimitiveVisibility::Transparent;
+    if (text.text.empty() || text.font.size <= 0) return PrimitiveVisibility::Empty;
+    return byExtent(text.font.size, text.font.size, false);
+  }
+
+  PrimitiveVisibility operator()(const Image& image) const
+  {
+    if (!visible(image.opacity) && !visible(image.stroke)) return PrimitiveVisibility::Transparent;
+    if (body.size.x <= 0 || body.size.y <= 0) return PrimitiveVisibility::Empty;
+    return byExtent(body.size.x, body.size.y, false);
+  }
+
+ private:
+  bool visible(double alpha) const { return exact ? alpha > 0 : alpha >= policy.min_alpha; }
+  bool visible(const Stroke& stroke) const
+  {
+    return fabs(stroke.width) > 0.00001 && visible(stroke.color.a);
+  }
+  bool visible(const Fill& fill) const
+  {
+    if (fill.gradient.stops.empty()) return visible(fill.color.a);
+    for (auto& stop : fill.gradient.stops)
+      if (visible(stop.color.a)) return true;
+    return false;
+  }
+
+  PrimitiveVisibility byExtent(double width, double height, bool collapsible) const
+  {
+    if (exact) return PrimitiveVisibility::Draw;
+
+    double largest = std::max(width, height) * scale;
+    if (largest < policy.min_extent) return PrimitiveVisibility::Subpixel;
+    if (collapsible && largest <= policy.pixel_extent) return PrimitiveVisibility::Pixel;
+    return PrimitiveVisibility::Draw;
+  }
+
+  const Body& body;
+  double scale;
+  const VisibilityPolicy& policy;
+  bool exact;
 };
 
+// Writes a rectangle too small to see the shape of as the one pixel under its center
+void draw_pixel(cairo_t* context, const Body& body, const Rectangle& rect)
+{
+  // Whichever of the fill and stroke is more opaque
+  bool stroke = fabs(rect.stroke.width) > 0.00001 && rect.stroke.color.a > rect.fill.color.a;
+  Rgb color = stroke ? rect.stroke.color : rect.fill.color;
+  double width = stroke ? fabs(rect.stroke.width) : 0;
+
+  double x = body.position.x, y = body.position.y;
+  cairo_user_to_device(context, &x, &y);
+
+  // Coverage of the pixel stands in for antialiasing. The CTM scales areas by its determinant
+  // however it rotates or skews them.
+  cairo_matrix_t matrix;
+  cairo_get_matrix(context, &matrix);
+  double area = (body.size.x + width) * (body.size.y + width);
+  color.a *= std::min(1.0, fabs(area * (matrix.xx * matrix.yy - matrix.xy * matrix.yx)));
+
+  cairo_save(context);
+  cairo_identity_matrix(context);
+  cairo_rectangle(context, floor(x), floor(y), 1, 1);
+  set_source_color(context, color);
+  cairo_fill(context);
+  cairo_restore(context);
+}
+
 void CairoRenderSystem::update(entityx::EntityManager& es, entityx::EventManager& events,
                                entityx::TimeDelta dt)
+{
+  command_buffer.record(es, record_threads, interpolation);
+  execute(command_buffer);
+}
+
+void CairoRenderSystem::execute(const RenderCommandBuffer& buffer)
 {
   assert(context);
   cairo_save(context);
 
-  Body::Handle body;
-  Renderable::Handle renderable;
+  bool governed = quality_governor.enabled();
+  auto start = std::chrono::steady_clock::now();
+  VisibilityPolicy policy = visibility_policy;
+  if (governed)
+  {
+    QualitySettings quality = quality_governor.current();
+    cairo_set_antialias(context, quality.antialias);
+    cairo_set_tolerance(context, quality.tolerance);
+    policy = quality.visibility;
+  }
 
-  m_orderedEntities.clear();
-  m_orderedEntities.reserve(es.capacity());
+  classify(buffer, policy);
 
-  for (entityx::Entity entity : es.entities_with_components(body, renderable))
-    m_orderedEntities.push_back(std::make_tuple(renderable, body));
+  if (vector_output)
+  {
+    // Vector output is final; decode every image up front instead of leaving it out
+    for (auto& command : buffer)
+      if (auto image = boost::get<Image>(&command.primitive)) image_atlas.lookup(image->path);
+    image_atlas.waitForDecodes();
+  }
 
-  stable_sort(m_orderedEntities.begin(), m_orderedEntities.end(), [](EntityPack e1, EntityPack e2)
-              {
-                return get<0>(e1)->z < get<0>(e2)->z;
-              });
-  for (auto ep : m_orderedEntities)
-    boost::apply_visitor(render_visitor(context, get<1>(ep)), get<0>(ep)->primitive);
+  for (auto& layer : m_layers) layer.second.clear();
+  for (size_t i = 0; i < buffer.size(); ++i)
+    if (buffer[i].layer != NoLayer && drawn(m_visibility[i]))
+      m_layers[buffer[i].layer].push_back(&buffer[i]);
+
+  // Cached layers drawn while an image was still decoding are missing it
+  bool images_ready = image_atlas.beginFrame();
+  for (auto& layer : m_layers)
+    if (layer.second.empty() || (images_ready && has_image(layer.second)))
+      layer_cache.evict(layer.first);
+
+  // The buffer is in z order; a layer is drawn in place of its lowest member
+  for (size_t i = 0; i < buffer.size(); ++i)
+  {
+    const RenderCommand& command = buffer[i];
+    if (!drawn(m_visibility[i])) continue;
+
+    // Layer surfaces are rasters, so vector output draws layer members in place
+    if (command.layer == NoLayer || vector_output)
+    {
+      draw(context, command, m_visibility[i]);
+      continue;
+    }
+
+    auto& members = m_layers[command.layer];
+    if (members.front() != &command) continue;
+
+    const RenderCommand* first = &buffer[0];
+    layer_cache.draw(context, command.layer, members, [this, &members, first](cairo_t* target)
+                     {
+                       cairo_set_antialias(target, cairo_get_antialias(context));
+                       cairo_set_tolerance(target, cairo_get_tolerance(context));
+                       for (const RenderCommand* member : members)
+                         draw(target, *member, m_visibility[member - first]);
+                     });
+  }
+
+  path_cache.prune();
+  pattern_cache.prune();
+  image_atlas.endFrame();
 
   cairo_restore(context);
+
+  if (governed)
+  {
+    // Only drawing is measured; presenting the target is outside the governor's control
+    quality_governor.frame(std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start).count());
+  }
+}
+
+void CairoRenderSystem::classify(const RenderCommandBuffer& buffer, const VisibilityPolicy& policy)
+{
+  // Bodies are in user space; a uniform scale is close enough for a size threshold
+  cairo_matrix_t matrix;
+  cairo_get_matrix(context, &matrix);
+  double scale = sqrt(fabs(matrix.xx * matrix.yy - matrix.xy * matrix.yx));
+
+  frame_stats = RenderStats();
+  m_visibility.resize(buffer.size());
+  for (size_t i = 0; i < buffer.size(); ++i)
+  {
+    const RenderCommand& command = buffer[i];
+    PrimitiveVisibility visibility = boost::apply_visitor(
+        visibility_visitor(command.body, scale, policy, vector_output),
+        command.primitive);
+    m_visibility[i] = visibility;
+
+    switch (visibility)
+    {
+      case PrimitiveVisibility::Draw:
+        ++frame_stats.drawn;
+        break;
+      case PrimitiveVisibility::Pixel:
+        ++frame_stats.pixels;
+        break;
+      case PrimitiveVisibility::Transparent:
+        ++frame_stats.transparent;
+        break;
+      case PrimitiveVisibility::Empty:
+        ++frame_stats.empty;
+        break;
+      case PrimitiveVisibility::Subpixel:
+        ++frame_stats.subpixel;
+        break;
+    }
+  }
+}
+
+void CairoRenderSystem::draw(cairo_t* target, const RenderCommand& command,
+                             PrimitiveVisibility visibility)
+{
+  if (visibility == PrimitiveVisibility::Pixel)
+  {
+    draw_pixel(target, command.body, boost::get<Rectangle>(command.primitive));
+    return;
+  }
+
+  boost::apply_visitor(
+      render_visitor(target, command, path_cache, text_cache, image_atlas, pattern_cache,
+                     vector_output),
+      command.primitive);
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/text_cache.hpp"
+
+#include <sstream>
+
+namespace vibrant
+{
+namespace
+{
+// Nominal; cairo's glyph caches per scaled font don't report their size
+const size_t font_bytes = 4096;
+
+std::string font_key(const Font& font)
+{
+  std::ostringstream key;
+  key << font.family << '\0' << font.size << '\0' << font.bold << font.italic;
+  return key.str();
+}
+
+void destroy_run(GlyphRun* run)
+{
+  cairo_scaled_font_destroy(run->font);
+  delete run;
+}
+}
+
+CairoTextCache::~CairoTextCache() { clear(); }
+
+std::shared_ptr<const GlyphRun> CairoTextCache::shape(const std::string& text, const Font& font)
+{
+  std::string font_name = font_key(font);
+  std::string key = font_name + '\0' + text;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto found = runs.find(key);
+  if (found != runs.end())
+  {
+    ++cache_stats.hits;
+    lru.splice(lru.begin(), lru, found->second.lru);
+    return found->second.run;
+  }
+
+  ++cache_stats.misses;
+
+  std::shared_ptr<GlyphRun> run(new GlyphRun(), &destroy_run);
+  FontEntry& font_entry = scaledFont(font_name, font);
+  ++font_entry.runs;
+  run->font = cairo_scaled_font_reference(font_entry.font);
+
+  cairo_glyph_t* glyphs = nullptr;
+  int glyph_count = 0;
+  if (cairo_scaled_font_text_to_glyphs(run->font, 0, 0, text.c_str(), (int)text.size(), &glyphs,
+                                       &glyph_count, nullptr, nullptr,
+                                       nullptr) == CAIRO_STATUS_SUCCESS)
+  {
+    run->glyphs.assign(glyphs, glyphs + glyph_count);
+    cairo_glyph_free(glyphs);
+  }
+
+  cairo_text_extents_t text_extents;
+  cairo_scaled_font_glyph_extents(run->font, run->glyphs.data(), (int)run->glyphs.size(),
+                                  &text_extents);
+  cairo_font_extents_t font_extents;
+  cairo_scaled_font_extents(run->font, &font_extents);
+  run->advance = text_extents.x_advance;
+  run->ascent = font_extents.ascent;
+  run->descent = font_extents.descent;
+
+  size_t bytes = sizeof(GlyphRun) + run->glyphs.size() * sizeof(cairo_glyph_t) + 2 * key.size();
+
+  lru.push_front(key);
+  runs.emplace(key, Entry{run, lru.begin(), bytes, font_name});
+  memory_usage += bytes;
+  evictToFit();
+
+  return run;
+}
+
+void CairoTextCache::setMemoryLimit(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  memory_limit = bytes;
+  evictToFit();
+}
+
+size_t CairoTextCache::memoryLimit() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return memory_limit;
+}
+
+size_t CairoTextCache::memoryUsage() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return memory_usage;
+}
+
+size_t CairoTextCache::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return runs.size();
+}
+
+size_t CairoTextCache::fontCount() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return fonts.size();
+}
+
+TextCacheStats CairoTextCache::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return cache_stats;
+}
+
+double CairoTextCache::hitRate() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t lookups = cache_stats.hits + cache_stats.misses;
+  return lookups ? cache_stats.hits / (double)lookups : 0;
+}
+
+void CairoTextCache::resetStats()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  cache_stats = TextCacheStats();
+}
+
+void CairoTextCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  runs.clear();
+  lru.clear();
+  for (auto& font : fonts) cairo_scaled_font_destroy(font.second.font);
+  fonts.clear();
+  memory_usage = 0;
+}
+
+CairoTextCache::FontEntry& CairoTextCache::scaledFont(const std::string& key, const Font& font)
+{
+  auto found = fonts.find(key);
+  if (found != fonts.end()) return found->second;
+
+  cairo_font_face_t* face = cairo_toy_font_face_create(
+      font.family.c_str(), font.italic ? CAIRO_FONT_SLANT_ITALIC : CAIRO_FONT_SLANT_NORMAL,
+      font.bold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_matrix_t font_matrix, ctm;
+  cairo_matrix_init_scale(&font_matrix, font.size, font.size);
+  cairo_matrix_init_identity(&ctm);
+  cairo_font_options_t* options = cairo_font_options_create();
+
+  cairo_scaled_font_t* scaled_font = cairo_scaled_font_create(face, &font_matrix, &ctm, options);
+
+  cairo_font_options_destroy(options);
+  cairo_font_face_destroy(face);
+
+  memory_usage += font_bytes;
+  return fonts.emplace(key, FontEntry{scaled_font, 0}).first->second;
+}
+
+void CairoTextCache::release(const std::string& font)
+{
+  // Runs handed out keep their own reference
+  auto found = fonts.find(font);
+  if (--found->second.runs) return;
+
+  cairo_scaled_font_destroy(found->second.font);
+  fonts.erase(found);
+  memory_usage -= font_bytes;
+}
+
+void CairoTextCache::evictToFit()
+{
+  while (memory_usage > memory_limit && !lru.empty())
+  {
+    auto found = runs.find(lru.back());
+    memory_usage -= found->second.bytes;
+    release(found->second.font);
+    runs.erase(found);
+    lru.pop_back();
+    ++cache_stats.evictions;
+  }
+}
+}
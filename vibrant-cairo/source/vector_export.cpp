@@ -0,0 +1,73 @@
+#include "pch.hpp"
+
+#include <cstdio>
+#include <vector>
+
+#include "vibrant/cairo/vector_export.hpp"
+
+#include "cairo/cairo-pdf.h"
+#include "cairo/cairo-svg.h"
+
+namespace vibrant
+{
+CairoVectorExport::CairoVectorExport(VectorFormat format, std::string path, Vector2d size)
+    : format(format), path(path), size(size)
+{
+  render_system.setVectorOutput(true);
+
+  if (format == VectorFormat::Pdf)
+  {
+    document = cairo_pdf_surface_create(path.c_str(), size.x, size.y);
+    check(cairo_surface_status(document));
+  }
+}
+
+CairoVectorExport::~CairoVectorExport() { finish(); }
+
+void CairoVectorExport::frame(const RenderCommandBuffer& buffer)
+{
+  if (error != CAIRO_STATUS_SUCCESS || (format == VectorFormat::Pdf && !document)) return;
+
+  cairo_surface_t* target = document;
+  if (format == VectorFormat::Svg)
+  {
+    std::vector<char> file(path.size() + 32);
+    snprintf(file.data(), file.size(), path.c_str(), (int)frame_count);
+    target = cairo_svg_surface_create(file.data(), size.x, size.y);
+  }
+
+  cairo_t* context = cairo_create(target);
+  render_system.setContext(context);
+  render_system.execute(buffer);
+  render_system.setContext(nullptr);
+
+  // Pages and SVG documents are written to disk here rather than kept until finish()
+  if (format == VectorFormat::Pdf) cairo_show_page(context);
+  check(cairo_status(context));
+  cairo_destroy(context);
+
+  if (format == VectorFormat::Svg)
+  {
+    cairo_surface_finish(target);
+    check(cairo_surface_status(target));
+    cairo_surface_destroy(target);
+  }
+
+  ++frame_count;
+}
+
+void CairoVectorExport::finish()
+{
+  if (!document) return;
+
+  cairo_surface_finish(document);
+  check(cairo_surface_status(document));
+  cairo_surface_destroy(document);
+  document = nullptr;
+}
+
+void CairoVectorExport::check(cairo_status_t status)
+{
+  if (error == CAIRO_STATUS_SUCCESS) error = status;
+}
+}
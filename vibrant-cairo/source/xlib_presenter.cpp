@@ -0,0 +1,217 @@
+#include "pch.hpp"
+
+#include "vibrant/cairo/xlib_presenter.hpp"
+
+#if defined(CAIRO_HAS_XLIB_SURFACE)
+
+#include <algorithm>
+#include <chrono>
+
+#include "cairo/cairo-xlib.h"
+#include "vibrant/cairo/damage.hpp"
+
+#if defined(VIBRANT_HAS_XSHM)
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xutil.h>
+#endif
+
+namespace vibrant
+{
+namespace
+{
+#if defined(VIBRANT_HAS_XSHM)
+// XShmAttach fails asynchronously, e.g. on a remote server that can't see our memory
+bool attach_failed = false;
+
+int on_attach_error(Display* display, XErrorEvent* error)
+{
+  attach_failed = true;
+  return 0;
+}
+
+int native_byte_order()
+{
+  const int one = 1;
+  return *(const char*)&one ? LSBFirst : MSBFirst;
+}
+#endif
+}
+
+CairoXlibPresenter::CairoXlibPresenter(Display* display, Window window)
+    : display(display), window(window)
+{
+  XWindowAttributes attributes;
+  XGetWindowAttributes(display, window, &attributes);
+  visual = attributes.visual;
+  depth = attributes.depth;
+  gc = XCreateGC(display, window, 0, nullptr);
+
+#if defined(VIBRANT_HAS_XSHM)
+  // Cairo draws RGB24 as native endian 32 bit xRGB, which the image has to match
+  shm_supported = XShmQueryExtension(display) && depth == 24 && visual->red_mask == 0xff0000 &&
+                  visual->green_mask == 0xff00 && visual->blue_mask == 0xff;
+#endif
+}
+
+CairoXlibPresenter::~CairoXlibPresenter()
+{
+  destroy();
+  XFreeGC(display, gc);
+}
+
+cairo_surface_t* CairoXlibPresenter::backbuffer(Vector2u requested)
+{
+  if (surface && requested.x <= size.x && requested.y <= size.y) return surface;
+
+  destroy();
+  size = Vector2u(std::max(size.x, requested.x), std::max(size.y, requested.y));
+
+#if defined(VIBRANT_HAS_XSHM)
+  if (shm_supported && createShared()) return surface;
+  // Don't retry on every resize once the server refused
+  shm_supported = false;
+#endif
+
+  surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, size.x, size.y);
+  window_surface = cairo_xlib_surface_create(display, window, visual, size.x, size.y);
+  return surface;
+}
+
+void CairoXlibPresenter::present(const cairo_region_t* damage)
+{
+  if (!surface) return;
+
+  auto start = std::chrono::steady_clock::now();
+  cairo_surface_flush(surface);
+
+  cairo_rectangle_int_t whole = {0, 0, (int)size.x, (int)size.y};
+  int count = damage ? cairo_region_num_rectangles(damage) : 1;
+
+#if defined(VIBRANT_HAS_XSHM)
+  if (shm_image)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      cairo_rectangle_int_t rectangle = whole;
+      if (damage) cairo_region_get_rectangle(damage, i, &rectangle);
+      XShmPutImage(display, window, gc, shm_image, rectangle.x, rectangle.y, rectangle.x,
+                   rectangle.y, rectangle.width, rectangle.height, False);
+      present_stats.pixels += (size_t)rectangle.width * rectangle.height;
+    }
+    // The server reads the segment asynchronously, and the next frame draws into it
+    XSync(display, False);
+  }
+  else
+#endif
+  {
+    cairo_t* context = cairo_create(window_surface);
+    clip_to_region(context, damage);
+    cairo_set_source_surface(context, surface, 0, 0);
+    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(context);
+    cairo_destroy(context);
+    cairo_surface_flush(window_surface);
+    XFlush(display);
+
+    for (int i = 0; i < count; ++i)
+    {
+      cairo_rectangle_int_t rectangle = whole;
+      if (damage) cairo_region_get_rectangle(damage, i, &rectangle);
+      present_stats.pixels += (size_t)rectangle.width * rectangle.height;
+    }
+  }
+
+  present_stats.last_ms =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  present_stats.total_ms += present_stats.last_ms;
+  present_stats.rectangles += count;
+  ++present_stats.presents;
+}
+
+bool CairoXlibPresenter::sharedMemory() const
+{
+#if defined(VIBRANT_HAS_XSHM)
+  return shm_image != nullptr;
+#else
+  return false;
+#endif
+}
+
+bool CairoXlibPresenter::createShared()
+{
+#if defined(VIBRANT_HAS_XSHM)
+  XImage* image =
+      XShmCreateImage(display, visual, depth, ZPixmap, nullptr, &shm_info, size.x, size.y);
+  if (!image) return false;
+  if (image->bits_per_pixel != 32 || image->byte_order != native_byte_order())
+  {
+    XDestroyImage(image);
+    return false;
+  }
+
+  shm_info.shmid = shmget(IPC_PRIVATE, (size_t)image->bytes_per_line * image->height,
+                          IPC_CREAT | 0600);
+  if (shm_info.shmid < 0)
+  {
+    XDestroyImage(image);
+    return false;
+  }
+  shm_info.shmaddr = (char*)shmat(shm_info.shmid, nullptr, 0);
+  if (shm_info.shmaddr == (char*)-1)
+  {
+    shmctl(shm_info.shmid, IPC_RMID, nullptr);
+    XDestroyImage(image);
+    return false;
+  }
+  image->data = shm_info.shmaddr;
+  shm_info.readOnly = False;
+
+  attach_failed = false;
+  XErrorHandler previous_handler = XSetErrorHandler(on_attach_error);
+  bool attached = XShmAttach(display, &shm_info);
+  XSync(display, False);
+  XSetErrorHandler(previous_handler);
+
+  // Removed once both sides detach, so it doesn't outlive a crash
+  shmctl(shm_info.shmid, IPC_RMID, nullptr);
+
+  if (!attached || attach_failed)
+  {
+    shmdt(shm_info.shmaddr);
+    image->data = nullptr;
+    XDestroyImage(image);
+    return false;
+  }
+
+  shm_image = image;
+  surface = cairo_image_surface_create_for_data((unsigned char*)image->data, CAIRO_FORMAT_RGB24,
+                                                size.x, size.y, image->bytes_per_line);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void CairoXlibPresenter::destroy()
+{
+  if (surface) cairo_surface_destroy(surface);
+  surface = nullptr;
+  if (window_surface) cairo_surface_destroy(window_surface);
+  window_surface = nullptr;
+
+#if defined(VIBRANT_HAS_XSHM)
+  if (!shm_image) return;
+
+  XShmDetach(display, &shm_info);
+  XSync(display, False);
+  shmdt(shm_info.shmaddr);
+  // XDestroyImage would free() the shared memory
+  shm_image->data = nullptr;
+  XDestroyImage(shm_image);
+  shm_image = nullptr;
+#endif
+}
+}
+
+#endif  // CAIRO_HAS_XLIB_SURFACE
@@ -32,6 +32,9 @@ Rgb operator+(double lhs, Rgb rhs);
 
 Rgb operator-(const Rgb& rhs);
 
+bool operator==(const Rgb& lhs, const Rgb& rhs);
+bool operator!=(const Rgb& lhs, const Rgb& rhs);
+
 struct Hsl
 {
   Hsl(double h, double s, double l, double a = 1.0) : h(h), s(s), l(l), a(a) {}
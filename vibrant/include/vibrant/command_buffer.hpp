@@ -0,0 +1,104 @@
+#pragma once
+#ifndef VIBRANT_COMMAND_BUFFER_HPP
+
+#include <memory>
+#include <vector>
+
+#include "entityx/entityx.h"
+
+#include "vibrant/body.hpp"
+#include "vibrant/renderable.hpp"
+#include "vibrant/layer.hpp"
+
+namespace vibrant
+{
+// Everything a backend needs to draw one entity, copied out of the ECS
+struct RenderCommand
+{
+  RenderCommand()
+      : body(Vector2d(), Vector2d()), primitive(Line({0, Rgb()})), z(0), layer(NoLayer)
+  {
+  }
+
+  RenderCommand(entityx::Entity::Id entity, const Body& body, const Renderable& renderable,
+                LayerId layer)
+      : entity(entity), body(body), primitive(renderable.primitive), z(renderable.z), layer(layer)
+  {
+  }
+
+  entityx::Entity::Id entity;
+  Body body;
+  RenderPrimitive primitive;
+  double z;
+  LayerId layer;
+};
+
+bool operator==(const RenderCommand& lhs, const RenderCommand& rhs);
+inline bool operator!=(const RenderCommand& lhs, const RenderCommand& rhs) { return !(lhs == rhs); }
+
+// A flat, z-ordered snapshot of the renderable entities of one frame.
+//
+// Recording only copies component values, so once record() returns the buffer no longer
+// references the ECS and can be executed by a backend while the next frame is simulated, replayed
+// any number of times, or compared against another frame. record() copies over the commands
+// already in the buffer, reusing the storage of their strings and gradient stops, so a buffer
+// reused across frames of a scene whose entities stay the same stops allocating, unless their z
+// order changes.
+class RenderCommandBuffer
+{
+ public:
+  typedef std::vector<RenderCommand>::const_iterator const_iterator;
+
+  RenderCommandBuffer();
+  // Copies the commands only
+  RenderCommandBuffer(const RenderCommandBuffer& other);
+  RenderCommandBuffer(RenderCommandBuffer&& other);
+  ~RenderCommandBuffer();
+
+  RenderCommandBuffer& operator=(const RenderCommandBuffer& other);
+  RenderCommandBuffer& operator=(RenderCommandBuffer&& other);
+
+  // Replaces the contents with every entity that has a Body and a Renderable. With threads > 1
+  // the component copies of large frames are split across that many threads, which the buffer
+  // starts the first time and keeps for later frames. With alpha < 1 bodies are interpolated from
+  // their PreviousBody, see FixedTimestep.
+  void record(entityx::EntityManager& es, unsigned int threads = 1, double alpha = 1);
+
+  void clear() { commands.clear(); }
+  void swap(RenderCommandBuffer& other) { commands.swap(other.commands); }
+  void push_back(const RenderCommand& command) { commands.push_back(command); }
+  // Merges buffers recorded separately, e.g. per thread or per layer. Call sort() afterwards.
+  void append(const RenderCommandBuffer& other);
+  // Stable sort by z; does nothing if already sorted
+  void sort();
+
+  template <typename Executor>
+  void replay(Executor& executor) const
+  {
+    for (auto& command : commands) executor(command);
+  }
+
+  // Entities whose command was added, removed or changed since previous
+  void diff(const RenderCommandBuffer& previous, std::vector<entityx::Entity::Id>& changed) const;
+
+  const_iterator begin() const { return commands.begin(); }
+  const_iterator end() const { return commands.end(); }
+  const RenderCommand& operator[](size_t index) const { return commands[index]; }
+  size_t size() const { return commands.size(); }
+  bool empty() const { return commands.empty(); }
+  size_t capacity() const { return commands.capacity(); }
+
+  bool operator==(const RenderCommandBuffer& other) const { return commands == other.commands; }
+  bool operator!=(const RenderCommandBuffer& other) const { return commands != other.commands; }
+
+ private:
+  typedef std::tuple<entityx::Entity, Body::Handle, Renderable::Handle> Source;
+  class Workers;
+
+  std::vector<RenderCommand> commands;
+  std::vector<Source> sources;
+  std::unique_ptr<Workers> workers;
+};
+}
+
+#endif  // VIBRANT_COMMAND_BUFFER_HPP
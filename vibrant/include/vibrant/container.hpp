@@ -0,0 +1,157 @@
+#pragma once
+#ifndef VIBRANT_CONTAINER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "entityx/entityx.h"
+#include "rhea/constraint.hpp"
+#include "rhea/variable.hpp"
+
+#include "vibrant/vector.hpp"
+
+namespace vibrant
+{
+class LayoutSystem;
+
+enum class Arrangement
+{
+  Stack,  // children in a row or column at their preferred size
+  Flex,   // a stack whose children grow into the leftover space by their grow factor
+  Grid    // equal cells, columns per row, filled row by row
+};
+
+enum class Axis
+{
+  Horizontal,
+  Vertical
+};
+
+// Where a child sits across the container's axis, or inside its grid cell
+enum class Alignment
+{
+  Start,
+  Center,
+  End,
+  Stretch
+};
+
+// How big an entity would like to be inside a Container. Without one, an entity measured into an
+// IntrinsicSize uses that, and anything else has no preferred size.
+struct Sizing : entityx::Component<Sizing>
+{
+  Sizing(Vector2d preferred, double grow = 0) : preferred(preferred), grow(grow) {}
+
+  Vector2d preferred;
+  double grow;  // share of a Flex container's leftover space
+};
+
+// Lays out its children, in order, inside its own Body. A child can be a Container itself.
+struct Container : entityx::Component<Container>
+{
+  Container(Arrangement arrangement, Axis axis = Axis::Vertical, double spacing = 0,
+            double padding = 0)
+      : arrangement(arrangement), axis(axis), spacing(spacing), padding(padding)
+  {
+  }
+
+  void add(entityx::Entity child)
+  {
+    children.push_back(child.id());
+    invalidate();
+  }
+
+  void clear()
+  {
+    children.clear();
+    invalidate();
+  }
+
+  // Call after editing anything but the children through add() and clear(), or after changing a
+  // child's Sizing
+  void invalidate()
+  {
+    if (structure_changed) *structure_changed = true;
+  }
+
+  Arrangement arrangement;
+  Axis axis;
+  double spacing;
+  double padding;
+  Alignment alignment = Alignment::Stretch;
+  unsigned int columns = 1;  // Grid only
+  std::vector<entityx::Entity::Id> children;
+
+  // Maintained by ContainerLayout
+  std::shared_ptr<bool> structure_changed;
+  Vector2d measured;
+  Vector2d arranged_position;
+  Vector2d arranged_size;
+  rhea::constraint_list constraints;
+  rhea::variable cell_width;
+  rhea::variable cell_height;
+};
+
+struct ContainerStats
+{
+  size_t direct = 0;       // containers in trees the linear pass arranges
+  size_t constrained = 0;  // containers left to the solver
+  size_t placed = 0;       // bodies the linear pass moved or resized in the last update
+};
+
+// Arranges Container trees for LayoutSystem.
+//
+// Nearly every container tree is simple containment: each entity has one parent, and only the
+// root may be positioned by constraints. Such a tree is laid out by a measure pass up the tree and
+// an arrange pass down it, linear in its size and without the solver. It's only redone when a
+// container changed or the root's Body moved, e.g. because the solver moved its root.
+//
+// A child shared by two containers, containers nested in a cycle, or a child that's also placed
+// by constraints of its own can't be arranged like that. The containers of such a tree instead
+// generate the equivalent constraints, and the solver settles the conflicts by strength.
+class ContainerLayout
+{
+ public:
+  void track(entityx::Entity::Id container, Container& component);
+  void untrack(entityx::Entity::Id container, const Container& component, LayoutSystem& layout);
+  // For entities destroyed while being some container's child
+  void invalidate() { *structure_changed = true; }
+
+  // Regroups containers into trees if any changed, which costs nothing otherwise. Call before the
+  // solver's changes are copied, so constraints generated here are solved in the same update.
+  void restructure(entityx::EntityManager& es, LayoutSystem& layout);
+  // The linear pass, over trees that changed or whose root moved. Appends the entities placed.
+  void arrange(entityx::EntityManager& es, std::vector<entityx::Entity::Id>& changed);
+
+  const ContainerStats& stats() const { return container_stats; }
+
+ private:
+  Vector2d measure(entityx::EntityManager& es, entityx::Entity entity);
+  Vector2d preferred(entityx::Entity entity) const;
+  void arrange(entityx::EntityManager& es, entityx::Entity entity, const Container& container,
+               std::vector<entityx::Entity::Id>& changed);
+  void place(entityx::Entity entity, double left, double top, double width, double height,
+             std::vector<entityx::Entity::Id>& changed);
+  // Collects the containers under root, returning false unless it's a tree of simple containment
+  bool walk(entityx::EntityManager& es, entityx::Entity::Id root,
+            const std::unordered_map<uint64_t, unsigned int>& parents,
+            std::unordered_set<uint64_t>& visited, std::vector<entityx::Entity::Id>& members);
+  void constrain(entityx::EntityManager& es, entityx::Entity entity, Container& container,
+                 LayoutSystem& layout);
+
+  std::vector<entityx::Entity::Id> containers;
+  // Of the trees the linear pass arranges
+  std::vector<entityx::Entity::Id> roots;
+  // Layouts assigned for generated constraints, as opposed to the user's own
+  std::unordered_set<uint64_t> owned_layouts;
+  // Shared with every tracked Container, which sets it when edited
+  std::shared_ptr<bool> structure_changed = std::make_shared<bool>(false);
+  bool arrange_all = false;
+  ContainerStats container_stats;
+};
+}
+
+#endif  // VIBRANT_CONTAINER_HPP
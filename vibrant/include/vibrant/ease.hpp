@@ -496,6 +496,8 @@ void stroke_width_to(entityx::Entity entity, double new_width, double time, Ease
 void stroke_color_to(entityx::Entity entity, Rgb new_color, double time, Ease ease,
                      double delay = 0);
 void fill_color_to(entityx::Entity entity, Rgb new_color, double time, Ease ease, double delay = 0);
+void fill_gradient_to(entityx::Entity entity, GradientStops new_stops, double time, Ease ease,
+                      double delay = 0);
 // would be neat but very sophisticated
 // void reshape(entityx::Entity entity, RenderPrimitive new_primitive, double time, Ease ease)
 
@@ -604,6 +606,8 @@ class stroke_width_visitor : public boost::static_visitor<double&>
  public:
   double& operator()(Line& line) const { return line.stroke.width; }
   double& operator()(Rectangle& rect) const { return rect.stroke.width; }
+  double& operator()(Text& text) const { return text.stroke.width; }
+  double& operator()(Image& image) const { return image.stroke.width; }
 };
 
 class stroke_color_visitor : public boost::static_visitor<Rgb&>
@@ -611,6 +615,8 @@ class stroke_color_visitor : public boost::static_visitor<Rgb&>
  public:
   Rgb& operator()(Line& line) const { return line.stroke.color; }
   Rgb& operator()(Rectangle& rect) const { return rect.stroke.color; }
+  Rgb& operator()(Text& text) const { return text.stroke.color; }
+  Rgb& operator()(Image& image) const { return image.stroke.color; }
 };
 
 class set_fill_color_visitor : public boost::static_visitor<>
@@ -619,6 +625,8 @@ class set_fill_color_visitor : public boost::static_visitor<>
   set_fill_color_visitor(Rgb new_color) : new_color(new_color) {}
   void operator()(Line& line) const {}
   void operator()(Rectangle& rect) const { rect.fill.color = new_color; }
+  void operator()(Text& text) const { text.fill.color = new_color; }
+  void operator()(Image& image) const {}
 
   Rgb new_color;
 };
@@ -628,6 +636,29 @@ class get_fill_color_visitor : public boost::static_visitor<Rgb>
  public:
   Rgb operator()(Line& line) const { return Rgb(0, 0, 0); }
   Rgb operator()(Rectangle& rect) const { return rect.fill.color; }
+  Rgb operator()(Text& text) const { return text.fill.color; }
+  Rgb operator()(Image& image) const { return Rgb(0, 0, 0); }
+};
+
+class set_fill_gradient_visitor : public boost::static_visitor<>
+{
+ public:
+  set_fill_gradient_visitor(const GradientStops& new_stops) : new_stops(new_stops) {}
+  void operator()(Line& line) const {}
+  void operator()(Rectangle& rect) const { rect.fill.gradient.stops = new_stops; }
+  void operator()(Text& text) const { text.fill.gradient.stops = new_stops; }
+  void operator()(Image& image) const {}
+
+  const GradientStops& new_stops;
+};
+
+class get_fill_gradient_visitor : public boost::static_visitor<GradientStops>
+{
+ public:
+  GradientStops operator()(Line& line) const { return GradientStops(); }
+  GradientStops operator()(Rectangle& rect) const { return rect.fill.gradient.stops; }
+  GradientStops operator()(Text& text) const { return text.fill.gradient.stops; }
+  GradientStops operator()(Image& image) const { return GradientStops(); }
 };
 
 template <>
@@ -702,12 +733,37 @@ struct Easings<Renderable> : entityx::Component<Easings<Renderable>>
       }
     }
 
-    return stroke_width_easing.active || stroke_color_easing.active || fill_color_easing.active;
+    // Fill Gradient
+    if (fill_gradient_easing.active)
+    {
+      fill_gradient_easing.current += delta;
+      if (fill_gradient_easing.current < 0)
+      {
+      }  // in delay
+      else if (fill_gradient_easing.current < fill_gradient_easing.total_time)
+      {
+        auto new_stops = fill_gradient_easing.easing_function(
+            fill_gradient_easing.current, fill_gradient_easing.beginning,
+            fill_gradient_easing.change, fill_gradient_easing.total_time);
+        boost::apply_visitor(set_fill_gradient_visitor(new_stops), renderable->primitive);
+      }
+      else
+      {
+        boost::apply_visitor(
+            set_fill_gradient_visitor(fill_gradient_easing.beginning + fill_gradient_easing.change),
+            renderable->primitive);
+        fill_gradient_easing.active = false;
+      }
+    }
+
+    return stroke_width_easing.active || stroke_color_easing.active || fill_color_easing.active ||
+           fill_gradient_easing.active;
   }
 
   Easing<double> stroke_width_easing;
   Easing<Rgb> stroke_color_easing;
   Easing<Rgb> fill_color_easing;
+  Easing<GradientStops> fill_gradient_easing;
 };
 
 template <typename TargetComponent>
@@ -722,13 +778,23 @@ class EasingSystem : public entityx::System<EasingSystem<TargetComponent>>
     Easings<TargetComponent>::Handle easing;
     typename TargetComponent::Handle target;
 
+    active_count = 0;
     for (entityx::Entity entity : es.entities_with_components(easing, target))
     {
       // TODO: add events
       bool alive = easing->apply(target, dt);
-      if (!alive) entity.remove<Easings<TargetComponent>>();
+      if (alive)
+        ++active_count;
+      else
+        entity.remove<Easings<TargetComponent>>();
     }
   }
+
+  // Entities still easing after the last update; zero once everything has settled
+  size_t active() const { return active_count; }
+
+ private:
+  size_t active_count = 0;
 };
 
 }  // namespace vibrant
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef VIBRANT_FIXED_TIMESTEP_HPP
+
+#include "entityx/entityx.h"
+
+#include "vibrant/body.hpp"
+
+namespace vibrant
+{
+// Turns variable frame times into a whole number of fixed simulation steps, so easing and layout
+// advance the same way regardless of frame rate.
+//
+// Leftover time carries over to the next frame; alpha() is how far the frame lies between the
+// last two simulated states, for the renderer to interpolate Body transforms with. At most
+// max_steps run per frame, and time beyond that is dropped so a render spike can't snowball into
+// ever longer frames.
+//
+//   for (unsigned int steps = timestep.advance(frame_ms); steps; --steps)
+//   {
+//     store_previous_bodies(es);
+//     ... update systems by timestep.stepMs() ...
+//   }
+//   buffer.record(es, 1, timestep.alpha());
+class FixedTimestep
+{
+ public:
+  explicit FixedTimestep(double steps_per_second = 60, unsigned int max_steps = 4);
+
+  void setRate(double steps_per_second) { step_ms = 1000 / steps_per_second; }
+  double rate() const { return 1000 / step_ms; }
+  double stepMs() const { return step_ms; }
+
+  void setMaxSteps(unsigned int steps) { max_steps = steps; }
+  unsigned int maxSteps() const { return max_steps; }
+
+  // Adds a frame's time and returns how many steps to simulate
+  unsigned int advance(double delta_ms);
+  // In [0, 1); how far from the previous state towards the latest one to draw
+  double alpha() const { return accumulated_ms / step_ms; }
+
+  void reset() { accumulated_ms = 0; }
+
+  size_t steps() const { return step_count; }
+  double droppedMs() const { return dropped_ms; }
+
+ private:
+  double step_ms;
+  unsigned int max_steps;
+  double accumulated_ms = 0;
+  size_t step_count = 0;
+  double dropped_ms = 0;
+};
+
+// The Body of an entity as of the previous simulation step
+struct PreviousBody : entityx::Component<PreviousBody>
+{
+  PreviousBody(const Body& body) : position(body.position), size(body.size), rotation(body.rotation)
+  {
+  }
+
+  Vector2d position;
+  Vector2d size;
+  Radians rotation;
+};
+
+// Copies every Body into its PreviousBody, assigning one where missing. Call before each step.
+void store_previous_bodies(entityx::EntityManager& es);
+
+// alpha 0 is previous, 1 is body. Rotation isn't wrapped; eases may spin through several turns.
+Body interpolate(const PreviousBody& previous, const Body& body, double alpha);
+}
+
+#endif  // VIBRANT_FIXED_TIMESTEP_HPP
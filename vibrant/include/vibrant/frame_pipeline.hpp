@@ -0,0 +1,61 @@
+#pragma once
+#ifndef VIBRANT_FRAME_PIPELINE_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "vibrant/command_buffer.hpp"
+
+namespace vibrant
+{
+// Overlaps simulation and rasterisation. The caller simulates and records frame N+1 while a
+// dedicated render thread executes the snapshot of frame N, so a frame costs roughly
+// max(simulation, render) instead of their sum.
+//
+// At most one frame is in flight: submit() waits for the previous frame to finish first, which
+// bounds latency to one frame. Nothing but the submitted RenderCommandBuffer is shared with the
+// render thread, so systems may freely mutate the ECS while a frame renders.
+class FramePipeline
+{
+ public:
+  typedef std::function<void(const RenderCommandBuffer&)> RenderFunction;
+
+  explicit FramePipeline(RenderFunction render);
+  ~FramePipeline();
+
+  FramePipeline(const FramePipeline&) = delete;
+  FramePipeline& operator=(const FramePipeline&) = delete;
+
+  // Hands a recorded frame to the render thread. The contents of frame are swapped with the
+  // previously rendered buffer, so recording into it again reuses that allocation.
+  void submit(RenderCommandBuffer& frame);
+
+  // Waits until the frame in flight has been rendered. This is the synchronisation point for
+  // anything that touches the render target, e.g. presenting it, resizing it or reading it back.
+  void sync();
+
+  bool busy() const;
+
+  size_t framesRendered() const;
+  double lastRenderMs() const;
+
+ private:
+  void run();
+
+  RenderFunction render;
+  RenderCommandBuffer in_flight;
+
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+  bool pending = false;
+  bool stopping = false;
+  size_t frames_rendered = 0;
+  double last_render_ms = 0;
+
+  std::thread render_thread;
+};
+}
+
+#endif  // VIBRANT_FRAME_PIPELINE_HPP
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef VIBRANT_FRAME_SCHEDULER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace vibrant
+{
+// Decides when a host should produce a frame, so it can stop redrawing while nothing changes.
+//
+// A frame is wanted after invalidate() (input, a resize, anything else one-off) or while any
+// activity, e.g. an EasingSystem with active eases, reports it still has work to do. Wanted frames
+// are paced to the target rate. When nothing is wanted the scheduler is idle and the host can
+// block until the next input event.
+//
+//   if (scheduler.frameDue())
+//   {
+//     double dt = scheduler.beginFrame();
+//     ... simulate dt, render and present ...
+//     scheduler.endFrame();
+//   }
+//   if (!scheduler.idle()) wake up again in scheduler.msUntilNextFrame()
+class FrameScheduler
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::function<bool()> ActivityFunction;
+
+  explicit FrameScheduler(double target_rate = 60);
+
+  void setTargetRate(double frames_per_second);
+  double targetRate() const { return 1000 / frame_interval_ms; }
+
+  // Polled at the end of every frame; while any returns true another frame is wanted
+  void addActivity(ActivityFunction active);
+
+  // Wants a frame for a one-off change
+  void invalidate() { pending = true; }
+
+  bool idle() const { return !pending; }
+  bool frameDue() const { return msUntilNextFrame() == 0; }
+  // Zero when a frame is due, negative while idle
+  double msUntilNextFrame() const;
+
+  // Starts a due frame. Returns the time since the previous frame in milliseconds, or one frame
+  // interval when waking from idle so nothing jumps ahead by the time spent idle.
+  double beginFrame();
+  void endFrame();
+
+  size_t frames() const { return frame_count; }
+
+ private:
+  double frame_interval_ms;
+  std::vector<ActivityFunction> activities;
+  Clock::time_point last_frame;
+  bool pending = true;
+  bool resuming = true;
+  size_t frame_count = 0;
+};
+}
+
+#endif  // VIBRANT_FRAME_SCHEDULER_HPP
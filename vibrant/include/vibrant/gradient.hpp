@@ -0,0 +1,82 @@
+#pragma once
+#ifndef VIBRANT_GRADIENT_HPP
+
+#include <initializer_list>
+#include <vector>
+
+#include "vibrant/vector.hpp"
+#include "vibrant/color.hpp"
+
+namespace vibrant
+{
+struct GradientStop
+{
+  double offset;  // 0 to 1 along the gradient
+  Rgb color;
+};
+
+// Color stops in offset order
+class GradientStops
+{
+ public:
+  GradientStops() {}
+  GradientStops(std::initializer_list<GradientStop> stops) : stops(stops) {}
+
+  void push_back(const GradientStop& stop) { stops.push_back(stop); }
+
+  GradientStop& operator[](size_t i) { return stops[i]; }
+  const GradientStop& operator[](size_t i) const { return stops[i]; }
+
+  std::vector<GradientStop>::const_iterator begin() const { return stops.begin(); }
+  std::vector<GradientStop>::const_iterator end() const { return stops.end(); }
+
+  size_t size() const { return stops.size(); }
+  bool empty() const { return stops.empty(); }
+
+ private:
+  std::vector<GradientStop> stops;
+};
+
+// So easing functions work. Stops combine pairwise; a missing stop counts as a zero offset,
+// transparent black stop, so ease between gradients with the same number of stops.
+GradientStops operator+(const GradientStops& lhs, const GradientStops& rhs);
+GradientStops operator-(const GradientStops& lhs, const GradientStops& rhs);
+GradientStops operator*(const GradientStops& lhs, const GradientStops& rhs);
+
+GradientStops operator*(const GradientStops& lhs, double rhs);
+GradientStops operator/(const GradientStops& lhs, double rhs);
+GradientStops operator+(const GradientStops& lhs, double rhs);
+
+GradientStops operator*(double lhs, const GradientStops& rhs);
+GradientStops operator+(double lhs, const GradientStops& rhs);
+
+GradientStops operator-(const GradientStops& rhs);
+
+bool operator==(const GradientStops& lhs, const GradientStops& rhs);
+
+enum class GradientType
+{
+  Linear,  // from start to end
+  Radial   // around start, out to end
+};
+
+struct Gradient
+{
+  // start and end are relative to the Body's box, (0, 0) top left and (1, 1) bottom right
+
+  Gradient() : type(GradientType::Linear), start(0, 0), end(1, 0) {}
+  Gradient(GradientType type, Vector2d start, Vector2d end, GradientStops stops)
+      : type(type), start(start), end(end), stops(stops)
+  {
+  }
+
+  GradientType type;
+  Vector2d start;
+  Vector2d end;
+  GradientStops stops;  // no stops fills with the solid color instead
+};
+
+bool operator==(const Gradient& lhs, const Gradient& rhs);
+}
+
+#endif  // VIBRANT_GRADIENT_HPP
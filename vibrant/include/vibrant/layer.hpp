@@ -0,0 +1,22 @@
+#pragma once
+#ifndef VIBRANT_LAYER_HPP
+
+#include "entityx/entityx.h"
+
+namespace vibrant
+{
+typedef unsigned int LayerId;
+const LayerId NoLayer = static_cast<LayerId>(-1);
+
+// Marks an entity as a member of a cached layer. Render backends rasterise all members sharing a
+// LayerId into one offscreen surface and only re-rasterise it when a member's Body or Renderable
+// changes. The layer is composited at the z of its lowest member.
+struct Layer : entityx::Component<Layer>
+{
+  Layer(LayerId id) : id(id) {}
+
+  LayerId id;
+};
+}
+
+#endif  // VIBRANT_LAYER_HPP
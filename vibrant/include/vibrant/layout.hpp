@@ -1,7 +1,18 @@
 #pragma once
 #ifndef VIBRANT_LAYOUT_HPP
 
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "vibrant/vector.hpp"
+#include "vibrant/renderable.hpp"
+#include "vibrant/container.hpp"
+#include "vibrant/ease.hpp"
+#include "vibrant/solver_thread.hpp"
 #include "entityx/entityx.h"
 #include "rhea/simplex_solver.hpp"
 
@@ -22,24 +33,217 @@ struct Layout : entityx::Component<Layout>
 
 };
 
-class LayoutSystem : public entityx::System<LayoutSystem>
+// Measured size of an entity's content, maintained by LayoutSystem for entities with a Layout and
+// a Text primitive. The entity's Layout is constrained to be at least this large.
+struct IntrinsicSize : entityx::Component<IntrinsicSize>
+{
+  IntrinsicSize(Text measured, Vector2d size) : measured(measured), size(size) {}
+
+  Text measured;  // what size was measured from
+  Vector2d size;
+  rhea::constraint min_width;
+  rhea::constraint min_height;
+};
+
+// Emitted by LayoutSystem::update() with the entities whose Body it just moved or resized, so
+// culling, damage tracking and hit testing can revisit only those
+struct LayoutChanged : public entityx::Event<LayoutChanged>
+{
+  LayoutChanged(const std::vector<entityx::Entity::Id>& entities) : entities(entities) {}
+
+  const std::vector<entityx::Entity::Id>& entities;
+};
+
+struct LayoutCacheStats
+{
+  size_t hits = 0;           // viewport size restored without solving
+  size_t misses = 0;         // viewport size solved
+  size_t evictions = 0;      // least recently used size dropped for a new one
+  size_t invalidations = 0;  // cleared by a constraint change
+};
+
+// Copies solved Layout variables into Bodies, and arranges Container trees.
+//
+// Only variables the solver reports through on_variable_change are copied, so a frame without a
+// re-solve doesn't touch any Body. Entities are found from their variables through a map kept up
+// to date as Layout components come and go.
+//
+// Users tend to switch between a handful of viewport sizes, so the solved values of every Layout
+// are remembered for the sizes most recently left and restored without the solver when the
+// viewport returns to one. Any constraint change clears them, which only changes made through
+// addConstraint() and removeConstraint() do by themselves.
+//
+// Layout variables are animated through edit variables rather than by easing Bodies, which update
+// would overwrite, or by swapping constraints. Every animation suggests its value and then a
+// single incremental resolve per update settles all of them together with any size change.
+//
+// Optionally the solver runs on a worker thread, so large constraint changes don't stall frames;
+// see setAsynchronous().
+//
+// Stacks, grids and flex rows are best built from Containers rather than constraints: trees of
+// them skip the solver, see ContainerLayout.
+class LayoutSystem : public entityx::System<LayoutSystem>, public entityx::Receiver<LayoutSystem>
 {
  public:
+  typedef std::function<Vector2d(const Text&)> TextMeasureFunction;
+
   LayoutSystem();
 
+  void configure(entityx::EventManager& events) override;
   void update(entityx::EntityManager& es, entityx::EventManager& events,
               entityx::TimeDelta dt) override;
 
+  void receive(const entityx::ComponentAddedEvent<Layout>& event);
+  void receive(const entityx::ComponentRemovedEvent<Layout>& event);
+  void receive(const entityx::ComponentAddedEvent<Renderable>& event);
+  void receive(const entityx::ComponentAddedEvent<Container>& event);
+  void receive(const entityx::ComponentRemovedEvent<Container>& event);
+  void receive(const entityx::EntityDestroyedEvent& event);
+
+  // Entities whose Body the last update() changed
+  const std::vector<entityx::Entity::Id>& changed() const { return changed_entities; }
+
+  // The limits are edit variables; sizes set between two updates are resolved once, by update()
   void setSize(Vector2u size);
 
+  void addConstraint(const rhea::constraint& constraint);
+  void addConstraints(const rhea::constraint_list& constraints);
+  void removeConstraint(const rhea::constraint& constraint);
+  void removeConstraints(const rhea::constraint_list& constraints);
+  // For constraint changes made on the solver directly
+  void invalidateCache();
+  size_t constraintVersion() const { return constraint_version; }
+
+  // Eases variable to value as an edit variable of the given strength. With hold, it stays
+  // suggested at value afterwards until release(); otherwise the constraints take it back over.
+  // Animating a variable that's already animating or held starts from where it is.
+  void animate(const rhea::variable& variable, double value, double time, Ease ease,
+               double delay = 0, bool hold = true,
+               const rhea::strength& strength = rhea::strength::strong());
+  void release(const rhea::variable& variable);
+  // Animations still running after the last update
+  size_t animating() const { return active_animations; }
+  // Solves run by update(), at most one each
+  size_t resolves() const { return resolve_count; }
+
+  // Moves the solver to a SolverThread. Constraint changes, sizes and animations are then queued
+  // and solved there, and update() applies whatever the worker published last without waiting
+  // for it. While asynchronous, the solver and its variables' values belong to the worker: read
+  // values through value(), and don't use solver directly. The solved-layout cache is bypassed.
+  void setAsynchronous(bool asynchronous);
+  bool asynchronous() const { return solver_thread != nullptr; }
+  // Makes the next update() wait until every change queued so far is solved
+  void waitForSolver() { wait_for_solver = true; }
+  // The variable's value as of the last update(). While asynchronous, that's the last value the
+  // worker published; variables it hasn't published read as NaN. Layout variables, the limits
+  // and animated variables are published when going asynchronous, and those of a Layout added
+  // later with the next snapshot.
+  double value(const rhea::variable& variable) const;
+
+  // How many viewport sizes to remember; zero disables the cache
+  void setCacheCapacity(size_t sizes);
+  size_t cacheSize() const { return solved_layouts.size(); }
+  size_t cacheMemoryUsage() const;
+  const LayoutCacheStats& cacheStats() const { return cache_stats; }
+  void resetCacheStats() { cache_stats = LayoutCacheStats(); }
+
+  // Render backends provide text measurement, e.g. CairoTextCache::measure. Text is measured
+  // when its entity gets a Layout or Renderable; call remeasure() after editing it in place.
+  // Quiet frames measure nothing.
+  void setTextMeasure(TextMeasureFunction measure);
+  void remeasure(entityx::Entity entity);
+
+  const ContainerStats& containerStats() const { return containers.stats(); }
+
   rhea::simplex_solver solver;
   rhea::variable left_limit;
   rhea::variable right_limit;
   rhea::variable top_limit;
   rhea::variable bottom_limit;
-  rhea::constraint right_limit_stay;
-  rhea::constraint bottom_limit_stay;
 
+ private:
+  struct SolvedValues
+  {
+    entityx::Entity::Id entity;
+    double x, y, width, height;
+  };
+
+  struct Animation
+  {
+    rhea::variable variable;
+    Easing<double> easing;
+    bool hold;
+    // Waiting for the worker to publish the value to start from
+    bool awaiting_start = false;
+  };
+
+  struct TrackedVariable
+  {
+    rhea::variable variable;
+    entityx::Entity::Id entity;
+  };
+
+  struct SolvedLayout
+  {
+    uint64_t size;
+    size_t version;
+    double right, bottom;
+    std::vector<SolvedValues> values;
+  };
+
+  void watchSolver();
+  // Applies an edit to the solver now, or queues it on the worker
+  void edit(SolverThread::Edit edit);
+  void takeSnapshot();
+  void publishValue(const rhea::variable& variable);
+  bool isPublished(const Layout& layout) const;
+  void updateIntrinsicSizes(entityx::EntityManager& es);
+  void updateIntrinsicSize(entityx::Entity entity, const Layout& layout,
+                           const Renderable& renderable);
+  void untrack(const Layout& layout);
+  void remember(entityx::EntityManager& es, Vector2u viewport);
+  bool restore(entityx::EntityManager& es, Vector2u viewport);
+  // Both only suggest, leaving the resolve to update()
+  bool resize(entityx::EntityManager& es);
+  void suggest(Vector2u viewport);
+  void suggestValue(const rhea::variable& variable, double value);
+  bool advanceAnimations(double delta);
+
+  TextMeasureFunction measure_text;
+  // Entities to measure at the next update(), with duplicates, unless everything is
+  std::vector<entityx::Entity::Id> unmeasured;
+  bool measure_all = false;
+  ContainerLayout containers;
+  Vector2u size;
+  // What the variables currently hold a layout for, and what the solver last solved for. They
+  // differ after a layout is restored from the cache.
+  Vector2u solved_size;
+  Vector2u suggested_size;
+  size_t restored_version = 0;
+  size_t resolve_count = 0;
+
+  // Running animations, and finished ones still held, each with an edit variable
+  std::vector<Animation> animations;
+  size_t active_animations = 0;
+
+  // Most recently used first
+  std::list<SolvedLayout> solved_layouts;
+  std::unordered_map<uint64_t, std::list<SolvedLayout>::iterator> solved_by_size;
+  size_t cache_capacity = 8;
+  size_t constraint_version = 0;
+  LayoutCacheStats cache_stats;
+
+  // Layout variables by id, with the entity they belong to; a variable belongs to one Layout
+  std::unordered_map<size_t, TrackedVariable> variable_entities;
+  // Entities with a variable the solver changed since the last update(), with duplicates
+  std::vector<entityx::Entity::Id> dirty;
+  std::vector<entityx::Entity::Id> changed_entities;
+
+  // Declared after the solver, so the worker stops before the solver goes
+  std::unique_ptr<SolverThread> solver_thread;
+  // While asynchronous, the only variable values update() reads, by variable id
+  std::unordered_map<size_t, double> published_values;
+  bool wait_for_solver = false;
 };
 
 }  // namespace vibrant
@@ -1,10 +1,13 @@
 #pragma once
 #ifndef VIBRANT_RENDERABLE_HPP
 
+#include <string>
+
 #include "entityx/entityx.h"
 #include "boost/variant.hpp"
 
 #include "vibrant/color.hpp"
+#include "vibrant/gradient.hpp"
 
 namespace vibrant
 {
@@ -18,7 +21,7 @@ struct Stroke
 struct Fill
 {
   Rgb color;
-  // TODO: Gradients
+  Gradient gradient;  // used instead of color when it has stops
 };
 
 struct Line
@@ -40,7 +43,79 @@ struct Rectangle
   Fill fill;
 };
 
-typedef boost::variant<Line, Rectangle> RenderPrimitive;
+struct Font
+{
+  Font(std::string family, double size, bool bold = false, bool italic = false)
+      : family(family), size(size), bold(bold), italic(italic)
+  {
+  }
+
+  std::string family;
+  double size;
+  bool bold;
+  bool italic;
+};
+
+struct Text
+{
+  // centered on and rotates around center of Body
+
+  Text(std::string text, Font font, Fill fill, Stroke stroke = {0, Rgb()})
+      : text(text), font(font), fill(fill), stroke(stroke)
+  {
+  }
+
+  std::string text;
+  Font font;
+  Fill fill;
+  Stroke stroke;
+};
+
+struct Image
+{
+  // stretched over and rotates around center of Body; stroke draws a border around it
+
+  Image(std::string path, Stroke stroke = {0, Rgb()}, double opacity = 1.0)
+      : path(path), stroke(stroke), opacity(opacity)
+  {
+  }
+
+  std::string path;  // PNG file
+  Stroke stroke;
+  double opacity;
+};
+
+inline bool operator==(const Stroke& lhs, const Stroke& rhs)
+{
+  return lhs.width == rhs.width && lhs.color == rhs.color;
+}
+inline bool operator==(const Fill& lhs, const Fill& rhs)
+{
+  return lhs.color == rhs.color && lhs.gradient == rhs.gradient;
+}
+inline bool operator==(const Line& lhs, const Line& rhs) { return lhs.stroke == rhs.stroke; }
+inline bool operator==(const Rectangle& lhs, const Rectangle& rhs)
+{
+  return lhs.stroke == rhs.stroke && lhs.fill == rhs.fill;
+}
+
+inline bool operator==(const Font& lhs, const Font& rhs)
+{
+  return lhs.family == rhs.family && lhs.size == rhs.size && lhs.bold == rhs.bold &&
+         lhs.italic == rhs.italic;
+}
+inline bool operator==(const Text& lhs, const Text& rhs)
+{
+  return lhs.text == rhs.text && lhs.font == rhs.font && lhs.fill == rhs.fill &&
+         lhs.stroke == rhs.stroke;
+}
+
+inline bool operator==(const Image& lhs, const Image& rhs)
+{
+  return lhs.path == rhs.path && lhs.stroke == rhs.stroke && lhs.opacity == rhs.opacity;
+}
+
+typedef boost::variant<Line, Rectangle, Text, Image> RenderPrimitive;
 
 struct Renderable : entityx::Component<Renderable>
 {
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef VIBRANT_SOLVER_THREAD_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "rhea/simplex_solver.hpp"
+
+// Layouts keep handles to the variables the worker thread's solver holds
+#ifdef RHEA_SINGLE_THREADED
+#error "SolverThread needs rhea built with atomic variable reference counts"
+#endif
+
+namespace vibrant
+{
+// What a SolverThread solved: the new value of every variable that changed, by variable id
+struct SolverSnapshot
+{
+  std::unordered_map<size_t, double> values;
+  size_t solves = 0;
+  // The first exception an edit threw, if any
+  std::exception_ptr error;
+};
+
+// Runs a simplex_solver on a worker thread.
+//
+// Edits are queued by post() and applied on the worker in order; each batch of edits queued
+// while the worker was busy is followed by a single resolve(). The variables whose values that
+// changed are published as an immutable snapshot by swapping a shared_ptr atomically, which
+// take() claims without ever blocking. Snapshots the caller hasn't claimed yet are merged into the
+// next one, so no change is lost however many solves happen between two frames.
+//
+// While it runs, the solver and the values of its variables belong to the worker thread.
+class SolverThread
+{
+ public:
+  typedef std::function<void(rhea::simplex_solver&)> Edit;
+
+  explicit SolverThread(rhea::simplex_solver& solver);
+  // Finishes the queued edits first
+  ~SolverThread();
+
+  SolverThread(const SolverThread&) = delete;
+  SolverThread& operator=(const SolverThread&) = delete;
+
+  void post(Edit edit);
+  // Publishes the values the variables have on the worker with the next snapshot, whether the
+  // solver changes them or not
+  void read(std::vector<rhea::variable> variables);
+
+  // Changes published since the last call, or nullptr if there are none
+  std::shared_ptr<const SolverSnapshot> take();
+
+  // Blocks until every edit posted so far is solved and published
+  void wait();
+  bool busy() const;
+
+ private:
+  void run();
+  void publish();
+
+  rhea::simplex_solver& solver;
+  // Worker thread only
+  std::shared_ptr<SolverSnapshot> collecting;
+  // Only accessed through std::atomic_load, std::atomic_store and std::atomic_exchange
+  std::shared_ptr<SolverSnapshot> published;
+
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<Edit> queued;
+  bool solving = false;
+  bool stopping = false;
+
+  std::thread worker;
+};
+}
+
+#endif  // VIBRANT_SOLVER_THREAD_HPP
@@ -58,6 +58,17 @@ Vector2<Ty> operator+(double lhs, Vector2<Ty> rhs)
   return Vector2<Ty>(lhs + rhs.x, lhs + rhs.y);
 }
 
+template <typename Ty>
+bool operator==(Vector2<Ty> lhs, Vector2<Ty> rhs)
+{
+  return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+template <typename Ty>
+bool operator!=(Vector2<Ty> lhs, Vector2<Ty> rhs)
+{
+  return !(lhs == rhs);
+}
+
 template <typename Ty>
 struct Vector2
 {
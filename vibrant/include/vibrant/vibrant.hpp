@@ -8,6 +8,14 @@
 #include "vibrant/body.hpp"
 #include "vibrant/ease.hpp"
 #include "vibrant/mouse.hpp"
+#include "vibrant/solver_thread.hpp"
 #include "vibrant/layout.hpp"
+#include "vibrant/container.hpp"
+#include "vibrant/virtual_list.hpp"
+#include "vibrant/layer.hpp"
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/frame_pipeline.hpp"
+#include "vibrant/frame_scheduler.hpp"
+#include "vibrant/fixed_timestep.hpp"
 
 #endif  // VIBRANT_VIBRANT_HPP
\ No newline at end of file
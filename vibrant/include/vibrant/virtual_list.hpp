@@ -0,0 +1,119 @@
+#pragma once
+#ifndef VIBRANT_VIRTUAL_LIST_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "entityx/entityx.h"
+
+#include "vibrant/container.hpp"
+#include "vibrant/vector.hpp"
+
+namespace vibrant
+{
+// The extent of every row of a list along its axis, and where each row starts.
+//
+// Rows all have the estimated extent until one is measured. Until then nothing is stored and
+// lookups are arithmetic; after, extents are kept in a Fenwick tree of prefix sums, so offsets and
+// the row at an offset are found in O(log n), and re-measuring a row is O(log n).
+class RowExtents
+{
+ public:
+  explicit RowExtents(size_t rows = 0, double estimated = 20);
+
+  // Added rows get the estimated extent. O(n) once any row was measured.
+  void resize(size_t rows);
+  size_t size() const { return rows; }
+
+  void set(size_t row, double extent);
+  double extent(size_t row) const;
+  // Sum of the extents of the rows before row
+  double offset(size_t row) const;
+  double total() const { return offset(rows); }
+  // The row covering offset, clamped to the first and last row. Rows must not be empty.
+  size_t rowAt(double offset) const;
+
+  // Changes whenever an offset may have
+  size_t version() const { return extents_version; }
+
+ private:
+  size_t rows;
+  double estimated;
+  std::vector<double> extents;  // empty until a row is measured
+  std::vector<double> tree;     // 1-based Fenwick tree over extents
+  size_t extents_version = 0;
+};
+
+// A scrolling list of any number of rows, of which only those in view, plus overscan rows either
+// side, exist as entities.
+//
+// VirtualListSystem places row entities one after the other inside the list entity's Body, along
+// the axis and stretched across it. bind() turns a row entity into a given row: it's handed an
+// entity with a Body and without a Renderable or Mouseable, and assigns whatever the row shows.
+// Rows scrolled out of view are unbound and recycled for rows scrolling in.
+struct VirtualList : entityx::Component<VirtualList>
+{
+  typedef std::function<void(entityx::Entity row, size_t index)> BindFunction;
+
+  VirtualList(size_t rows, double row_extent, BindFunction bind, Axis axis = Axis::Vertical)
+      : extents(rows, row_extent), bind(bind), axis(axis)
+  {
+  }
+
+  // Call after the rows' data changed, so every row in view is bound again
+  void rebind() { changed = true; }
+
+  RowExtents extents;
+  BindFunction bind;
+  Axis axis;
+  double scroll = 0;        // clamped to the list's extent by VirtualListSystem
+  size_t overscan = 4;      // rows materialised beyond either edge of the view
+  size_t spare_limit = 16;  // unbound rows kept for reuse beyond those in view
+  bool changed = true;
+
+  // Maintained by VirtualListSystem; live[i] shows row first + i
+  size_t first = 0;
+  std::vector<entityx::Entity> live;
+  std::vector<entityx::Entity> spare;
+  double placed_scroll = -1;
+  Vector2d placed_position;
+  Vector2d placed_size;
+  size_t placed_version = 0;
+};
+
+// Keeps the row entities of VirtualLists in step with their scroll position. Run it after
+// LayoutSystem, which may place the lists themselves.
+//
+// Each update costs O(rows in view + log rows) for a list that scrolled, moved or changed, and
+// nothing for one that didn't, however many rows it has.
+class VirtualListSystem : public entityx::System<VirtualListSystem>,
+                          public entityx::Receiver<VirtualListSystem>
+{
+ public:
+  void configure(entityx::EventManager& events) override;
+  void update(entityx::EntityManager& es, entityx::EventManager& events,
+              entityx::TimeDelta dt) override;
+
+  void receive(const entityx::ComponentAddedEvent<VirtualList>& event);
+  void receive(const entityx::ComponentRemovedEvent<VirtualList>& event);
+  void receive(const entityx::EntityDestroyedEvent& event);
+
+  // Row entities created, and rows bound, since the system was made
+  size_t created() const { return created_rows; }
+  size_t bound() const { return bound_rows; }
+
+ private:
+  void refresh(entityx::EntityManager& es, entityx::Entity entity, VirtualList& list);
+  void unbind(entityx::Entity row);
+  void untrack(entityx::Entity::Id entity, const VirtualList& list);
+
+  std::vector<entityx::Entity::Id> lists;
+  std::vector<entityx::Entity> kept;
+  std::vector<entityx::Entity::Id> changed_entities;
+  size_t created_rows = 0;
+  size_t bound_rows = 0;
+};
+}
+
+#endif  // VIBRANT_VIRTUAL_LIST_HPP
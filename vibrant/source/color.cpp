@@ -45,6 +45,12 @@ Rgb operator+(double lhs, Rgb rhs)
 
 Rgb operator-(const Rgb& rhs) { return Rgb(-rhs.r, -rhs.g, -rhs.b, -rhs.a); }
 
+bool operator==(const Rgb& lhs, const Rgb& rhs)
+{
+  return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+}
+bool operator!=(const Rgb& lhs, const Rgb& rhs) { return !(lhs == rhs); }
+
 Rgb::operator Hsl() const
 {
   assert(!(r < 0 || r > 1) && !(g < 0 || g > 1) && !(b < 0 || b > 1));
@@ -0,0 +1,216 @@
+#include "pch.hpp"
+
+#include "vibrant/command_buffer.hpp"
+#include "vibrant/fixed_timestep.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace vibrant
+{
+using std::get;
+
+// Threads that record() splits large frames over, started once and kept for later frames
+class RenderCommandBuffer::Workers
+{
+ public:
+  ~Workers();
+
+  // Runs task for every chunk below count, chunk 0 on the calling thread and the others on the
+  // workers, and returns once all of them are done
+  void run(size_t count, const std::function<void(size_t)>& task);
+
+ private:
+  void work(size_t chunk);
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  const std::function<void(size_t)>* current = nullptr;
+  size_t chunks = 0;
+  size_t remaining = 0;
+  size_t generation = 0;
+  bool stopping = false;
+
+  // The thread at index i runs chunk i + 1
+  std::vector<std::thread> threads;
+};
+
+RenderCommandBuffer::Workers::~Workers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  changed.notify_all();
+  for (auto& thread : threads) thread.join();
+}
+
+void RenderCommandBuffer::Workers::run(size_t count, const std::function<void(size_t)>& task)
+{
+  while (threads.size() + 1 < count) threads.emplace_back(&Workers::work, this, threads.size() + 1);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    current = &task;
+    chunks = count;
+    remaining = count - 1;
+    ++generation;
+  }
+  changed.notify_all();
+
+  task(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this] { return remaining == 0; });
+  current = nullptr;
+}
+
+void RenderCommandBuffer::Workers::work(size_t chunk)
+{
+  size_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    changed.wait(lock, [&] { return generation != seen || stopping; });
+    if (stopping) return;
+
+    seen = generation;
+    // Frames too small to need every worker leave the rest waiting
+    if (chunk >= chunks) continue;
+
+    const std::function<void(size_t)>& task = *current;
+    lock.unlock();
+    task(chunk);
+    lock.lock();
+    if (--remaining == 0) changed.notify_all();
+  }
+}
+
+RenderCommandBuffer::RenderCommandBuffer() {}
+
+RenderCommandBuffer::RenderCommandBuffer(const RenderCommandBuffer& other)
+    : commands(other.commands)
+{
+}
+
+RenderCommandBuffer::RenderCommandBuffer(RenderCommandBuffer&& other) = default;
+
+RenderCommandBuffer::~RenderCommandBuffer() {}
+
+RenderCommandBuffer& RenderCommandBuffer::operator=(const RenderCommandBuffer& other)
+{
+  commands = other.commands;
+  return *this;
+}
+
+RenderCommandBuffer& RenderCommandBuffer::operator=(RenderCommandBuffer&& other) = default;
+
+bool operator==(const RenderCommand& lhs, const RenderCommand& rhs)
+{
+  return lhs.entity == rhs.entity && lhs.body.position.x == rhs.body.position.x &&
+         lhs.body.position.y == rhs.body.position.y && lhs.body.size.x == rhs.body.size.x &&
+         lhs.body.size.y == rhs.body.size.y && lhs.body.rotation == rhs.body.rotation &&
+         lhs.primitive == rhs.primitive && lhs.z == rhs.z && lhs.layer == rhs.layer;
+}
+
+void RenderCommandBuffer::record(entityx::EntityManager& es, unsigned int threads, double alpha)
+{
+  Body::Handle body;
+  Renderable::Handle renderable;
+
+  // Walking the ECS is inherently serial; only gather handles here
+  sources.clear();
+  for (entityx::Entity entity : es.entities_with_components(body, renderable))
+    sources.emplace_back(entity, body, renderable);
+
+  commands.resize(sources.size());
+  bool interpolating = alpha < 1;
+  auto snapshot = [this, alpha, interpolating](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      entityx::Entity entity = get<0>(sources[i]);
+      const Renderable& renderable = *get<2>(sources[i]).get();
+      Layer::Handle layer = entity.component<Layer>();
+
+      // Assigned member by member: assigning a primitive over one of the same kind reuses the
+      // storage of its strings and gradient stops
+      RenderCommand& command = commands[i];
+      command.entity = entity.id();
+      command.body = *get<1>(sources[i]).get();
+      command.primitive = renderable.primitive;
+      command.z = renderable.z;
+      command.layer = layer ? layer->id : NoLayer;
+
+      // Entities created since the last step have nothing to interpolate from
+      if (!interpolating) continue;
+      PreviousBody::Handle previous = entity.component<PreviousBody>();
+      if (previous) command.body = interpolate(*previous.get(), command.body, alpha);
+    }
+  };
+
+  // Not worth handing to a thread for fewer than a few thousand copies
+  const size_t min_chunk = 4096;
+  size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, sources.size() / min_chunk));
+  size_t chunk_size = (sources.size() + chunks - 1) / chunks;
+  auto chunk = [&](size_t index)
+  {
+    snapshot(std::min(sources.size(), index * chunk_size),
+             std::min(sources.size(), (index + 1) * chunk_size));
+  };
+
+  if (chunks == 1)
+  {
+    chunk(0);
+  }
+  else
+  {
+    if (!workers) workers.reset(new Workers());
+    // By reference, so the std::function needn't allocate
+    workers->run(chunks, std::ref(chunk));
+  }
+
+  sort();
+}
+
+void RenderCommandBuffer::append(const RenderCommandBuffer& other)
+{
+  commands.insert(commands.end(), other.commands.begin(), other.commands.end());
+}
+
+void RenderCommandBuffer::sort()
+{
+  // Usually already in order, and std::stable_sort allocates a buffer every time
+  auto by_z = [](const RenderCommand& c1, const RenderCommand& c2) { return c1.z < c2.z; };
+  if (std::is_sorted(commands.begin(), commands.end(), by_z)) return;
+
+  std::stable_sort(commands.begin(), commands.end(), by_z);
+}
+
+void RenderCommandBuffer::diff(const RenderCommandBuffer& previous,
+                               std::vector<entityx::Entity::Id>& changed) const
+{
+  std::unordered_map<uint64_t, const RenderCommand*> before;
+  before.reserve(previous.size());
+  for (auto& command : previous.commands) before.emplace(command.entity.id(), &command);
+
+  for (auto& command : commands)
+  {
+    auto found = before.find(command.entity.id());
+    if (found == before.end())
+    {
+      changed.push_back(command.entity);
+      continue;
+    }
+
+    if (*found->second != command) changed.push_back(command.entity);
+    before.erase(found);
+  }
+
+  for (auto& removed : before) changed.push_back(removed.second->entity);
+}
+}
@@ -0,0 +1,482 @@
+#include "pch.hpp"
+
+#include "vibrant/container.hpp"
+#include "vibrant/body.hpp"
+#include "vibrant/layout.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace vibrant
+{
+namespace
+{
+// One axis of a Layout, whose variables are the centre and size
+struct Span
+{
+  rhea::linear_expression start() const { return center - size / 2.0; }
+  rhea::linear_expression end() const { return center + size / 2.0; }
+
+  rhea::variable center;
+  rhea::variable size;
+};
+
+Span main_span(const Layout& layout, Axis axis)
+{
+  return axis == Axis::Horizontal ? Span{layout.x, layout.width} : Span{layout.y, layout.height};
+}
+
+Span cross_span(const Layout& layout, Axis axis)
+{
+  return axis == Axis::Horizontal ? Span{layout.y, layout.height} : Span{layout.x, layout.width};
+}
+
+// Where a child wanting a size ends up in a slot
+void align(Alignment alignment, double slot_start, double slot_size, double wanted, double& start,
+           double& size)
+{
+  size = alignment == Alignment::Stretch ? slot_size : wanted;
+  start = slot_start;
+  if (alignment == Alignment::Center) start += (slot_size - size) / 2;
+  if (alignment == Alignment::End) start += slot_size - size;
+}
+
+// The same, as constraints
+void align(rhea::constraint_list& constraints, Alignment alignment, const Span& item,
+           const rhea::linear_expression& slot_start, const rhea::linear_expression& slot_size,
+           double wanted)
+{
+  const rhea::strength strong = rhea::strength::strong();
+  switch (alignment)
+  {
+    case Alignment::Stretch:
+      constraints.emplace_back(item.start() == slot_start, strong);
+      constraints.emplace_back(item.size == slot_size, strong);
+      return;
+    case Alignment::Start:
+      constraints.emplace_back(item.start() == slot_start, strong);
+      break;
+    case Alignment::Center:
+      constraints.emplace_back(item.center == slot_start + slot_size / 2.0, strong);
+      break;
+    case Alignment::End:
+      constraints.emplace_back(item.end() == slot_start + slot_size, strong);
+      break;
+  }
+  constraints.emplace_back(item.size == wanted, rhea::strength::medium());
+}
+}
+
+void ContainerLayout::track(entityx::Entity::Id container, Container& component)
+{
+  containers.push_back(container);
+  component.structure_changed = structure_changed;
+  *structure_changed = true;
+}
+
+void ContainerLayout::untrack(entityx::Entity::Id container, const Container& component,
+                              LayoutSystem& layout)
+{
+  containers.erase(std::remove(containers.begin(), containers.end(), container), containers.end());
+  if (!component.constraints.empty()) layout.removeConstraints(component.constraints);
+  *structure_changed = true;
+}
+
+void ContainerLayout::restructure(entityx::EntityManager& es, LayoutSystem& layout)
+{
+  if (!*structure_changed) return;
+
+  *structure_changed = false;
+  arrange_all = true;
+  roots.clear();
+  container_stats = ContainerStats();
+
+  // Rebuilt from scratch; this only happens when containers are edited
+  std::unordered_map<uint64_t, unsigned int> parents;
+  for (entityx::Entity::Id id : containers)
+  {
+    Container::Handle container = es.get(id).component<Container>();
+    if (!container->constraints.empty()) layout.removeConstraints(container->constraints);
+    container->constraints.clear();
+    for (entityx::Entity::Id child : container->children) ++parents[child.id()];
+  }
+  for (uint64_t owned : owned_layouts)
+  {
+    entityx::Entity::Id id(owned);
+    if (es.valid(id) && es.get(id).has_component<Layout>()) es.get(id).remove<Layout>();
+  }
+  owned_layouts.clear();
+
+  std::unordered_set<uint64_t> visited;
+  std::vector<entityx::Entity::Id> members;
+  for (entityx::Entity::Id id : containers)
+  {
+    if (parents.count(id.id())) continue;
+
+    members.clear();
+    if (walk(es, id, parents, visited, members))
+    {
+      roots.push_back(id);
+      container_stats.direct += members.size();
+      continue;
+    }
+
+    for (entityx::Entity::Id member : members)
+      constrain(es, es.get(member), *es.get(member).component<Container>(), layout);
+  }
+
+  // Whatever no root reaches is nested in a cycle
+  for (entityx::Entity::Id id : containers)
+  {
+    if (visited.count(id.id())) continue;
+
+    entityx::Entity entity = es.get(id);
+    constrain(es, entity, *entity.component<Container>(), layout);
+  }
+}
+
+bool ContainerLayout::walk(entityx::EntityManager& es, entityx::Entity::Id root,
+                           const std::unordered_map<uint64_t, unsigned int>& parents,
+                           std::unordered_set<uint64_t>& visited,
+                           std::vector<entityx::Entity::Id>& members)
+{
+  bool tree = true;
+  std::vector<entityx::Entity::Id> pending(1, root);
+  while (!pending.empty())
+  {
+    entityx::Entity::Id id = pending.back();
+    pending.pop_back();
+
+    // Placed by two containers, or by a container and constraints of its own. Checked before
+    // skipping what another root already walked, as a child shared with it makes neither a tree.
+    entityx::Entity entity = es.get(id);
+    if (id != root && (parents.at(id.id()) > 1 || entity.has_component<Layout>())) tree = false;
+    if (!visited.insert(id.id()).second) continue;
+
+    Container::Handle container = entity.component<Container>();
+    if (!container) continue;
+
+    members.push_back(id);
+    for (entityx::Entity::Id child : container->children)
+    {
+      if (es.valid(child)) pending.push_back(child);
+    }
+  }
+  return tree;
+}
+
+void ContainerLayout::arrange(entityx::EntityManager& es,
+                              std::vector<entityx::Entity::Id>& changed)
+{
+  container_stats.placed = 0;
+  for (entityx::Entity::Id id : roots)
+  {
+    if (!es.valid(id)) continue;
+
+    entityx::Entity root = es.get(id);
+    Container::Handle container = root.component<Container>();
+    Body::Handle body = root.component<Body>();
+    if (!container || !body) continue;
+
+    if (!arrange_all && body->position == container->arranged_position &&
+        body->size == container->arranged_size)
+      continue;
+
+    measure(es, root);
+    arrange(es, root, *container, changed);
+    container->arranged_position = body->position;
+    container->arranged_size = body->size;
+  }
+  arrange_all = false;
+}
+
+Vector2d ContainerLayout::preferred(entityx::Entity entity) const
+{
+  Container::Handle container = entity.component<Container>();
+  if (container) return container->measured;
+
+  Sizing::Handle sizing = entity.component<Sizing>();
+  if (sizing) return sizing->preferred;
+
+  IntrinsicSize::Handle intrinsic = entity.component<IntrinsicSize>();
+  return intrinsic ? intrinsic->size : Vector2d();
+}
+
+Vector2d ContainerLayout::measure(entityx::EntityManager& es, entityx::Entity entity)
+{
+  Container::Handle container = entity.component<Container>();
+  if (!container) return preferred(entity);
+
+  bool horizontal = container->axis == Axis::Horizontal;
+  size_t count = 0;
+  double along = 0, across = 0;
+  Vector2d largest;
+  for (entityx::Entity::Id id : container->children)
+  {
+    if (!es.valid(id)) continue;
+
+    Vector2d size = measure(es, es.get(id));
+    ++count;
+    along += horizontal ? size.x : size.y;
+    across = std::max(across, horizontal ? size.y : size.x);
+    largest = Vector2d(std::max(largest.x, size.x), std::max(largest.y, size.y));
+  }
+
+  Vector2d content;
+  if (container->arrangement == Arrangement::Grid)
+  {
+    size_t columns = std::max(container->columns, 1u);
+    size_t used = std::min(count, columns), rows = (count + columns - 1) / columns;
+    content = Vector2d(largest.x * used + container->spacing * (used ? used - 1 : 0),
+                       largest.y * rows + container->spacing * (rows ? rows - 1 : 0));
+  }
+  else
+  {
+    along += container->spacing * (count ? count - 1 : 0);
+    content = horizontal ? Vector2d(along, across) : Vector2d(across, along);
+  }
+  content = content + container->padding * 2;
+
+  Sizing::Handle sizing = entity.component<Sizing>();
+  if (sizing)
+  {
+    content.x = std::max(content.x, sizing->preferred.x);
+    content.y = std::max(content.y, sizing->preferred.y);
+  }
+  container->measured = content;
+  return content;
+}
+
+void ContainerLayout::arrange(entityx::EntityManager& es, entityx::Entity entity,
+                              const Container& container,
+                              std::vector<entityx::Entity::Id>& changed)
+{
+  Body::Handle body = entity.component<Body>();
+  double padding = container.padding, spacing = container.spacing;
+  double left = body->position.x - body->size.x / 2 + padding;
+  double top = body->position.y - body->size.y / 2 + padding;
+  double width = std::max(body->size.x - padding * 2, 0.0);
+  double height = std::max(body->size.y - padding * 2, 0.0);
+
+  if (container.arrangement == Arrangement::Grid)
+  {
+    unsigned int columns = std::max(container.columns, 1u);
+    double cell_width = std::max((width - spacing * (columns - 1)) / columns, 0.0);
+    double cell_height = 0;
+    for (entityx::Entity::Id id : container.children)
+    {
+      if (es.valid(id)) cell_height = std::max(cell_height, preferred(es.get(id)).y);
+    }
+
+    size_t index = 0;
+    for (entityx::Entity::Id id : container.children)
+    {
+      if (!es.valid(id)) continue;
+
+      entityx::Entity child = es.get(id);
+      Vector2d wanted = preferred(child);
+      double x, y, w, h;
+      align(container.alignment, left + (index % columns) * (cell_width + spacing), cell_width,
+            wanted.x, x, w);
+      align(container.alignment, top + (index / columns) * (cell_height + spacing), cell_height,
+            wanted.y, y, h);
+      ++index;
+
+      place(child, x, y, w, h, changed);
+      Container::Handle nested = child.component<Container>();
+      if (nested) arrange(es, child, *nested, changed);
+    }
+    return;
+  }
+
+  bool horizontal = container.axis == Axis::Horizontal;
+  double along = horizontal ? left : top, length = horizontal ? width : height;
+  double across = horizontal ? top : left, breadth = horizontal ? height : width;
+
+  // Flex children share what's left after everyone's preferred size by their grow factor
+  double leftover = 0, total_grow = 0;
+  if (container.arrangement == Arrangement::Flex)
+  {
+    size_t count = 0;
+    double used = 0;
+    for (entityx::Entity::Id id : container.children)
+    {
+      if (!es.valid(id)) continue;
+
+      entityx::Entity child = es.get(id);
+      Vector2d wanted = preferred(child);
+      used += horizontal ? wanted.x : wanted.y;
+      Sizing::Handle sizing = child.component<Sizing>();
+      if (sizing) total_grow += std::max(sizing->grow, 0.0);
+      ++count;
+    }
+    leftover = std::max(length - used - spacing * (count ? count - 1 : 0), 0.0);
+  }
+
+  for (entityx::Entity::Id id : container.children)
+  {
+    if (!es.valid(id)) continue;
+
+    entityx::Entity child = es.get(id);
+    Vector2d wanted = preferred(child);
+    double size = horizontal ? wanted.x : wanted.y;
+    if (total_grow > 0)
+    {
+      Sizing::Handle sizing = child.component<Sizing>();
+      if (sizing) size += leftover * std::max(sizing->grow, 0.0) / total_grow;
+    }
+
+    double start, extent;
+    align(container.alignment, across, breadth, horizontal ? wanted.y : wanted.x, start, extent);
+    if (horizontal)
+      place(child, along, start, size, extent, changed);
+    else
+      place(child, start, along, extent, size, changed);
+    along += size + spacing;
+
+    Container::Handle nested = child.component<Container>();
+    if (nested) arrange(es, child, *nested, changed);
+  }
+}
+
+void ContainerLayout::place(entityx::Entity entity, double left, double top, double width,
+                            double height, std::vector<entityx::Entity::Id>& changed)
+{
+  Vector2d position(left + width / 2, top + height / 2), size(width, height);
+  Body::Handle body = entity.component<Body>();
+  if (!body)
+  {
+    entity.assign<Body>(position, size);
+  }
+  else
+  {
+    if (body->position == position && body->size == size) return;
+
+    body->position = position;
+    body->size = size;
+  }
+  changed.push_back(entity.id());
+  ++container_stats.placed;
+}
+
+void ContainerLayout::constrain(entityx::EntityManager& es, entityx::Entity entity,
+                                Container& container, LayoutSystem& layout)
+{
+  ++container_stats.constrained;
+  const rhea::strength strong = rhea::strength::strong();
+  rhea::constraint_list& constraints = container.constraints;
+
+  // Entities without a Layout get one, held weakly where their Body is
+  auto layout_of = [&](entityx::Entity item) -> Layout
+  {
+    Layout::Handle existing = item.component<Layout>();
+    if (existing) return *existing;
+
+    Body::Handle body = item.component<Body>();
+    if (!body) body = item.assign<Body>(Vector2d(), Vector2d());
+    Layout created(body->position.x, body->position.y, body->size.x, body->size.y);
+    for (const rhea::variable& variable : {created.x, created.y, created.width, created.height})
+      constraints.emplace_back(variable == variable.value(), rhea::strength::weak());
+    owned_layouts.insert(item.id().id());
+    item.assign<Layout>(created.x, created.y, created.width, created.height);
+    return created;
+  };
+
+  Layout own = layout_of(entity);
+  double padding = container.padding, spacing = container.spacing;
+
+  if (container.arrangement == Arrangement::Grid)
+  {
+    unsigned int columns = std::max(container.columns, 1u);
+    Span across = main_span(own, Axis::Horizontal), down = main_span(own, Axis::Vertical);
+    const rhea::variable& cell_width = container.cell_width;
+    const rhea::variable& cell_height = container.cell_height;
+    double gaps = spacing * (columns - 1) + padding * 2;
+    constraints.emplace_back(cell_width * (double)columns + gaps == across.size, strong);
+
+    size_t index = 0;
+    double tallest = 0;
+    for (entityx::Entity::Id id : container.children)
+    {
+      if (!es.valid(id)) continue;
+
+      entityx::Entity child = es.get(id);
+      Vector2d wanted = preferred(child);
+      Layout item = layout_of(child);
+      double column = index % columns, row = index / columns;
+      ++index;
+
+      tallest = std::max(tallest, wanted.y);
+      align(constraints, container.alignment, main_span(item, Axis::Horizontal),
+            across.start() + (padding + column * spacing) + cell_width * column, cell_width,
+            wanted.x);
+      align(constraints, container.alignment, main_span(item, Axis::Vertical),
+            down.start() + (padding + row * spacing) + cell_height * row, cell_height, wanted.y);
+    }
+
+    double rows = (index + columns - 1) / columns;
+    constraints.emplace_back(cell_height == tallest, rhea::strength::medium());
+    constraints.emplace_back(
+        down.size >= cell_height * rows + (spacing * std::max(rows - 1, 0.0) + padding * 2),
+        strong);
+    layout.addConstraints(constraints);
+    return;
+  }
+
+  Axis axis = container.axis;
+  bool horizontal = axis == Axis::Horizontal, flex = container.arrangement == Arrangement::Flex;
+  Span along = main_span(own, axis), across = cross_span(own, axis);
+
+  bool first = true, grower = false;
+  Span previous, grown;
+  double grown_wanted = 0, grown_factor = 0;
+  for (entityx::Entity::Id id : container.children)
+  {
+    if (!es.valid(id)) continue;
+
+    entityx::Entity child = es.get(id);
+    Vector2d wanted = preferred(child);
+    Layout item = layout_of(child);
+    Span item_along = main_span(item, axis);
+    double wanted_along = horizontal ? wanted.x : wanted.y;
+
+    constraints.emplace_back(
+        item_along.start() == (first ? along.start() + padding : previous.end() + spacing), strong);
+    constraints.emplace_back(item_along.size >= wanted_along, strong);
+
+    Sizing::Handle sizing = child.component<Sizing>();
+    double grow = flex && sizing ? sizing->grow : 0;
+    if (grow > 0)
+    {
+      // Growing children keep their share of the leftover space proportional
+      if (grower)
+      {
+        constraints.emplace_back((item_along.size - wanted_along) * grown_factor ==
+                                     (grown.size - grown_wanted) * grow,
+                                 strong);
+      }
+      grower = true;
+      grown = item_along;
+      grown_wanted = wanted_along;
+      grown_factor = grow;
+    }
+    else
+    {
+      constraints.emplace_back(item_along.size == wanted_along, rhea::strength::medium());
+    }
+
+    align(constraints, container.alignment, cross_span(item, axis), across.start() + padding,
+          across.size - padding * 2, horizontal ? wanted.y : wanted.x);
+    previous = item_along;
+    first = false;
+  }
+
+  if (!first)
+  {
+    constraints.emplace_back(previous.end() <= along.end() - padding, strong);
+    if (grower)
+      constraints.emplace_back(previous.end() == along.end() - padding, rhea::strength::medium());
+  }
+  layout.addConstraints(constraints);
+}
+}
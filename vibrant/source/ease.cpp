@@ -59,4 +59,15 @@ void fill_color_to(entityx::Entity entity, Rgb new_color, double time, Ease ease
       true, beginning, new_color - beginning, -delay, time, ease_to_function<Rgb>(ease)};
 }
 
+void fill_gradient_to(entityx::Entity entity, GradientStops new_stops, double time, Ease ease,
+                      double delay)
+{
+  if (!entity.has_component<Easings<Renderable>>()) entity.assign<Easings<Renderable>>();
+
+  auto beginning =
+      boost::apply_visitor(get_fill_gradient_visitor(), entity.component<Renderable>()->primitive);
+  entity.component<Easings<Renderable>>()->fill_gradient_easing = {
+      true, beginning, new_stops - beginning, -delay, time, ease_to_function<GradientStops>(ease)};
+}
+
 }  // namespace vibrant
\ No newline at end of file
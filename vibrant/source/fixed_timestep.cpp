@@ -0,0 +1,57 @@
+#include "pch.hpp"
+
+#include "vibrant/fixed_timestep.hpp"
+
+#include <cmath>
+
+namespace vibrant
+{
+FixedTimestep::FixedTimestep(double steps_per_second, unsigned int max_steps)
+    : max_steps(max_steps)
+{
+  setRate(steps_per_second);
+}
+
+unsigned int FixedTimestep::advance(double delta_ms)
+{
+  accumulated_ms += delta_ms;
+
+  unsigned int steps = 0;
+  while (accumulated_ms >= step_ms && steps < max_steps)
+  {
+    accumulated_ms -= step_ms;
+    ++steps;
+  }
+
+  // Fell behind; catch up by skipping time rather than simulating it
+  if (accumulated_ms >= step_ms)
+  {
+    double kept_ms = std::fmod(accumulated_ms, step_ms);
+    dropped_ms += accumulated_ms - kept_ms;
+    accumulated_ms = kept_ms;
+  }
+
+  step_count += steps;
+  return steps;
+}
+
+void store_previous_bodies(entityx::EntityManager& es)
+{
+  Body::Handle body;
+  for (entityx::Entity entity : es.entities_with_components(body))
+  {
+    PreviousBody::Handle previous = entity.component<PreviousBody>();
+    if (previous)
+      *previous.get() = PreviousBody(*body.get());
+    else
+      entity.assign<PreviousBody>(*body.get());
+  }
+}
+
+Body interpolate(const PreviousBody& previous, const Body& body, double alpha)
+{
+  return Body(previous.position + (body.position - previous.position) * alpha,
+              previous.size + (body.size - previous.size) * alpha,
+              previous.rotation + (body.rotation - previous.rotation) * alpha);
+}
+}
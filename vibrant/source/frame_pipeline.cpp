@@ -0,0 +1,85 @@
+#include "pch.hpp"
+
+#include "vibrant/frame_pipeline.hpp"
+
+#include <chrono>
+
+namespace vibrant
+{
+FramePipeline::FramePipeline(RenderFunction render)
+    : render(render), render_thread(&FramePipeline::run, this)
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return !pending; });
+    stopping = true;
+  }
+  changed.notify_all();
+  render_thread.join();
+}
+
+void FramePipeline::submit(RenderCommandBuffer& frame)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return !pending; });
+    in_flight.swap(frame);
+    pending = true;
+  }
+  changed.notify_all();
+}
+
+void FramePipeline::sync()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this] { return !pending; });
+}
+
+bool FramePipeline::busy() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return pending;
+}
+
+size_t FramePipeline::framesRendered() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return frames_rendered;
+}
+
+double FramePipeline::lastRenderMs() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return last_render_ms;
+}
+
+void FramePipeline::run()
+{
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [this] { return pending || stopping; });
+      if (stopping) return;
+    }
+
+    // in_flight is only touched by submit() while pending is false
+    auto start = std::chrono::steady_clock::now();
+    render(in_flight);
+    double render_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending = false;
+      ++frames_rendered;
+      last_render_ms = render_ms;
+    }
+    changed.notify_all();
+  }
+}
+}
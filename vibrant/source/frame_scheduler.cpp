@@ -0,0 +1,53 @@
+#include "pch.hpp"
+
+#include "vibrant/frame_scheduler.hpp"
+
+namespace vibrant
+{
+FrameScheduler::FrameScheduler(double target_rate) { setTargetRate(target_rate); }
+
+void FrameScheduler::setTargetRate(double frames_per_second)
+{
+  frame_interval_ms = 1000 / frames_per_second;
+}
+
+void FrameScheduler::addActivity(ActivityFunction active) { activities.push_back(active); }
+
+double FrameScheduler::msUntilNextFrame() const
+{
+  if (!pending) return -1;
+  if (resuming) return 0;
+
+  double elapsed_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - last_frame).count();
+  return std::max(0.0, frame_interval_ms - elapsed_ms);
+}
+
+double FrameScheduler::beginFrame()
+{
+  Clock::time_point now = Clock::now();
+  double delta_ms = resuming ? frame_interval_ms
+                             : std::chrono::duration<double, std::milli>(now - last_frame).count();
+
+  last_frame = now;
+  pending = false;
+  resuming = false;
+  ++frame_count;
+  return delta_ms;
+}
+
+void FrameScheduler::endFrame()
+{
+  for (auto& active : activities)
+  {
+    if (active())
+    {
+      pending = true;
+      return;
+    }
+  }
+
+  // Input may arrive during the frame
+  resuming = !pending;
+}
+}
@@ -0,0 +1,89 @@
+#include "pch.hpp"
+
+#include "vibrant/gradient.hpp"
+
+namespace vibrant
+{
+namespace
+{
+// Stops past the end of the shorter list count as zero
+GradientStop stop_at(const GradientStops& stops, size_t i)
+{
+  return i < stops.size() ? stops[i] : GradientStop{0, Rgb(0, 0, 0, 0)};
+}
+}
+
+GradientStops operator+(const GradientStops& lhs, const GradientStops& rhs)
+{
+  GradientStops result;
+  for (size_t i = 0; i < std::max(lhs.size(), rhs.size()); ++i)
+  {
+    GradientStop a = stop_at(lhs, i), b = stop_at(rhs, i);
+    result.push_back({a.offset + b.offset, a.color + b.color});
+  }
+  return result;
+}
+GradientStops operator-(const GradientStops& lhs, const GradientStops& rhs)
+{
+  GradientStops result;
+  for (size_t i = 0; i < std::max(lhs.size(), rhs.size()); ++i)
+  {
+    GradientStop a = stop_at(lhs, i), b = stop_at(rhs, i);
+    result.push_back({a.offset - b.offset, a.color - b.color});
+  }
+  return result;
+}
+GradientStops operator*(const GradientStops& lhs, const GradientStops& rhs)
+{
+  GradientStops result;
+  for (size_t i = 0; i < std::max(lhs.size(), rhs.size()); ++i)
+  {
+    GradientStop a = stop_at(lhs, i), b = stop_at(rhs, i);
+    result.push_back({a.offset * b.offset, a.color * b.color});
+  }
+  return result;
+}
+
+GradientStops operator*(const GradientStops& lhs, double rhs)
+{
+  GradientStops result;
+  for (auto& stop : lhs) result.push_back({stop.offset * rhs, stop.color * rhs});
+  return result;
+}
+GradientStops operator/(const GradientStops& lhs, double rhs)
+{
+  GradientStops result;
+  for (auto& stop : lhs) result.push_back({stop.offset / rhs, stop.color / rhs});
+  return result;
+}
+GradientStops operator+(const GradientStops& lhs, double rhs)
+{
+  GradientStops result;
+  for (auto& stop : lhs) result.push_back({stop.offset + rhs, stop.color + rhs});
+  return result;
+}
+
+GradientStops operator*(double lhs, const GradientStops& rhs) { return rhs * lhs; }
+GradientStops operator+(double lhs, const GradientStops& rhs) { return rhs + lhs; }
+
+GradientStops operator-(const GradientStops& rhs)
+{
+  GradientStops result;
+  for (auto& stop : rhs) result.push_back({-stop.offset, -stop.color});
+  return result;
+}
+
+bool operator==(const GradientStops& lhs, const GradientStops& rhs)
+{
+  if (lhs.size() != rhs.size()) return false;
+  for (size_t i = 0; i < lhs.size(); ++i)
+    if (lhs[i].offset != rhs[i].offset || lhs[i].color != rhs[i].color) return false;
+  return true;
+}
+
+bool operator==(const Gradient& lhs, const Gradient& rhs)
+{
+  return lhs.type == rhs.type && lhs.start.x == rhs.start.x && lhs.start.y == rhs.start.y &&
+         lhs.end.x == rhs.end.x && lhs.end.y == rhs.end.y && lhs.stops == rhs.stops;
+}
+}
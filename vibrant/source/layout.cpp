@@ -3,51 +3,610 @@
 #include "vibrant/layout.hpp"
 #include "vibrant/body.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace vibrant
 {
+namespace
+{
+uint64_t size_key(Vector2u size) { return (uint64_t)size.x << 32 | size.y; }
+}
+
 LayoutSystem::LayoutSystem()
     : left_limit{0},
       right_limit{},
       top_limit{0},
       bottom_limit{},
-      right_limit_stay{right_limit == 1280},
-      bottom_limit_stay{bottom_limit == 720}
+      size(1280, 720),
+      solved_size(size)
 {
+  watchSolver();
   solver.add_constraint(left_limit == 0);
   solver.add_constraint(top_limit == 0);
-  solver.add_constraint(right_limit_stay);
-  solver.add_constraint(bottom_limit_stay);
+
+  // Re-adding a constraint per size is the most expensive thing the solver does. Suggesting a
+  // new value for an edit variable only re-optimises, so the edit stays open for good.
+  solver.add_edit_var(right_limit);
+  solver.add_edit_var(bottom_limit);
+  solver.begin_edit();
+  suggest(size);
+  solver.resolve();
+}
+
+void LayoutSystem::configure(entityx::EventManager& events)
+{
+  events.subscribe<entityx::ComponentAddedEvent<Layout>>(*this);
+  events.subscribe<entityx::ComponentRemovedEvent<Layout>>(*this);
+  events.subscribe<entityx::ComponentAddedEvent<Renderable>>(*this);
+  events.subscribe<entityx::ComponentAddedEvent<Container>>(*this);
+  events.subscribe<entityx::ComponentRemovedEvent<Container>>(*this);
+  events.subscribe<entityx::EntityDestroyedEvent>(*this);
 }
 
 void LayoutSystem::update(entityx::EntityManager& es, entityx::EventManager& events,
                           entityx::TimeDelta dt)
 {
-  Layout::Handle layout;
-  Body::Handle body;
+  if (measure_text) updateIntrinsicSizes(es);
 
-  for (entityx::Entity entity : es.entities_with_components(layout, body))
+  bool suggested = false;
+  if (size != solved_size)
+  {
+    suggested = resize(es);
+  }
+  // Constraints changed under a layout restored from the cache, so the solver solved them for the
+  // size it last saw instead
+  else if (suggested_size != solved_size && constraint_version != restored_version)
   {
+    suggest(solved_size);
+    suggested = true;
+  }
+  if (advanceAnimations(dt)) suggested = true;
+
+  // However many edit variables moved. The worker resolves after every batch by itself.
+  if (suggested && !solver_thread)
+  {
+    solver.resolve();
+    ++resolve_count;
+  }
+  containers.restructure(es, *this);
+  if (solver_thread) takeSnapshot();
+
+  changed_entities.clear();
+  // A solve usually changes several variables of the same entity
+  std::sort(dirty.begin(), dirty.end());
+  dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+  for (entityx::Entity::Id id : dirty)
+  {
+    if (!es.valid(id)) continue;
+
+    entityx::Entity entity = es.get(id);
+    Layout::Handle layout = entity.component<Layout>();
+    Body::Handle body = entity.component<Body>();
+    if (!layout || !body) continue;
+    // Comes back dirty once the worker publishes the rest
+    if (solver_thread && !isPublished(*layout.get())) continue;
+
     assert(!layout->x.is_nil());
     assert(!layout->width.is_nil());
     assert(!layout->y.is_nil());
     assert(!layout->height.is_nil());
 
-    body->position.x = layout->x.value();
-    body->position.y = layout->y.value();
-    body->size.x = layout->width.value();
-    body->size.y = layout->height.value();
+    body->position.x = value(layout->x);
+    body->position.y = value(layout->y);
+    body->size.x = value(layout->width);
+    body->size.y = value(layout->height);
+    changed_entities.push_back(id);
   }
+  dirty.clear();
+
+  // After the solver, which may have moved the root of a container tree
+  containers.arrange(es, changed_entities);
+
+  if (!changed_entities.empty()) events.emit<LayoutChanged>(changed_entities);
 }
 
-void LayoutSystem::setSize(Vector2u size)
+void LayoutSystem::watchSolver()
 {
-  solver.remove_constraint(right_limit_stay);
-  right_limit_stay = (right_limit == size.x);
-  solver.add_constraint(right_limit_stay);
+  solver.on_variable_change = [this](const rhea::variable& variable, rhea::simplex_solver&)
+  {
+    auto found = variable_entities.find(variable.id());
+    if (found != variable_entities.end()) dirty.push_back(found->second.entity);
+  };
+}
+
+void LayoutSystem::edit(SolverThread::Edit edit)
+{
+  if (solver_thread)
+    solver_thread->post(std::move(edit));
+  else
+    edit(solver);
+}
+
+void LayoutSystem::setAsynchronous(bool asynchronous)
+{
+  if (asynchronous == (solver_thread != nullptr)) return;
+
+  if (asynchronous)
+  {
+    // A layout restored from the cache only lives in the variables, which the worker owns now
+    invalidateCache();
+
+    // The last chance to read the variables here
+    published_values.clear();
+    for (auto& tracked : variable_entities) publishValue(tracked.second.variable);
+    for (const rhea::variable& limit : {left_limit, right_limit, top_limit, bottom_limit})
+      publishValue(limit);
+    for (const Animation& animation : animations) publishValue(animation.variable);
+
+    solver_thread.reset(new SolverThread(solver));
+    return;
+  }
+
+  // Once the worker is done, the variables hold everything it solved
+  solver_thread->wait();
+  std::shared_ptr<const SolverSnapshot> snapshot = solver_thread->take();
+  solver_thread.reset();
+  watchSolver();
+  published_values.clear();
+  if (!snapshot) return;
+
+  for (auto& changed : snapshot->values)
+  {
+    auto found = variable_entities.find(changed.first);
+    if (found != variable_entities.end()) dirty.push_back(found->second.entity);
+  }
+  resolve_count += snapshot->solves;
+}
+
+void LayoutSystem::takeSnapshot()
+{
+  if (wait_for_solver)
+  {
+    solver_thread->wait();
+    wait_for_solver = false;
+  }
+
+  std::shared_ptr<const SolverSnapshot> snapshot = solver_thread->take();
+  if (!snapshot) return;
+
+  for (auto& changed : snapshot->values)
+  {
+    published_values[changed.first] = changed.second;
+    auto found = variable_entities.find(changed.first);
+    if (found != variable_entities.end()) dirty.push_back(found->second.entity);
+  }
+  resolve_count += snapshot->solves;
+
+  // Surfaces as it would have from the edit that failed, had the solver run here
+  if (snapshot->error) std::rethrow_exception(snapshot->error);
+}
 
-  solver.remove_constraint(bottom_limit_stay);
-  bottom_limit_stay = (bottom_limit == size.y);
-  solver.add_constraint(bottom_limit_stay);
+void LayoutSystem::publishValue(const rhea::variable& variable)
+{
+  published_values[variable.id()] = variable.value();
+}
+
+bool LayoutSystem::isPublished(const Layout& layout) const
+{
+  for (const rhea::variable& variable : {layout.x, layout.y, layout.width, layout.height})
+    if (!published_values.count(variable.id())) return false;
+  return true;
+}
+
+double LayoutSystem::value(const rhea::variable& variable) const
+{
+  if (!solver_thread) return variable.value();
+
+  // The worker may be writing the variable itself
+  auto found = published_values.find(variable.id());
+  return found != published_values.end() ? found->second
+                                         : std::numeric_limits<double>::quiet_NaN();
+}
+
+void LayoutSystem::receive(const entityx::ComponentAddedEvent<Layout>& event)
+{
+  const Layout& layout = *event.component.get();
+  entityx::Entity::Id id = event.entity.id();
+  for (const rhea::variable& variable : {layout.x, layout.y, layout.width, layout.height})
+    variable_entities[variable.id()] = {variable, id};
+  if (solver_thread) solver_thread->read({layout.x, layout.y, layout.width, layout.height});
+
+  // The Body starts out however it was created, not necessarily at the variables' values
+  dirty.push_back(id);
+  invalidateCache();
+  remeasure(event.entity);
+}
+
+void LayoutSystem::receive(const entityx::ComponentRemovedEvent<Layout>& event)
+{
+  untrack(*event.component.get());
+}
+
+void LayoutSystem::receive(const entityx::ComponentAddedEvent<Renderable>& event)
+{
+  remeasure(event.entity);
+}
+
+void LayoutSystem::receive(const entityx::ComponentAddedEvent<Container>& event)
+{
+  containers.track(event.entity.id(), *event.component.get());
+}
+
+void LayoutSystem::receive(const entityx::ComponentRemovedEvent<Container>& event)
+{
+  containers.untrack(event.entity.id(), *event.component.get(), *this);
+}
+
+void LayoutSystem::receive(const entityx::EntityDestroyedEvent& event)
+{
+  entityx::Entity entity = event.entity;
+  Layout::Handle layout = entity.component<Layout>();
+  if (layout) untrack(*layout.get());
+
+  Container::Handle container = entity.component<Container>();
+  if (container) containers.untrack(entity.id(), *container.get(), *this);
+  // It may be some container's child
+  containers.invalidate();
+}
+
+void LayoutSystem::untrack(const Layout& layout)
+{
+  variable_entities.erase(layout.x.id());
+  variable_entities.erase(layout.y.id());
+  variable_entities.erase(layout.width.id());
+  variable_entities.erase(layout.height.id());
+  for (const rhea::variable& variable : {layout.x, layout.y, layout.width, layout.height})
+    published_values.erase(variable.id());
+}
+
+void LayoutSystem::setTextMeasure(TextMeasureFunction measure)
+{
+  measure_text = measure;
+  measure_all = true;
+  unmeasured.clear();
+}
+
+void LayoutSystem::remeasure(entityx::Entity entity)
+{
+  // Everything is measured once measurement is set
+  if (measure_text && !measure_all) unmeasured.push_back(entity.id());
+}
+
+void LayoutSystem::updateIntrinsicSizes(entityx::EntityManager& es)
+{
+  Layout::Handle layout;
+  Renderable::Handle renderable;
+
+  if (measure_all)
+  {
+    for (entityx::Entity entity : es.entities_with_components(layout, renderable))
+      updateIntrinsicSize(entity, *layout.get(), *renderable.get());
+    measure_all = false;
+    return;
+  }
+
+  std::sort(unmeasured.begin(), unmeasured.end());
+  unmeasured.erase(std::unique(unmeasured.begin(), unmeasured.end()), unmeasured.end());
+  for (entityx::Entity::Id id : unmeasured)
+  {
+    if (!es.valid(id)) continue;
+
+    entityx::Entity entity = es.get(id);
+    layout = entity.component<Layout>();
+    renderable = entity.component<Renderable>();
+    if (layout && renderable) updateIntrinsicSize(entity, *layout.get(), *renderable.get());
+  }
+  unmeasured.clear();
+}
+
+void LayoutSystem::updateIntrinsicSize(entityx::Entity entity, const Layout& layout,
+                                       const Renderable& renderable)
+{
+  const Text* text = boost::get<Text>(&renderable.primitive);
+  if (!text) return;
+
+  IntrinsicSize::Handle intrinsic = entity.component<IntrinsicSize>();
+  if (intrinsic && intrinsic->measured.text == text->text && intrinsic->measured.font == text->font)
+    return;
+
+  Vector2d size = measure_text(*text);
+  if (!intrinsic)
+  {
+    intrinsic = entity.assign<IntrinsicSize>(*text, size);
+  }
+  else
+  {
+    intrinsic->measured = *text;
+    if (intrinsic->size.x == size.x && intrinsic->size.y == size.y) return;
+
+    removeConstraint(intrinsic->min_width);
+    removeConstraint(intrinsic->min_height);
+    intrinsic->size = size;
+  }
+
+  intrinsic->min_width = layout.width >= size.x;
+  intrinsic->min_height = layout.height >= size.y;
+  addConstraint(intrinsic->min_width);
+  addConstraint(intrinsic->min_height);
+}
+
+void LayoutSystem::setSize(Vector2u new_size) { size = new_size; }
+
+void LayoutSystem::addConstraint(const rhea::constraint& constraint)
+{
+  edit([constraint](rhea::simplex_solver& solver) { solver.add_constraint(constraint); });
+  invalidateCache();
+}
+
+void LayoutSystem::addConstraints(const rhea::constraint_list& constraints)
+{
+  edit([constraints](rhea::simplex_solver& solver) { solver.add_constraints(constraints); });
+  invalidateCache();
+}
+
+void LayoutSystem::removeConstraint(const rhea::constraint& constraint)
+{
+  edit([constraint](rhea::simplex_solver& solver) { solver.remove_constraint(constraint); });
+  invalidateCache();
+}
+
+void LayoutSystem::removeConstraints(const rhea::constraint_list& constraints)
+{
+  edit([constraints](rhea::simplex_solver& solver) { solver.remove_constraints(constraints); });
+  invalidateCache();
+}
+
+void LayoutSystem::invalidateCache()
+{
+  ++constraint_version;
+  if (solved_layouts.empty()) return;
+
+  solved_layouts.clear();
+  solved_by_size.clear();
+  ++cache_stats.invalidations;
+}
+
+void LayoutSystem::setCacheCapacity(size_t sizes)
+{
+  cache_capacity = sizes;
+  while (solved_layouts.size() > cache_capacity)
+  {
+    solved_by_size.erase(solved_layouts.back().size);
+    solved_layouts.pop_back();
+    ++cache_stats.evictions;
+  }
+}
+
+size_t LayoutSystem::cacheMemoryUsage() const
+{
+  size_t bytes = 0;
+  for (auto& solved : solved_layouts)
+    bytes += sizeof(SolvedLayout) + solved.values.capacity() * sizeof(SolvedValues);
+  return bytes;
+}
+
+bool LayoutSystem::resize(entityx::EntityManager& es)
+{
+  // The variables hold the final layout for the size being left, unless they were restored and
+  // constraints changed since, or they're mid animation. The worker's variables are off limits.
+  bool cached = cache_capacity && !solver_thread;
+  if (cached && suggested_size == solved_size && !active_animations) remember(es, solved_size);
+
+  bool suggested = false;
+  if (cached && restore(es, size))
+  {
+    ++cache_stats.hits;
+  }
+  else
+  {
+    suggest(size);
+    suggested = true;
+    ++cache_stats.misses;
+  }
+  solved_size = size;
+  return suggested;
+}
+
+void LayoutSystem::suggest(Vector2u viewport)
+{
+  rhea::variable right = right_limit, bottom = bottom_limit;
+  edit([right, bottom, viewport](rhea::simplex_solver& solver)
+       {
+         solver.suggest_value(right, viewport.x);
+         solver.suggest_value(bottom, viewport.y);
+       });
+  suggested_size = viewport;
+}
+
+void LayoutSystem::animate(const rhea::variable& variable, double value, double time, Ease ease,
+                           double delay, bool hold, const rhea::strength& strength)
+{
+  auto found = std::find_if(animations.begin(), animations.end(), [&](const Animation& animation)
+                            {
+                              return animation.variable.is(variable);
+                            });
+  if (found == animations.end())
+  {
+    // Adding the edit variable is the only constraint change; the frames after only suggest
+    edit([variable, strength](rhea::simplex_solver& solver)
+         {
+           solver.add_edit_var(variable, strength);
+         });
+    invalidateCache();
+    animations.push_back({variable, Easing<double>(), hold});
+    found = std::prev(animations.end());
+  }
+
+  if (!found->easing.active) ++active_animations;
+  double beginning = this->value(variable);
+  if (solver_thread && !published_values.count(variable.id()))
+  {
+    // Eases from wherever the worker has it; until then the animation waits as if delayed
+    solver_thread->read({variable});
+    found->awaiting_start = true;
+    beginning = value;
+  }
+  found->easing = {true, beginning, value - beginning, -delay, time,
+                   ease_to_function<double>(ease)};
+  found->hold = hold;
+}
+
+void LayoutSystem::release(const rhea::variable& variable)
+{
+  auto found = std::find_if(animations.begin(), animations.end(), [&](const Animation& animation)
+                            {
+                              return animation.variable.is(variable);
+                            });
+  if (found == animations.end()) return;
+
+  if (found->easing.active) --active_animations;
+  edit([variable](rhea::simplex_solver& solver) { solver.remove_edit_var(variable); });
+  invalidateCache();
+  animations.erase(found);
+}
+
+void LayoutSystem::suggestValue(const rhea::variable& variable, double value)
+{
+  edit([variable, value](rhea::simplex_solver& solver) { solver.suggest_value(variable, value); });
+}
+
+bool LayoutSystem::advanceAnimations(double delta)
+{
+  if (!active_animations) return false;
+
+  bool suggested = false;
+  active_animations = 0;
+  for (size_t i = 0; i < animations.size();)
+  {
+    Animation& animation = animations[i];
+    Easing<double>& easing = animation.easing;
+    if (!easing.active)
+    {
+      ++i;
+      continue;
+    }
+
+    if (animation.awaiting_start)
+    {
+      auto published = published_values.find(animation.variable.id());
+      if (published == published_values.end())
+      {
+        ++active_animations;
+        ++i;
+        continue;
+      }
+      double target = easing.beginning + easing.change;
+      easing.beginning = published->second;
+      easing.change = target - easing.beginning;
+      animation.awaiting_start = false;
+    }
+
+    easing.current += delta;
+    if (easing.current < 0)
+    {
+      // in delay
+      ++active_animations;
+      ++i;
+      continue;
+    }
+
+    if (easing.current < easing.total_time)
+    {
+      suggestValue(animation.variable, easing.easing_function(easing.current, easing.beginning,
+                                                              easing.change, easing.total_time));
+      suggested = true;
+      ++active_animations;
+      ++i;
+      continue;
+    }
+
+    easing.active = false;
+    if (animation.hold)
+    {
+      suggestValue(animation.variable, easing.beginning + easing.change);
+      suggested = true;
+      ++i;
+    }
+    else
+    {
+      rhea::variable variable = animation.variable;
+      edit([variable](rhea::simplex_solver& solver) { solver.remove_edit_var(variable); });
+      invalidateCache();
+      animations.erase(animations.begin() + i);
+    }
+  }
+  return suggested;
+}
+
+void LayoutSystem::remember(entityx::EntityManager& es, Vector2u viewport)
+{
+  uint64_t key = size_key(viewport);
+  auto found = solved_by_size.find(key);
+  if (found != solved_by_size.end())
+  {
+    // Restored from here in the first place, so it's still what the solver would give
+    solved_layouts.splice(solved_layouts.begin(), solved_layouts, found->second);
+    return;
+  }
+
+  // Reuse the least recently used entry's allocation when full
+  if (solved_layouts.size() >= cache_capacity)
+  {
+    solved_by_size.erase(solved_layouts.back().size);
+    solved_layouts.splice(solved_layouts.begin(), solved_layouts, std::prev(solved_layouts.end()));
+    ++cache_stats.evictions;
+  }
+  else
+  {
+    solved_layouts.emplace_front();
+  }
+
+  SolvedLayout& solved = solved_layouts.front();
+  solved.size = key;
+  solved.version = constraint_version;
+  solved.right = right_limit.value();
+  solved.bottom = bottom_limit.value();
+  solved.values.clear();
+
+  Layout::Handle layout;
+  for (entityx::Entity entity : es.entities_with_components(layout))
+  {
+    solved.values.push_back({entity.id(), layout->x.value(), layout->y.value(),
+                             layout->width.value(), layout->height.value()});
+  }
+  solved_by_size[key] = solved_layouts.begin();
+}
+
+bool LayoutSystem::restore(entityx::EntityManager& es, Vector2u viewport)
+{
+  auto found = solved_by_size.find(size_key(viewport));
+  if (found == solved_by_size.end()) return false;
+
+  SolvedLayout& solved = *found->second;
+  if (solved.version != constraint_version) return false;
+  solved_layouts.splice(solved_layouts.begin(), solved_layouts, found->second);
+  restored_version = constraint_version;
+
+  // Setting the variables rather than only the bodies keeps them consistent for anyone reading
+  // them, and lets the next solve report changes relative to this layout
+  right_limit.set_value(solved.right);
+  bottom_limit.set_value(solved.bottom);
+  for (auto& values : solved.values)
+  {
+    if (!es.valid(values.entity)) continue;
+
+    Layout::Handle layout = es.get(values.entity).component<Layout>();
+    if (!layout) continue;
+
+    layout->x.set_value(values.x);
+    layout->y.set_value(values.y);
+    layout->width.set_value(values.width);
+    layout->height.set_value(values.height);
+    dirty.push_back(values.entity);
+  }
+  return true;
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "pch.hpp"
+
+#include "vibrant/solver_thread.hpp"
+
+namespace vibrant
+{
+SolverThread::SolverThread(rhea::simplex_solver& solver)
+    : solver(solver), collecting(std::make_shared<SolverSnapshot>())
+{
+  solver.on_variable_change = [this](const rhea::variable& variable, rhea::simplex_solver&)
+  {
+    collecting->values[variable.id()] = variable.value();
+  };
+  worker = std::thread(&SolverThread::run, this);
+}
+
+SolverThread::~SolverThread()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return queued.empty() && !solving; });
+    stopping = true;
+  }
+  changed.notify_all();
+  worker.join();
+  solver.on_variable_change = nullptr;
+}
+
+void SolverThread::post(Edit edit)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.push_back(std::move(edit));
+  }
+  changed.notify_all();
+}
+
+void SolverThread::read(std::vector<rhea::variable> variables)
+{
+  post([this, variables](rhea::simplex_solver&)
+       {
+         for (const rhea::variable& variable : variables)
+           collecting->values[variable.id()] = variable.value();
+       });
+}
+
+std::shared_ptr<const SolverSnapshot> SolverThread::take()
+{
+  return std::atomic_exchange(&published, std::shared_ptr<SolverSnapshot>());
+}
+
+void SolverThread::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this] { return queued.empty() && !solving; });
+}
+
+bool SolverThread::busy() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return !queued.empty() || solving;
+}
+
+void SolverThread::run()
+{
+  std::vector<Edit> batch;
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [this] { return !queued.empty() || stopping; });
+      if (queued.empty()) return;
+
+      batch.swap(queued);
+      solving = true;
+    }
+
+    for (auto& edit : batch)
+    {
+      try
+      {
+        edit(solver);
+      }
+      catch (...)
+      {
+        if (!collecting->error) collecting->error = std::current_exception();
+      }
+    }
+    batch.clear();
+
+    // Edits that only suggested values leave the solve to here, once for the whole batch
+    try
+    {
+      solver.resolve();
+    }
+    catch (...)
+    {
+      if (!collecting->error) collecting->error = std::current_exception();
+    }
+    ++collecting->solves;
+    publish();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      solving = false;
+    }
+    changed.notify_all();
+  }
+}
+
+void SolverThread::publish()
+{
+  // Anything still unclaimed is older than what was just collected
+  std::shared_ptr<SolverSnapshot> unclaimed =
+      std::atomic_exchange(&published, std::shared_ptr<SolverSnapshot>());
+  if (unclaimed)
+  {
+    collecting->values.insert(unclaimed->values.begin(), unclaimed->values.end());
+    collecting->solves += unclaimed->solves;
+    if (unclaimed->error) collecting->error = unclaimed->error;
+  }
+
+  std::atomic_store(&published, collecting);
+  collecting = std::make_shared<SolverSnapshot>();
+}
+}
@@ -0,0 +1,250 @@
+#include "pch.hpp"
+
+#include "vibrant/virtual_list.hpp"
+#include "vibrant/body.hpp"
+#include "vibrant/layout.hpp"
+#include "vibrant/mouse.hpp"
+#include "vibrant/renderable.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vibrant
+{
+RowExtents::RowExtents(size_t rows, double estimated) : rows(rows), estimated(estimated) {}
+
+void RowExtents::resize(size_t new_rows)
+{
+  rows = new_rows;
+  ++extents_version;
+  if (extents.empty()) return;
+
+  extents.resize(rows, estimated);
+  // Building in place is linear, where adding rows one at a time would be O(n log n)
+  tree.assign(rows + 1, 0);
+  for (size_t i = 1; i <= rows; ++i)
+  {
+    tree[i] += extents[i - 1];
+    size_t parent = i + (i & (0 - i));
+    if (parent <= rows) tree[parent] += tree[i];
+  }
+}
+
+void RowExtents::set(size_t row, double extent)
+{
+  if (row >= rows) return;
+
+  if (extents.empty())
+  {
+    if (extent == estimated) return;
+
+    // The first measured row; from now on every row is stored
+    extents.assign(1, estimated);
+    resize(rows);
+  }
+
+  double delta = extent - extents[row];
+  if (delta == 0) return;
+
+  extents[row] = extent;
+  for (size_t i = row + 1; i <= rows; i += i & (0 - i)) tree[i] += delta;
+  ++extents_version;
+}
+
+double RowExtents::extent(size_t row) const
+{
+  return extents.empty() ? estimated : extents[row];
+}
+
+double RowExtents::offset(size_t row) const
+{
+  row = std::min(row, rows);
+  if (extents.empty()) return row * estimated;
+
+  double sum = 0;
+  for (size_t i = row; i; i -= i & (0 - i)) sum += tree[i];
+  return sum;
+}
+
+size_t RowExtents::rowAt(double offset) const
+{
+  if (offset <= 0 || rows == 0) return 0;
+  if (extents.empty()) return std::min((size_t)(offset / estimated), rows - 1);
+
+  // Descend the tree for the number of rows that end at or before offset
+  size_t row = 0, step = 1;
+  while (step * 2 <= rows) step *= 2;
+  for (; step; step /= 2)
+  {
+    if (row + step <= rows && tree[row + step] <= offset)
+    {
+      row += step;
+      offset -= tree[row];
+    }
+  }
+  return std::min(row, rows - 1);
+}
+
+void VirtualListSystem::configure(entityx::EventManager& events)
+{
+  events.subscribe<entityx::ComponentAddedEvent<VirtualList>>(*this);
+  events.subscribe<entityx::ComponentRemovedEvent<VirtualList>>(*this);
+  events.subscribe<entityx::EntityDestroyedEvent>(*this);
+}
+
+void VirtualListSystem::update(entityx::EntityManager& es, entityx::EventManager& events,
+                               entityx::TimeDelta dt)
+{
+  changed_entities.clear();
+  for (entityx::Entity::Id id : lists)
+  {
+    entityx::Entity entity = es.get(id);
+    VirtualList::Handle list = entity.component<VirtualList>();
+    if (list) refresh(es, entity, *list);
+  }
+
+  if (!changed_entities.empty()) events.emit<LayoutChanged>(changed_entities);
+}
+
+void VirtualListSystem::receive(const entityx::ComponentAddedEvent<VirtualList>& event)
+{
+  lists.push_back(event.entity.id());
+}
+
+void VirtualListSystem::receive(const entityx::ComponentRemovedEvent<VirtualList>& event)
+{
+  untrack(event.entity.id(), *event.component.get());
+}
+
+void VirtualListSystem::receive(const entityx::EntityDestroyedEvent& event)
+{
+  entityx::Entity entity = event.entity;
+  VirtualList::Handle list = entity.component<VirtualList>();
+  if (list) untrack(entity.id(), *list.get());
+}
+
+void VirtualListSystem::untrack(entityx::Entity::Id entity, const VirtualList& list)
+{
+  lists.erase(std::remove(lists.begin(), lists.end(), entity), lists.end());
+
+  // The rows go with the list
+  for (entityx::Entity row : list.live)
+  {
+    if (row.valid()) row.destroy();
+  }
+  for (entityx::Entity row : list.spare)
+  {
+    if (row.valid()) row.destroy();
+  }
+}
+
+void VirtualListSystem::unbind(entityx::Entity row)
+{
+  if (row.has_component<Renderable>()) row.remove<Renderable>();
+  if (row.has_component<Mouseable>()) row.remove<Mouseable>();
+}
+
+void VirtualListSystem::refresh(entityx::EntityManager& es, entityx::Entity entity,
+                                VirtualList& list)
+{
+  Body::Handle body = entity.component<Body>();
+  if (!body) return;
+
+  bool horizontal = list.axis == Axis::Horizontal;
+  double length = horizontal ? body->size.x : body->size.y;
+  list.scroll = std::max(0.0, std::min(list.scroll, list.extents.total() - length));
+
+  if (!list.changed && list.scroll == list.placed_scroll &&
+      body->position == list.placed_position && body->size == list.placed_size &&
+      list.extents.version() == list.placed_version)
+    return;
+
+  // The rows in view, plus overscan
+  size_t rows = list.extents.size(), first = 0, end = 0;
+  if (rows && length > 0)
+  {
+    size_t top = list.extents.rowAt(list.scroll);
+    size_t bottom = list.extents.rowAt(list.scroll + length);
+    first = top > list.overscan ? top - list.overscan : 0;
+    end = std::min(rows, bottom + list.overscan + 1);
+  }
+
+  // Rows staying in range keep their entity, unless everything is to be bound again
+  kept.assign(end - first, entityx::Entity());
+  for (size_t i = 0; i < list.live.size(); ++i)
+  {
+    entityx::Entity row = list.live[i];
+    if (!row.valid()) continue;
+
+    size_t index = list.first + i;
+    if (!list.changed && index >= first && index < end)
+    {
+      kept[index - first] = row;
+    }
+    else
+    {
+      unbind(row);
+      list.spare.push_back(row);
+    }
+  }
+
+  for (size_t i = 0; i < kept.size(); ++i)
+  {
+    if (kept[i].valid()) continue;
+
+    entityx::Entity row;
+    while (!list.spare.empty() && !row.valid())
+    {
+      row = list.spare.back();
+      list.spare.pop_back();
+    }
+    if (!row.valid())
+    {
+      row = es.create();
+      row.assign<Body>(Vector2d(), Vector2d());
+      ++created_rows;
+    }
+
+    list.bind(row, first + i);
+    ++bound_rows;
+    kept[i] = row;
+  }
+  list.live.swap(kept);
+  list.first = first;
+
+  while (list.spare.size() > list.spare_limit)
+  {
+    if (list.spare.back().valid()) list.spare.back().destroy();
+    list.spare.pop_back();
+  }
+
+  // One offset lookup; the rest follow from the extents
+  double start = horizontal ? body->position.x - body->size.x / 2
+                            : body->position.y - body->size.y / 2;
+  double along = start + list.extents.offset(first) - list.scroll;
+  double across = horizontal ? body->position.y : body->position.x;
+  double breadth = horizontal ? body->size.y : body->size.x;
+  for (size_t i = 0; i < list.live.size(); ++i)
+  {
+    double extent = list.extents.extent(first + i);
+    Vector2d position = horizontal ? Vector2d(along + extent / 2, across)
+                                   : Vector2d(across, along + extent / 2);
+    Vector2d size = horizontal ? Vector2d(extent, breadth) : Vector2d(breadth, extent);
+    along += extent;
+
+    entityx::Entity row = list.live[i];
+    Body::Handle row_body = row.component<Body>();
+    if (!row_body || (row_body->position == position && row_body->size == size)) continue;
+
+    row_body->position = position;
+    row_body->size = size;
+    changed_entities.push_back(row.id());
+  }
+
+  list.changed = false;
+  list.placed_scroll = list.scroll;
+  list.placed_position = body->position;
+  list.placed_size = body->size;
+  list.placed_version = list.extents.version();
+}
+}